@@ -15,6 +15,8 @@
 
 #include "admin_check_page.h"
 
+#include <QFileDialog>
+
 #include "gondar.h"
 #include "gondarwizard.h"
 #include "metric.h"
@@ -28,6 +30,7 @@ AdminCheckPage::AdminCheckPage(QWidget* parent) : WizardPage(parent) {
 
   layout.addWidget(&label);
   layout.addStretch();
+  layout.addWidget(&localImageLink);
   layout.addWidget(&formatLink);
   setLayout(&layout);
 }
@@ -37,6 +40,17 @@ void AdminCheckPage::handleFormatOnly() {
   wizard()->next();
 }
 
+void AdminCheckPage::handleLocalImage() {
+  const QString path = QFileDialog::getOpenFileName(
+      this, "Choose a ThoriumOS image", QString(),
+      "ThoriumOS images (*.bin *.zip)");
+  if (path.isEmpty()) {
+    return;
+  }
+  wizard()->setLocalImage(path);
+  wizard()->next();
+}
+
 void AdminCheckPage::initializePage() {
   // this logic is in initializePage because wizard() is not callable
   // from the constructor
@@ -76,6 +90,12 @@ void AdminCheckPage::showIsAdmin() {
   formatLink.setTextFormat(Qt::RichText);
   connect(&formatLink, &QLabel::linkActivated, this,
           &AdminCheckPage::handleFormatOnly);
+  localImageLink.setText(
+      "<a href=\"local\">Already have the image on this computer or a "
+      "network share?  Use it here.</a>");
+  localImageLink.setTextFormat(Qt::RichText);
+  connect(&localImageLink, &QLabel::linkActivated, this,
+          &AdminCheckPage::handleLocalImage);
   emit completeChanged();
 }
 
@@ -93,6 +113,9 @@ bool AdminCheckPage::validatePage() {
   if (wizard()->getSessionError()) {
     return true;
   }
+  if (!wizard()->localImage().isEmpty()) {
+    return true;
+  }
   if (!gondar::isChromeover()) {
     // in the beerover case, we need to have retrieved the latest image url
     return wizard()->newestIsReady();
@@ -101,7 +124,7 @@ bool AdminCheckPage::validatePage() {
 }
 
 int AdminCheckPage::nextId() const {
-  if (wizard()->isFormatOnly()) {
+  if (wizard()->isFormatOnly() || !wizard()->localImage().isEmpty()) {
     return GondarWizard::Page_usbInsert;
   }
   if (gondar::isChromeover()) {
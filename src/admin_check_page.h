@@ -28,6 +28,7 @@ class AdminCheckPage : public gondar::WizardPage {
   explicit AdminCheckPage(QWidget* parent = 0);
   int nextId() const override;
   void handleFormatOnly();
+  void handleLocalImage();
 
  protected:
   void initializePage() override;
@@ -40,6 +41,8 @@ class AdminCheckPage : public gondar::WizardPage {
   QLabel label;
   // offer the users a way to format their disk
   QLabel formatLink;
+  // or to use an image they already have instead of downloading one
+  QLabel localImageLink;
   bool is_admin;
   QVBoxLayout layout;
 };
@@ -0,0 +1,273 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "async_log_appender.h"
+
+#include <plog/Converters/UTF8Converter.h>
+#include <plog/Formatters/TxtFormatter.h>
+
+#include <QFileInfo>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace gondar {
+
+namespace {
+
+// A producer can race with the background thread going to sleep; this
+// bounds how long such a record waits
+const auto drain_interval = std::chrono::milliseconds(100);
+
+// How long flush(false) keeps trying before giving up
+const int flush_attempts = 1000;
+
+int openForAppend(const QString& path) {
+#ifdef _WIN32
+  return _wopen(reinterpret_cast<const wchar_t*>(path.utf16()),
+                _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY,
+                _S_IREAD | _S_IWRITE);
+#else
+  return open(QFile::encodeName(path).constData(),
+              O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+}
+
+void closeRaw(const int fd) {
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+// Async-signal-safe
+void writeRaw(const int fd, const char* data, size_t size) {
+  while (size > 0) {
+#ifdef _WIN32
+    const int count = _write(fd, data, static_cast<unsigned>(size));
+#else
+    const ssize_t count = write(fd, data, size);
+#endif
+    if (count <= 0) {
+      return;
+    }
+    data += count;
+    size -= static_cast<size_t>(count);
+  }
+}
+
+}  // namespace
+
+AsyncLogAppender::AsyncLogAppender(const QString& path,
+                                   const int64_t max_file_size,
+                                   const int max_files,
+                                   const bool log_to_console)
+    : head_(&stub_),
+      tail_(&stub_),
+      path_(path),
+      max_file_size_(max_file_size),
+      max_files_(max_files),
+      log_to_console_(log_to_console),
+      file_(path) {
+  openFile();
+  thread_ = std::thread(&AsyncLogAppender::run, this);
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+  stop_ = true;
+  wake_.notify_one();
+  thread_.join();
+  flush();
+  const int fd = signal_fd_.exchange(-1);
+  if (fd >= 0) {
+    closeRaw(fd);
+  }
+}
+
+void AsyncLogAppender::write(const plog::Record& record) {
+  Node* node = new Node;
+  node->line =
+      plog::UTF8Converter::convert(plog::TxtFormatter::format(record));
+  push(node);
+  if (!pending_.exchange(true)) {
+    wake_.notify_one();
+  }
+}
+
+void AsyncLogAppender::flush(const bool wait) {
+  int attempts = 0;
+  while (draining_.test_and_set(std::memory_order_acquire)) {
+    if (!wait && ++attempts == flush_attempts) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+  drain();
+  draining_.clear(std::memory_order_release);
+}
+
+void AsyncLogAppender::flushFromSignal() {
+  if (draining_.test_and_set(std::memory_order_acquire)) {
+    return;
+  }
+  // Walk the list without popping, so nothing is freed. A producer
+  // halfway through push() may leave its record and any after it
+  // unreachable.
+  const int fd = signal_fd_.load();
+  for (Node* node = tail_; node;
+       node = node->next.load(std::memory_order_acquire)) {
+    if (node == &stub_) {
+      continue;
+    }
+    if (fd >= 0) {
+      writeRaw(fd, node->line.data(), node->line.size());
+    }
+    if (log_to_console_) {
+#ifdef _WIN32
+      writeRaw(1, node->line.data(), node->line.size());
+#else
+      writeRaw(STDOUT_FILENO, node->line.data(), node->line.size());
+#endif
+    }
+  }
+  draining_.clear(std::memory_order_release);
+}
+
+void AsyncLogAppender::push(Node* node) {
+  node->next.store(nullptr, std::memory_order_relaxed);
+  Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+}
+
+AsyncLogAppender::Node* AsyncLogAppender::pop() {
+  Node* tail = tail_;
+  Node* next = tail->next.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (!next) {
+      return nullptr;
+    }
+    tail_ = next;
+    tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+  // |tail| is the last node unless a producer is halfway through
+  // push(), in which case its record is picked up next time
+  if (tail != head_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  push(&stub_);
+  next = tail->next.load(std::memory_order_acquire);
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+void AsyncLogAppender::drain() {
+  bool wrote = false;
+  while (Node* node = pop()) {
+    writeLine(node->line);
+    delete node;
+    wrote = true;
+  }
+  if (wrote) {
+    file_.flush();
+    if (log_to_console_) {
+      fflush(stdout);
+    }
+  }
+}
+
+void AsyncLogAppender::writeLine(const std::string& line) {
+  if (file_size_ > 0 &&
+      file_size_ + static_cast<int64_t>(line.size()) > max_file_size_) {
+    rollFiles();
+  }
+  if (file_.isOpen()) {
+    file_size_ += file_.write(line.data(), line.size());
+  }
+  if (log_to_console_) {
+    fwrite(line.data(), 1, line.size(), stdout);
+  }
+}
+
+void AsyncLogAppender::openFile() {
+  if (file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    file_size_ = file_.size();
+    // Follow the file across rolls
+    const int old_fd = signal_fd_.exchange(openForAppend(path_));
+    if (old_fd >= 0) {
+      closeRaw(old_fd);
+    }
+  } else {
+    fprintf(stderr, "failed to open log file: %s\n",
+            path_.toStdString().c_str());
+    file_size_ = 0;
+  }
+}
+
+// name.log becomes name.1.log, name.1.log becomes name.2.log and so
+// on, dropping the oldest
+void AsyncLogAppender::rollFiles() {
+  // Windows won't rename a file that is still open, so the signal
+  // handler's descriptor goes too until openFile() makes a new one
+  const int fd = signal_fd_.exchange(-1);
+  if (fd >= 0) {
+    closeRaw(fd);
+  }
+  file_.close();
+  const QFileInfo info(path_);
+  const QString base = info.path() + "/" + info.completeBaseName();
+  const QString suffix = info.suffix();
+  auto numbered = [&](const int index) {
+    return QString("%1.%2.%3").arg(base).arg(index).arg(suffix);
+  };
+  QFile::remove(numbered(max_files_ - 1));
+  for (int i = max_files_ - 2; i >= 1; i--) {
+    QFile::rename(numbered(i), numbered(i + 1));
+  }
+  if (max_files_ > 1) {
+    QFile::rename(path_, numbered(1));
+  } else {
+    QFile::remove(path_);
+  }
+  openFile();
+}
+
+void AsyncLogAppender::run() {
+  while (!stop_) {
+    pending_ = false;
+    flush();
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait_for(lock, drain_interval,
+                   [this]() { return stop_ || pending_; });
+  }
+}
+
+}  // namespace gondar
@@ -0,0 +1,104 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_ASYNC_LOG_APPENDER_H_
+#define SRC_ASYNC_LOG_APPENDER_H_
+
+// Qt headers first to ensure that the plog internal ifdefs enable Qt
+// support
+#include <QFile>
+#include <QString>
+
+#include <plog/Appenders/IAppender.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace gondar {
+
+// plog appender that keeps file and console I/O off the logging
+// thread. Records are formatted by the caller and pushed onto a
+// lock-free list; a background thread writes them to a rolling log
+// file (same naming as plog's RollingFileAppender) and optionally to
+// stdout. Whatever is still queued is written out by flush() and by
+// the destructor.
+class AsyncLogAppender : public plog::IAppender {
+ public:
+  AsyncLogAppender(const QString& path,
+                   int64_t max_file_size,
+                   int max_files,
+                   bool log_to_console);
+  ~AsyncLogAppender() override;
+
+  void write(const plog::Record& record) override;
+
+  // Write out everything queued so far. With |wait| false this gives
+  // up instead of waiting for the background thread, which is what a
+  // terminate handler needs.
+  void flush(bool wait = true);
+
+  // The same from a signal handler, where only async-signal-safe calls
+  // are allowed: queued lines are written with raw write(2) calls to a
+  // descriptor opened up front, and nothing is allocated or freed.
+  // Best effort; if another thread is in the middle of draining, its
+  // lines are lost.
+  void flushFromSignal();
+
+ private:
+  struct Node {
+    std::string line;
+    std::atomic<Node*> next{nullptr};
+  };
+
+  void push(Node* node);
+  // Single consumer; only called with |draining_| held
+  Node* pop();
+  void drain();
+  void writeLine(const std::string& line);
+  void openFile();
+  void rollFiles();
+  void run();
+
+  // Producers swap themselves in at |head_|; the consumer reads from
+  // |tail_|. |stub_| keeps the list non-empty.
+  std::atomic<Node*> head_;
+  Node* tail_;
+  Node stub_;
+  std::atomic_flag draining_ = ATOMIC_FLAG_INIT;
+
+  std::atomic<bool> pending_{false};
+  std::atomic<bool> stop_{false};
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+
+  const QString path_;
+  const int64_t max_file_size_;
+  const int max_files_;
+  const bool log_to_console_;
+  QFile file_;
+  int64_t file_size_ = 0;
+  // Another descriptor for the current log file, for flushFromSignal()
+  std::atomic<int> signal_fd_{-1};
+
+  std::thread thread_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_ASYNC_LOG_APPENDER_H_
@@ -0,0 +1,111 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "auto_flash_panel.h"
+
+#include <QStyle>
+
+namespace gondar {
+
+namespace {
+
+QString statusText(const AutoFlasher::Status status) {
+  switch (status) {
+    case AutoFlasher::Status::Queued:
+      return "waiting for a free slot on its hub";
+    case AutoFlasher::Status::Writing:
+      return "writing...";
+    case AutoFlasher::Status::Succeeded:
+      return "done, ready to remove";
+    case AutoFlasher::Status::Failed:
+      return "failed";
+    case AutoFlasher::Status::TooSmall:
+      return "too small, skipped";
+    case AutoFlasher::Status::Removed:
+      return "removed";
+  }
+  return QString();
+}
+
+QStyle::StandardPixmap statusIcon(const AutoFlasher::Status status) {
+  switch (status) {
+    case AutoFlasher::Status::Queued:
+      return QStyle::SP_MediaPause;
+    case AutoFlasher::Status::Writing:
+      return QStyle::SP_BrowserReload;
+    case AutoFlasher::Status::Succeeded:
+      return QStyle::SP_DialogApplyButton;
+    case AutoFlasher::Status::Failed:
+      return QStyle::SP_MessageBoxCritical;
+    case AutoFlasher::Status::TooSmall:
+      return QStyle::SP_MessageBoxWarning;
+    case AutoFlasher::Status::Removed:
+      return QStyle::SP_DialogCloseButton;
+  }
+  return QStyle::SP_CustomBase;
+}
+
+}  // namespace
+
+AutoFlashPanel::AutoFlashPanel() {
+  enable_.setText(
+      "Automatically write this image to every USB device inserted from now "
+      "on");
+  layout_.addWidget(&enable_);
+  layout_.addWidget(&ports_);
+  layout_.setContentsMargins(0, 0, 0, 0);
+  setLayout(&layout_);
+  ports_.hide();
+
+  connect(&enable_, &QCheckBox::toggled, this, &AutoFlashPanel::onToggled);
+  connect(&flasher_, &AutoFlasher::statusChanged, this,
+          &AutoFlashPanel::onStatusChanged);
+}
+
+void AutoFlashPanel::setImagePath(const QString& image_path) {
+  image_path_ = image_path;
+}
+
+void AutoFlashPanel::reset() {
+  enable_.setChecked(false);
+  flasher_.stop();
+  ports_.clear();
+  ports_.hide();
+  rows_.clear();
+}
+
+void AutoFlashPanel::onToggled(const bool checked) {
+  if (checked) {
+    ports_.show();
+    flasher_.start(image_path_);
+  } else {
+    flasher_.stop();
+  }
+}
+
+void AutoFlashPanel::onStatusChanged(const DeviceGuy& device,
+                                     const AutoFlasher::Status status) {
+  const auto key = std::make_pair(device.device_num, device.name);
+  QListWidgetItem* row = rows_[key];
+  if (!row) {
+    row = new QListWidgetItem(&ports_);
+    rows_[key] = row;
+  }
+  row->setText(QString::fromStdString(device.name) + ": " +
+               statusText(status));
+  row->setIcon(style()->standardIcon(statusIcon(status)));
+}
+
+}  // namespace gondar
@@ -0,0 +1,57 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_AUTO_FLASH_PANEL_H_
+#define SRC_AUTO_FLASH_PANEL_H_
+
+#include <QCheckBox>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "auto_flasher.h"
+
+namespace gondar {
+
+// Opt-in checkbox for auto-flash mode, plus one status row per USB
+// port that auto-flash has touched
+class AutoFlashPanel : public QWidget {
+  Q_OBJECT
+
+ public:
+  AutoFlashPanel();
+
+  void setImagePath(const QString& image_path);
+  // Turn auto-flash off and clear the status rows
+  void reset();
+
+ private:
+  void onToggled(bool checked);
+  void onStatusChanged(const DeviceGuy& device, AutoFlasher::Status status);
+
+  QVBoxLayout layout_;
+  QCheckBox enable_;
+  QListWidget ports_;
+  AutoFlasher flasher_;
+  QString image_path_;
+  std::map<std::pair<uint32_t, std::string>, QListWidgetItem*> rows_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_AUTO_FLASH_PANEL_H_
@@ -0,0 +1,150 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "auto_flasher.h"
+
+#include <algorithm>
+
+#include "gondar.h"
+#include "log.h"
+
+namespace gondar {
+
+namespace {
+
+// Same polling rate as UsbInsertPage
+const int poll_interval_ms = 1000;
+
+bool contains(const DeviceGuyList& devices, const DeviceGuy& device) {
+  return std::find(devices.begin(), devices.end(), device) != devices.end();
+}
+
+void remove(DeviceGuyList* devices, const DeviceGuy& device) {
+  devices->erase(std::remove(devices->begin(), devices->end(), device),
+                 devices->end());
+}
+
+// The entry of |devices| equal to |device|, or null if there is none
+const DeviceGuy* find(const DeviceGuyList& devices, const DeviceGuy& device) {
+  const auto iter = std::find(devices.begin(), devices.end(), device);
+  return iter == devices.end() ? nullptr : &*iter;
+}
+
+// Whether |a| and |b|, which are equal, are also the same stick rather
+// than two of the same model that got the same device number
+bool sameStick(const DeviceGuy& a, const DeviceGuy& b) {
+  return a.instance_path == b.instance_path && a.num_bytes == b.num_bytes;
+}
+
+}  // namespace
+
+AutoFlasher::AutoFlasher(QObject* parent) : QObject(parent) {
+  poll_timer_.setInterval(poll_interval_ms);
+  connect(&poll_timer_, &QTimer::timeout, this, &AutoFlasher::poll);
+  connect(&scheduler_, &WriteScheduler::writeStarted, this,
+          [this](const DeviceGuy& device) {
+            emit statusChanged(device, Status::Writing);
+          });
+  connect(&scheduler_, &WriteScheduler::writeFinished, this,
+          &AutoFlasher::onWriteFinished);
+}
+
+void AutoFlasher::start(const QString& image_path) {
+  LOG_INFO << "auto-flash watching for new devices, image " << image_path;
+  image_path_ = image_path;
+  known_ = GetDeviceList();
+  poll_timer_.start();
+}
+
+void AutoFlasher::stop() {
+  if (poll_timer_.isActive()) {
+    LOG_INFO << "auto-flash stopped";
+  }
+  poll_timer_.stop();
+}
+
+bool AutoFlasher::isWatching() const {
+  return poll_timer_.isActive();
+}
+
+void AutoFlasher::poll() {
+  const DeviceGuyList current = GetDeviceList();
+
+  // A stick swapped for another between polls can come back under the
+  // same device number, and counts as removed and inserted
+  DeviceGuyList replaced;
+  for (const auto& device : current) {
+    const DeviceGuy* before = find(known_, device);
+    const DeviceGuy* finished = find(done_, device);
+    if (contains(busy_, device)) {
+      continue;
+    }
+    if ((before && !sameStick(*before, device)) ||
+        (finished && !sameStick(*finished, device))) {
+      replaced.push_back(device);
+    }
+  }
+
+  for (const auto& device : known_) {
+    // the write holds the device, which can hide it from the list
+    if ((!contains(current, device) && !contains(busy_, device)) ||
+        contains(replaced, device)) {
+      LOG_INFO << "auto-flash: removed " << device;
+      emit statusChanged(device, Status::Removed);
+    }
+  }
+  // a finished device is armed again once it has really gone
+  DeviceGuyList still_done;
+  for (const auto& device : done_) {
+    if (contains(current, device) && !contains(replaced, device)) {
+      still_done.push_back(device);
+    } else if (!contains(known_, device)) {
+      LOG_INFO << "auto-flash: removed " << device;
+      emit statusChanged(device, Status::Removed);
+    }
+  }
+  done_ = still_done;
+
+  for (const auto& device : current) {
+    if ((contains(known_, device) && !contains(replaced, device)) ||
+        contains(busy_, device) || contains(done_, device)) {
+      continue;
+    }
+    LOG_INFO << "auto-flash: inserted " << device;
+    if (device.isBigEnough()) {
+      busy_.push_back(device);
+      // before enqueue(), which may start the write right away
+      emit statusChanged(device, Status::Queued);
+      if (!scheduler_.enqueue(device, image_path_)) {
+        remove(&busy_, device);
+      }
+    } else {
+      emit statusChanged(device, Status::TooSmall);
+    }
+  }
+
+  known_ = current;
+}
+
+void AutoFlasher::onWriteFinished(const DeviceGuy& device,
+                                  const bool success) {
+  LOG_INFO << "auto-flash: " << device
+           << (success ? " succeeded" : " failed");
+  remove(&busy_, device);
+  done_.push_back(device);
+  emit statusChanged(device, success ? Status::Succeeded : Status::Failed);
+}
+
+}  // namespace gondar
@@ -0,0 +1,76 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_AUTO_FLASHER_H_
+#define SRC_AUTO_FLASHER_H_
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "device.h"
+#include "write_scheduler.h"
+
+namespace gondar {
+
+// Watches for newly inserted USB devices and writes an image to each
+// one without asking. Devices that are already attached when watching
+// starts are left alone; a device is written again only after it has
+// been seen missing while no write to it was running, or replaced by
+// another stick. A device being written can drop out of the device
+// list, since the write holds it open, and that doesn't count as a
+// removal.
+class AutoFlasher : public QObject {
+  Q_OBJECT
+
+ public:
+  enum class Status {
+    Queued,
+    Writing,
+    Succeeded,
+    Failed,
+    TooSmall,
+    Removed,
+  };
+
+  explicit AutoFlasher(QObject* parent = nullptr);
+
+  void start(const QString& image_path);
+  // Stop watching. Writes that are already running are not
+  // interrupted.
+  void stop();
+  bool isWatching() const;
+
+ signals:
+  void statusChanged(const DeviceGuy& device, AutoFlasher::Status status);
+
+ private:
+  void poll();
+  void onWriteFinished(const DeviceGuy& device, bool success);
+
+  QTimer poll_timer_;
+  QString image_path_;
+  // The device list from the previous poll
+  DeviceGuyList known_;
+  // Devices with a write queued or running
+  DeviceGuyList busy_;
+  // Devices whose write has finished, until they are next seen missing
+  DeviceGuyList done_;
+  WriteScheduler scheduler_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_AUTO_FLASHER_H_
@@ -0,0 +1,264 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "block_map.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QXmlStreamReader>
+#include <algorithm>
+#include <utility>
+
+#include "log.h"
+
+namespace gondar {
+
+namespace {
+
+// Hex digits in a digest of |type|
+int hexLength(const QCryptographicHash::Algorithm type) {
+  return type == QCryptographicHash::Sha1 ? 40 : 64;
+}
+
+// Version 2 bmaps carry a checksum of themselves, taken with the
+// checksum's own digits replaced by zeroes
+bool bmapChecksumMatches(QByteArray contents,
+                         const QByteArray& checksum,
+                         const QCryptographicHash::Algorithm type) {
+  const int at = contents.indexOf(checksum);
+  if (at < 0) {
+    return false;
+  }
+  contents.replace(at, checksum.size(), QByteArray(checksum.size(), '0'));
+  return QCryptographicHash::hash(contents, type).toHex() == checksum;
+}
+
+}  // namespace
+
+Option<BlockMap> BlockMap::load(const QString& path, QString* error) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    *error = "can't open " + path + ": " + file.errorString();
+    return nullopt;
+  }
+  const QByteArray contents = file.readAll();
+
+  BlockMap map;
+  uint64_t blocks_count = 0;
+  QByteArray bmap_checksum;
+  int major_version = 0;
+  bool have_type = false;
+
+  QXmlStreamReader xml(contents);
+  while (!xml.atEnd() && !xml.hasError()) {
+    if (xml.readNext() != QXmlStreamReader::StartElement) {
+      continue;
+    }
+    const auto name = xml.name();
+    if (name == "bmap") {
+      major_version = xml.attributes()
+                          .value("version")
+                          .toString()
+                          .section('.', 0, 0)
+                          .toInt();
+    } else if (name == "ImageSize") {
+      map.image_size_ = xml.readElementText().trimmed().toULongLong();
+    } else if (name == "BlockSize") {
+      map.block_size_ = xml.readElementText().trimmed().toUInt();
+    } else if (name == "BlocksCount") {
+      blocks_count = xml.readElementText().trimmed().toULongLong();
+    } else if (name == "ChecksumType") {
+      const QString type = xml.readElementText().trimmed();
+      if (type == "sha1") {
+        map.checksum_type_ = QCryptographicHash::Sha1;
+      } else if (type == "sha256") {
+        map.checksum_type_ = QCryptographicHash::Sha256;
+      } else {
+        *error = "unsupported checksum type " + type;
+        return nullopt;
+      }
+      have_type = true;
+    } else if (name == "BmapFileChecksum" || name == "BmapFileSHA1") {
+      bmap_checksum = xml.readElementText().trimmed().toLatin1();
+    } else if (name == "Range") {
+      Range range;
+      // version 1 only ever used SHA-1, under its own attribute name
+      const auto attributes = xml.attributes();
+      range.checksum = (attributes.hasAttribute("chksum")
+                            ? attributes.value("chksum")
+                            : attributes.value("sha1"))
+                           .toString()
+                           .toLatin1()
+                           .toLower();
+      const QString text = xml.readElementText().trimmed();
+      bool ok_first = false;
+      bool ok_last = false;
+      range.first = text.section('-', 0, 0).toULongLong(&ok_first);
+      range.last = text.contains('-')
+                       ? text.section('-', 1, 1).toULongLong(&ok_last)
+                       : range.first;
+      if (!ok_first || (text.contains('-') && !ok_last) ||
+          range.last < range.first) {
+        *error = "bad range \"" + text + "\"";
+        return nullopt;
+      }
+      map.ranges_.push_back(range);
+    }
+  }
+  if (xml.hasError()) {
+    *error = "bad XML: " + xml.errorString();
+    return nullopt;
+  }
+
+  if (major_version < 1 || major_version > 2) {
+    *error = QString("unsupported bmap version %1").arg(major_version);
+    return nullopt;
+  }
+  if (major_version == 1 && !have_type) {
+    map.checksum_type_ = QCryptographicHash::Sha1;
+  }
+  if (map.block_size_ == 0 || map.image_size_ == 0) {
+    *error = "missing ImageSize or BlockSize";
+    return nullopt;
+  }
+  if (!bmap_checksum.isEmpty() &&
+      !bmapChecksumMatches(contents, bmap_checksum, map.checksum_type_)) {
+    *error = "the bmap's own checksum does not match";
+    return nullopt;
+  }
+
+  std::sort(map.ranges_.begin(), map.ranges_.end(),
+            [](const Range& a, const Range& b) { return a.first < b.first; });
+  for (size_t i = 0; i < map.ranges_.size(); i++) {
+    const Range& range = map.ranges_[i];
+    if (range.last >= blocks_count ||
+        range.first * map.block_size_ >= map.image_size_) {
+      *error = QString("range %1-%2 is past the end of the image")
+                   .arg(range.first)
+                   .arg(range.last);
+      return nullopt;
+    }
+    if (i > 0 && range.first <= map.ranges_[i - 1].last) {
+      *error = QString("range %1-%2 overlaps the one before it")
+                   .arg(range.first)
+                   .arg(range.last);
+      return nullopt;
+    }
+    if (range.checksum.size() != hexLength(map.checksum_type_)) {
+      *error = QString("range %1-%2 has a malformed checksum")
+                   .arg(range.first)
+                   .arg(range.last);
+      return nullopt;
+    }
+  }
+  return map;
+}
+
+Option<BlockMap> BlockMap::findFor(const QString& image_path,
+                                   const uint64_t image_size) {
+  const QFileInfo image(image_path);
+  const QStringList candidates = {
+      image_path + ".bmap",
+      image.absoluteDir().filePath(image.completeBaseName() + ".bmap")};
+  for (const QString& path : candidates) {
+    if (!QFileInfo(path).isFile()) {
+      continue;
+    }
+    QString error;
+    auto map = load(path, &error);
+    if (!map) {
+      LOG_WARNING << "ignoring " << path << ": " << error;
+      continue;
+    }
+    if (map->imageSize() != image_size) {
+      LOG_WARNING << "ignoring " << path << ", it describes an image of "
+                  << map->imageSize() << " bytes, not " << image_size;
+      continue;
+    }
+    LOG_INFO << "using block map " << path << ": " << map->mappedBytes()
+             << " of " << image_size << " bytes mapped";
+    return map;
+  }
+  return nullopt;
+}
+
+BlockMap BlockMap::fromRanges(const uint64_t image_size,
+                              const uint32_t block_size,
+                              std::vector<Range> ranges) {
+  BlockMap map;
+  map.image_size_ = image_size;
+  map.block_size_ = block_size;
+  map.ranges_ = std::move(ranges);
+  return map;
+}
+
+uint64_t BlockMap::rangeStart(const Range& range) const {
+  return range.first * block_size_;
+}
+
+uint64_t BlockMap::rangeEnd(const Range& range) const {
+  return std::min(image_size_, (range.last + 1) * block_size_);
+}
+
+uint64_t BlockMap::mappedBytes() const {
+  uint64_t bytes = 0;
+  for (const auto& range : ranges_) {
+    bytes += rangeEnd(range) - rangeStart(range);
+  }
+  return bytes;
+}
+
+QByteArray BlockMap::toXml() const {
+  const char* type =
+      checksum_type_ == QCryptographicHash::Sha1 ? "sha1" : "sha256";
+  const uint64_t blocks = (image_size_ + block_size_ - 1) / block_size_;
+  uint64_t mapped_blocks = 0;
+  for (const auto& range : ranges_) {
+    mapped_blocks += range.last - range.first + 1;
+  }
+
+  QByteArray xml = "<?xml version=\"1.0\" ?>\n<bmap version=\"2.0\">\n";
+  xml += "    <ImageSize> " + QByteArray::number(image_size_) +
+         " </ImageSize>\n";
+  xml += "    <BlockSize> " + QByteArray::number(block_size_) +
+         " </BlockSize>\n";
+  xml += "    <BlocksCount> " + QByteArray::number(blocks) +
+         " </BlocksCount>\n";
+  xml += "    <MappedBlocksCount> " + QByteArray::number(mapped_blocks) +
+         " </MappedBlocksCount>\n";
+  xml += QByteArray("    <ChecksumType> ") + type + " </ChecksumType>\n";
+  // Filled in below, once the rest of the file is known
+  const QByteArray placeholder(hexLength(checksum_type_), '0');
+  xml += "    <BmapFileChecksum> " + placeholder + " </BmapFileChecksum>\n";
+  xml += "    <BlockMap>\n";
+  for (const auto& range : ranges_) {
+    QByteArray blocks_text = QByteArray::number(range.first);
+    if (range.last != range.first) {
+      blocks_text += "-" + QByteArray::number(range.last);
+    }
+    xml += "        <Range chksum=\"" + range.checksum + "\"> " +
+           blocks_text + " </Range>\n";
+  }
+  xml += "    </BlockMap>\n</bmap>\n";
+
+  const QByteArray checksum =
+      QCryptographicHash::hash(xml, checksum_type_).toHex();
+  xml.replace(xml.indexOf(placeholder), placeholder.size(), checksum);
+  return xml;
+}
+
+}  // namespace gondar
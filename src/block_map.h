@@ -0,0 +1,86 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_BLOCK_MAP_H_
+#define SRC_BLOCK_MAP_H_
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+#include "option.h"
+
+namespace gondar {
+
+// The blocks of an image that hold data, as listed by a bmaptool-style
+// .bmap file. Writing only these ranges leaves the rest of the drive
+// untouched, which for a mostly empty image saves most of the write.
+// Each range carries a checksum of its data so the copy can be checked
+// as it goes.
+class BlockMap {
+ public:
+  struct Range {
+    // Inclusive block numbers
+    uint64_t first = 0;
+    uint64_t last = 0;
+    // Hex digest of the range's data. Empty for maps worked out from
+    // the image itself, which have nothing to check against.
+    QByteArray checksum;
+  };
+
+  // A map of |ranges|, which must be sorted and not overlap. Their
+  // checksums, if any, are SHA-256.
+  static BlockMap fromRanges(uint64_t image_size,
+                             uint32_t block_size,
+                             std::vector<Range> ranges);
+
+  // Parse the bmap at |path| (format version 1.x or 2.x). On failure
+  // |error| says why.
+  static Option<BlockMap> load(const QString& path, QString* error);
+  // Look for image.bin.bmap or image.bmap next to |image_path| and
+  // load it if it describes an image of |image_size| bytes
+  static Option<BlockMap> findFor(const QString& image_path,
+                                  uint64_t image_size);
+
+  uint64_t imageSize() const { return image_size_; }
+  uint32_t blockSize() const { return block_size_; }
+  QCryptographicHash::Algorithm checksumType() const {
+    return checksum_type_;
+  }
+  const std::vector<Range>& ranges() const { return ranges_; }
+
+  // Byte range of |range| within the image; the last block may be
+  // short
+  uint64_t rangeStart(const Range& range) const;
+  uint64_t rangeEnd(const Range& range) const;
+  // Bytes the ranges cover
+  uint64_t mappedBytes() const;
+
+  // The map in bmap format 2.0, with its own checksum filled in. Every
+  // range must have a checksum.
+  QByteArray toXml() const;
+
+ private:
+  uint64_t image_size_ = 0;
+  uint32_t block_size_ = 0;
+  QCryptographicHash::Algorithm checksum_type_ = QCryptographicHash::Sha256;
+  std::vector<Range> ranges_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_BLOCK_MAP_H_
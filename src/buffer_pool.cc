@@ -0,0 +1,158 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "buffer_pool.h"
+
+#include <QtGlobal>
+
+#include "log.h"
+
+namespace gondar {
+
+BufferPool::BufferPool(const size_t budget_bytes) : budget_(budget_bytes) {
+  for (auto& slots : slots_) {
+    for (auto& slot : slots) {
+      slot = nullptr;
+    }
+  }
+}
+
+BufferPool::~BufferPool() {
+  trim();
+  const Stats stats = this->stats();
+  LOG_INFO << "buffer pool: peak " << stats.peak_in_use_bytes
+           << " bytes in use, " << stats.allocations << " allocations, "
+           << stats.reuses << " reuses, " << stats.refusals << " refusals";
+}
+
+BufferPool* BufferPool::instance() {
+  static BufferPool pool(default_budget);
+  return &pool;
+}
+
+int BufferPool::sizeClass(const size_t size) {
+  for (int size_class = 0; size_class < class_count; size_class++) {
+    if (size <= classSize(size_class)) {
+      return size_class;
+    }
+  }
+  return -1;
+}
+
+size_t BufferPool::classSize(const int size_class) {
+  return buffer_alignment << size_class;
+}
+
+bool BufferPool::reserve(const size_t bytes) {
+  size_t in_use = in_use_;
+  do {
+    if (in_use + bytes > budget_) {
+      return false;
+    }
+  } while (!in_use_.compare_exchange_weak(in_use, in_use + bytes));
+  notePeak(in_use + bytes);
+  return true;
+}
+
+void BufferPool::notePeak(const size_t in_use) {
+  size_t peak = peak_in_use_;
+  while (in_use > peak && !peak_in_use_.compare_exchange_weak(peak, in_use)) {
+  }
+}
+
+uint8_t* BufferPool::acquire(const size_t size, size_t* capacity) {
+  const int size_class = sizeClass(size);
+  if (size_class < 0) {
+    *capacity =
+        ((size + buffer_alignment - 1) / buffer_alignment) * buffer_alignment;
+  } else {
+    *capacity = classSize(size_class);
+    for (auto& slot : slots_[size_class]) {
+      uint8_t* block = slot.exchange(nullptr);
+      if (block) {
+        cached_ -= *capacity;
+        notePeak(in_use_ += *capacity);
+        reuses_++;
+        return block;
+      }
+    }
+  }
+
+  // Parked blocks of other sizes count against the budget too; drop
+  // them before turning the request down
+  if (in_use_ + cached_ + *capacity > budget_) {
+    trim();
+  }
+  if (!reserve(*capacity)) {
+    LOG_WARNING << "buffer pool budget exhausted, refusing " << size
+                << " bytes";
+    refusals_++;
+    return nullptr;
+  }
+
+  auto* block =
+      static_cast<uint8_t*>(qMallocAligned(*capacity, buffer_alignment));
+  if (!block) {
+    in_use_ -= *capacity;
+    return nullptr;
+  }
+  allocations_++;
+  return block;
+}
+
+void BufferPool::release(uint8_t* block, const size_t capacity) {
+  if (!block) {
+    return;
+  }
+  const int size_class = sizeClass(capacity);
+  if (size_class >= 0 && classSize(size_class) == capacity) {
+    cached_ += capacity;
+    for (auto& slot : slots_[size_class]) {
+      uint8_t* empty = nullptr;
+      if (slot.compare_exchange_strong(empty, block)) {
+        in_use_ -= capacity;
+        return;
+      }
+    }
+    cached_ -= capacity;
+  }
+  in_use_ -= capacity;
+  qFreeAligned(block);
+}
+
+BufferPool::Stats BufferPool::stats() const {
+  Stats stats;
+  stats.in_use_bytes = in_use_;
+  stats.cached_bytes = cached_;
+  stats.peak_in_use_bytes = peak_in_use_;
+  stats.allocations = allocations_;
+  stats.reuses = reuses_;
+  stats.refusals = refusals_;
+  return stats;
+}
+
+void BufferPool::trim() {
+  for (int size_class = 0; size_class < class_count; size_class++) {
+    for (auto& slot : slots_[size_class]) {
+      uint8_t* block = slot.exchange(nullptr);
+      if (block) {
+        cached_ -= classSize(size_class);
+        qFreeAligned(block);
+      }
+    }
+  }
+}
+
+}  // namespace gondar
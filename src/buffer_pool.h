@@ -0,0 +1,98 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_BUFFER_POOL_H_
+#define SRC_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace gondar {
+
+// Blocks are aligned for unbuffered disk I/O on both 512-byte and 4K
+// sector devices
+const size_t buffer_alignment = 4096;
+
+// Process-wide cache of aligned I/O blocks, shared by the disk writer
+// and the pipeline so that streaming many gigabytes does not mean
+// allocating and freeing a large aligned block for every chunk.
+//
+// Sizes are rounded up to a power of two. Freed blocks are parked in
+// a few fixed slots per size and taken again with a single atomic
+// exchange, so acquire() and release() never lock. Everything
+// outstanding or parked counts against a memory budget; once that is
+// used up, acquire() returns nullptr instead of growing.
+class BufferPool {
+ public:
+  static const size_t default_budget = 256 * 1024 * 1024;
+
+  explicit BufferPool(size_t budget_bytes);
+  ~BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  static BufferPool* instance();
+
+  // Get a block of at least |size| bytes. Its real size is stored in
+  // |*capacity| and must be passed back to release(). Returns nullptr
+  // if the budget does not allow it.
+  uint8_t* acquire(size_t size, size_t* capacity);
+  void release(uint8_t* block, size_t capacity);
+
+  struct Stats {
+    size_t in_use_bytes = 0;
+    size_t cached_bytes = 0;
+    // High-water mark of |in_use_bytes|
+    size_t peak_in_use_bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+    // acquire() calls turned down because of the budget
+    uint64_t refusals = 0;
+  };
+  Stats stats() const;
+
+  // Free every parked block
+  void trim();
+
+ private:
+  // Blocks from 4 KiB to 64 MiB are pooled; bigger ones are allocated
+  // and freed directly
+  static const int class_count = 15;
+  static const int slots_per_class = 8;
+
+  // Index of the smallest class that holds |size|, or -1 if it is too
+  // big to pool
+  static int sizeClass(size_t size);
+  static size_t classSize(int size_class);
+
+  // Count |bytes| as in use if the budget allows it
+  bool reserve(size_t bytes);
+  void notePeak(size_t in_use);
+
+  const size_t budget_;
+  std::atomic<uint8_t*> slots_[class_count][slots_per_class];
+  std::atomic<size_t> in_use_{0};
+  std::atomic<size_t> cached_{0};
+  std::atomic<size_t> peak_in_use_{0};
+  std::atomic<uint64_t> allocations_{0};
+  std::atomic<uint64_t> reuses_{0};
+  std::atomic<uint64_t> refusals_{0};
+};
+
+}  // namespace gondar
+
+#endif  // SRC_BUFFER_POOL_H_
@@ -0,0 +1,120 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "chunked_image.h"
+
+#include <QFileInfo>
+#include <QList>
+#include <algorithm>
+
+namespace gondar {
+
+namespace {
+
+const char manifest_magic[] = "thoriumos-image-chunks 1";
+
+bool isSha256Hex(const QByteArray& hex) {
+  if (hex.size() != 64) {
+    return false;
+  }
+  for (const char c : hex) {
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+const char chunk_manifest_entry[] = "manifest";
+
+QString ChunkEntryName(const size_t index) {
+  return QString("chunk-%1").arg(index, 5, 10, QChar('0'));
+}
+
+size_t ChunkManifest::chunkCount() const {
+  return chunk_sha256.size();
+}
+
+uint64_t ChunkManifest::chunkOffset(const size_t index) const {
+  return index * chunk_size;
+}
+
+uint64_t ChunkManifest::chunkLength(const size_t index) const {
+  return std::min(chunk_size, image_size - chunkOffset(index));
+}
+
+// The format is line based:
+//
+//   thoriumos-image-chunks 1
+//   image <size> <name>
+//   chunk-size <bytes>
+//   <sha256 of chunk 0>
+//   ...
+QByteArray ChunkManifest::serialize() const {
+  QByteArray data = manifest_magic;
+  data += "\nimage " + QByteArray::number(image_size) + " " +
+          image_name.toUtf8() + "\n";
+  data += "chunk-size " + QByteArray::number(chunk_size) + "\n";
+  for (const auto& sha256 : chunk_sha256) {
+    data += sha256 + "\n";
+  }
+  return data;
+}
+
+Option<ChunkManifest> ChunkManifest::parse(const QByteArray& data) {
+  const QList<QByteArray> lines = data.split('\n');
+  if (lines.size() < 3 || lines[0] != manifest_magic ||
+      !lines[1].startsWith("image ") || !lines[2].startsWith("chunk-size ")) {
+    return nullopt;
+  }
+
+  ChunkManifest manifest;
+  const QByteArray image = lines[1].mid(6);
+  const int space = image.indexOf(' ');
+  bool size_ok = false;
+  bool chunk_ok = false;
+  manifest.image_size = image.left(space).toULongLong(&size_ok);
+  manifest.image_name = QString::fromUtf8(image.mid(space + 1));
+  manifest.chunk_size = lines[2].mid(11).toULongLong(&chunk_ok);
+  // The name is used as a path next to the archive, so it must not
+  // lead anywhere else
+  if (space < 0 || !size_ok || !chunk_ok || manifest.chunk_size == 0 ||
+      manifest.image_name.isEmpty() || manifest.image_name == "." ||
+      manifest.image_name.contains("..") ||
+      QFileInfo(manifest.image_name).fileName() != manifest.image_name ||
+      manifest.image_name.contains('\\')) {
+    return nullopt;
+  }
+
+  for (int i = 3; i < lines.size(); i++) {
+    if (lines[i].isEmpty()) {
+      continue;
+    }
+    if (!isSha256Hex(lines[i])) {
+      return nullopt;
+    }
+    manifest.chunk_sha256.push_back(lines[i]);
+  }
+  const uint64_t expected_chunks =
+      (manifest.image_size + manifest.chunk_size - 1) / manifest.chunk_size;
+  if (manifest.chunkCount() != expected_chunks) {
+    return nullopt;
+  }
+  return manifest;
+}
+
+}  // namespace gondar
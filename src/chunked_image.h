@@ -0,0 +1,56 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_CHUNKED_IMAGE_H_
+#define SRC_CHUNKED_IMAGE_H_
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+#include "option.h"
+
+namespace gondar {
+
+// A chunked image archive is a zip holding an image split into
+// fixed-size chunks, "chunk-00000" being the first, each compressed on
+// its own so they can be inflated in parallel and written at their
+// offsets. Its "manifest" entry describes the image and lists each
+// chunk's SHA-256, so a chunk can be checked as soon as it is inflated.
+struct ChunkManifest {
+  // File name of the image, without any directory
+  QString image_name;
+  uint64_t image_size = 0;
+  uint64_t chunk_size = 0;
+  // Hex SHA-256 of each chunk's uncompressed data, in order
+  std::vector<QByteArray> chunk_sha256;
+
+  size_t chunkCount() const;
+  uint64_t chunkOffset(size_t index) const;
+  // Only the last chunk can be short
+  uint64_t chunkLength(size_t index) const;
+
+  QByteArray serialize() const;
+  // Returns nothing if |data| isn't a well-formed manifest
+  static Option<ChunkManifest> parse(const QByteArray& data);
+};
+
+extern const char chunk_manifest_entry[];
+QString ChunkEntryName(size_t index);
+
+}  // namespace gondar
+
+#endif  // SRC_CHUNKED_IMAGE_H_
@@ -0,0 +1,250 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Command line front end for factory and benchmarking use. Every line
+// written to stdout is a single JSON object; logging goes only to the
+// log file so it doesn't interleave with the machine-readable output.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include "dismissprompt.h"
+#endif
+#include "gondar.h"
+#include "headless_installer.h"
+#include "log.h"
+#include "metrics_queue.h"
+#include "peer_cache.h"
+#include "station_server.h"
+#include "trace.h"
+
+namespace {
+
+const int default_station_port = 8340;
+
+// How often the event loop checks whether a stop signal came in
+const int signal_poll_ms = 200;
+
+// The signal that asked us to stop, if any
+volatile std::sig_atomic_t stop_signal = 0;
+
+void requestStop(const int sig) {
+  stop_signal = sig;
+}
+
+// Quit the event loop on SIGINT or SIGTERM, so that a station that is
+// run until killed still shuts down cleanly and writes its trace. The
+// handler can only safely set a flag, which a timer picks up.
+void quitOnSignal(QCoreApplication* app) {
+  std::signal(SIGINT, requestStop);
+  std::signal(SIGTERM, requestStop);
+  auto* timer = new QTimer(app);
+  QObject::connect(timer, &QTimer::timeout, app, []() {
+    if (stop_signal != 0) {
+      LOG_INFO << "stopping on signal " << stop_signal;
+      QCoreApplication::exit(128 + stop_signal);
+    }
+  });
+  timer->start(signal_poll_ms);
+}
+
+void printJson(const QJsonObject& json) {
+  const QByteArray line = QJsonDocument(json).toJson(QJsonDocument::Compact);
+  fprintf(stdout, "%s\n", line.constData());
+  fflush(stdout);
+}
+
+void printError(const QString& message) {
+  printJson({{"event", "error"}, {"message", message}});
+}
+
+QJsonObject deviceListJson(const DeviceGuyList& devices) {
+  QJsonArray array;
+  for (const auto& device : devices) {
+    QJsonObject json;
+    json["id"] = static_cast<qint64>(device.device_num);
+    json["name"] = QString::fromStdString(device.name);
+    json["bytes"] = static_cast<qint64>(device.num_bytes);
+    json["bus"] = QString::fromStdString(device.bus);
+    json["big_enough"] = device.isBigEnough();
+    array.append(json);
+  }
+  return {{"event", "devices"}, {"devices", array}};
+}
+
+// Look up each requested device ID in |available|. Returns false and
+// prints an error if any of them is missing or too small.
+bool selectDevices(const QStringList& ids,
+                   const DeviceGuyList& available,
+                   DeviceGuyList* selected) {
+  for (const auto& id_str : ids) {
+    bool ok = false;
+    const uint32_t id = id_str.toUInt(&ok);
+    if (!ok) {
+      printError("invalid device ID: " + id_str);
+      return false;
+    }
+    const auto iter = std::find_if(
+        available.begin(), available.end(),
+        [id](const DeviceGuy& dev) { return dev.device_num == id; });
+    if (iter == available.end()) {
+      printError("device not found: " + id_str);
+      return false;
+    }
+    if (!iter->isBigEnough()) {
+      printError("device is too small: " + id_str);
+      return false;
+    }
+    selected->push_back(*iter);
+  }
+  return true;
+}
+
+// Undoes main()'s setup on every way out of it, error exits included,
+// so that queued metrics and the trace are always written
+class ShutdownGuard {
+ public:
+  ShutdownGuard() = default;
+  ~ShutdownGuard() {
+    gondar::PeerCache::instance()->stop();
+    gondar::MetricsQueue::instance()->shutdown();
+    gondar::Trace::stop();
+    CleanUp();
+  }
+
+  ShutdownGuard(const ShutdownGuard&) = delete;
+  ShutdownGuard& operator=(const ShutdownGuard&) = delete;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gondar::InitializeLogging(false);
+#if defined(Q_OS_WIN)
+  SetFormatPromptHook();
+#endif
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("thoriumos-usb-maker-cli");
+  quitOnSignal(&app);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Write a ThoriumOS image to USB devices without the wizard. Progress "
+      "is printed as one JSON object per line.");
+  parser.addHelpOption();
+  const QCommandLineOption list_option("list-devices",
+                                       "List the attached USB devices.");
+  const QCommandLineOption image_option(
+      "image", "Image URL, or path to a local .zip or .bin file.", "source");
+  const QCommandLineOption device_option(
+      "device", "Target device ID (repeat for several devices).", "id");
+  const QCommandLineOption station_option(
+      "station",
+      "Run until killed, taking imaging jobs over a localhost HTTP API.");
+  const QCommandLineOption port_option(
+      "port",
+      QString("Port for --station (default %1).").arg(default_station_port),
+      "port", QString::number(default_station_port));
+  parser.addOption(list_option);
+  parser.addOption(image_option);
+  parser.addOption(device_option);
+  parser.addOption(station_option);
+  const QCommandLineOption trace_option(
+      "trace",
+      "Record a Chrome trace-event file of the run, for chrome://tracing "
+      "or Perfetto.",
+      "file");
+  const QCommandLineOption peer_cache_option(
+      "peer-cache",
+      "Share downloaded images with other stations on the LAN, and fetch "
+      "images from them when they have one.");
+  parser.addOption(port_option);
+  parser.addOption(trace_option);
+  parser.addOption(peer_cache_option);
+  // Exits on --help or a bad option, so nothing is set up before it
+  parser.process(app);
+
+  // Declared before the server and installer, so they are gone by the
+  // time it runs
+  const ShutdownGuard shutdown_guard;
+  gondar::MetricsQueue::instance()->start();
+  if (parser.isSet(trace_option)) {
+    gondar::Trace::start(parser.value(trace_option));
+  } else {
+    gondar::Trace::startFromEnvironment();
+  }
+
+  if (!IsCurrentProcessElevated()) {
+    printError("administrator privileges are required");
+    return 1;
+  }
+
+  if (parser.isSet(peer_cache_option) &&
+      !gondar::PeerCache::instance()->start()) {
+    printError("could not start the peer cache");
+    return 1;
+  }
+
+  if (parser.isSet(station_option)) {
+    gondar::StationServer server;
+    const int port = parser.value(port_option).toInt();
+    if (!server.start(port)) {
+      printError("could not start the station server");
+      return 1;
+    }
+    printJson({{"event", "station-started"}, {"port", port}});
+    const auto ret = app.exec();
+    server.stop();
+    return ret;
+  }
+
+  const DeviceGuyList available = GetDeviceList();
+  if (parser.isSet(list_option)) {
+    printJson(deviceListJson(available));
+    return 0;
+  }
+
+  if (!parser.isSet(image_option) || !parser.isSet(device_option)) {
+    printError("--image and at least one --device are required");
+    return 1;
+  }
+
+  DeviceGuyList targets;
+  if (!selectDevices(parser.values(device_option), available, &targets)) {
+    return 1;
+  }
+
+  gondar::HeadlessInstaller installer;
+  QObject::connect(&installer, &gondar::HeadlessInstaller::event, &printJson);
+  QObject::connect(&installer, &gondar::HeadlessInstaller::finished, &app,
+                   [](bool success) {
+                     QCoreApplication::exit(success ? 0 : 1);
+                   });
+  const QString source = parser.value(image_option);
+  QTimer::singleShot(0, &installer,
+                     [&]() { installer.start(source, targets); });
+
+  const auto ret = app.exec();
+  LOG_INFO << "app.exec() returned " << ret;
+  return ret;
+}
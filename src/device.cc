@@ -23,6 +23,7 @@
 
 #include "log.h"
 #include "shared.h"
+#include "util.h"
 
 DeviceGuy::DeviceGuy(uint32_t device_num_in,
                      const std::string name_in,
@@ -37,3 +38,7 @@ std::string DeviceGuy::toString() const {
   return ("Device(id=" + std::to_string(device_num) + ", name=\"" + name +
           "\")");
 }
+
+bool DeviceGuy::isBigEnough() const {
+  return num_bytes >= 6 * gondar::getGigabyte();
+}
@@ -32,9 +32,22 @@ class DeviceGuy {
 
   std::string toString() const;
 
+  // Whether the device is big enough to hold a ThoriumOS installer
+  bool isBigEnough() const;
+
   uint32_t device_num = 0;
   std::string name;
   uint64_t num_bytes = 0;
+  // Identifies the root hub, and so the host controller, the device is
+  // under, or the hub it is plugged into if that can't be found.
+  // Devices with the same bus share upstream bandwidth. Empty if
+  // unknown.
+  std::string bus;
+  // The OS's path for this particular device, which includes its serial
+  // number where it has one. Unlike |device_num| it changes when one
+  // stick is swapped for another. Empty if unknown; not compared by
+  // operator==.
+  std::string instance_path;
 };
 
 typedef std::vector<DeviceGuy> DeviceGuyList;
@@ -16,15 +16,30 @@
 #include "device_picker.h"
 
 #include <QRadioButton>
+#include <map>
+#include <utility>
+#include <vector>
 
 #include "util.h"
 
 namespace gondar {
 
+namespace {
+
+// Buttons are matched to devices by the same identity that
+// DeviceGuy::operator== uses
+using DeviceKey = std::pair<uint32_t, std::string>;
+
+DeviceKey deviceKey(const DeviceGuy& device) {
+  return DeviceKey(device.device_num, device.name);
+}
+
+}  // namespace
+
 DevicePicker::Button::Button(const DeviceGuy& device, QWidget* parent)
     : QRadioButton(QString::fromStdString(device.name), parent),
       device_(device) {
-  if (device.num_bytes < 6 * gondar::getGigabyte()) {
+  if (!device.isBigEnough()) {
     setEnabled(false);
     setText(QString::fromStdString(device.name) + " (too small)");
   }
@@ -54,19 +69,57 @@ Option<DeviceGuy> DevicePicker::selectedDevice() const {
 }
 
 void DevicePicker::refresh(const DeviceGuyList& devices) {
-  while (auto* item = layout_.takeAt(0)) {
-    auto* button = dynamic_cast<Button*>(item->widget());
-    button_group_.removeButton(button);
-    delete item;
+  bool changed = false;
+
+  std::map<DeviceKey, Button*> existing;
+  for (int i = 0; i < layout_.count(); i++) {
+    auto* button = buttonAt(i);
+    existing[deviceKey(button->device())] = button;
   }
 
+  // Reuse the button for each device that is still present, creating
+  // buttons only for new devices. A device whose size changed gets a
+  // new button since the size decides whether the button is enabled.
+  std::vector<Button*> buttons;
+  buttons.reserve(devices.size());
   for (const auto& device : devices) {
-    auto* button = new Button(device, this);
-    button_group_.addButton(button);
-    layout_.addWidget(button);
+    const auto iter = existing.find(deviceKey(device));
+    if (iter != existing.end() &&
+        iter->second->device().num_bytes == device.num_bytes) {
+      buttons.push_back(iter->second);
+      existing.erase(iter);
+    } else {
+      auto* button = new Button(device, this);
+      button_group_.addButton(button);
+      buttons.push_back(button);
+      changed = true;
+    }
   }
 
-  emit selectionChanged();
+  // Anything left over is no longer attached
+  for (const auto& pair : existing) {
+    auto* button = pair.second;
+    button_group_.removeButton(button);
+    layout_.removeWidget(button);
+    delete button;
+    changed = true;
+  }
+
+  // Put the buttons in the same order as |devices|. In the common case
+  // only the new buttons need to be inserted.
+  for (size_t index = 0; index < buttons.size(); index++) {
+    auto* button = buttons[index];
+    const int layout_index = static_cast<int>(index);
+    if (layout_index < layout_.count() && buttonAt(layout_index) == button) {
+      continue;
+    }
+    layout_.removeWidget(button);
+    layout_.insertWidget(layout_index, button);
+  }
+
+  if (changed) {
+    emit selectionChanged();
+  }
 }
 
 const DevicePicker::Button* DevicePicker::selectedButton() const {
@@ -78,4 +131,8 @@ void DevicePicker::onButtonClicked(QAbstractButton*) {
   emit selectionChanged();
 }
 
+DevicePicker::Button* DevicePicker::buttonAt(const int index) const {
+  return dynamic_cast<Button*>(layout_.itemAt(index)->widget());
+}
+
 }  // namespace gondar
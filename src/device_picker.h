@@ -35,6 +35,10 @@ class DevicePicker : public QWidget {
 
   Option<DeviceGuy> selectedDevice() const;
 
+  // Update the list of buttons to match |devices|. Only buttons for
+  // devices that were added or removed are touched, so the current
+  // selection survives a refresh as long as its device is still
+  // present.
   void refresh(const DeviceGuyList& devices);
 
  signals:
@@ -47,6 +51,8 @@ class DevicePicker : public QWidget {
 
   void onButtonClicked(QAbstractButton* button);
 
+  Button* buttonAt(int index) const;
+
   QButtonGroup button_group_;
   QVBoxLayout layout_;
 };
@@ -59,7 +59,7 @@ int DeviceSelectPage::nextId() const {
   if (wizard()->isFormatOnly()) {
     return GondarWizard::Page_writeOperation;
   }
-  if (wizard()->downloadProgressPage.isComplete()) {
+  if (wizard()->imageFetcher.state() == gondar::ImageFetcher::State::Done) {
     return GondarWizard::Page_writeOperation;
   } else {
     return GondarWizard::Page_downloadProgress;
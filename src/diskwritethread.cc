@@ -17,6 +17,7 @@
 
 #include <QFile>
 
+#include "block_map.h"
 #include "device.h"
 #include "gondar.h"
 #include "log.h"
@@ -40,11 +41,19 @@ DiskWriteThread::DiskWriteThread(DeviceGuy* drive_in,
   image_path = image_path_in;
 }
 
-DiskWriteThread::~DiskWriteThread() {}
+DiskWriteThread::~DiskWriteThread() {
+  // Destroying a running QThread aborts the program, so stop the write
+  // rather than leave it blocked in Install()
+  cancel();
+  wait();
+}
 
 DiskWriteThread::State DiskWriteThread::state() const {
-  QMutexLocker locker(&state_mutex_);
-  return state_;
+  return state_.load(std::memory_order_acquire);
+}
+
+void DiskWriteThread::cancel() {
+  cancel_ = true;
 }
 
 void DiskWriteThread::writeImage() {
@@ -58,7 +67,15 @@ void DiskWriteThread::writeImage() {
     return;
   }
 
-  if (!Install(&selected_drive, image_path.toStdString().c_str(), image_size)) {
+  const auto block_map =
+      gondar::BlockMap::findFor(image_path, static_cast<uint64_t>(image_size));
+  if (!Install(&selected_drive, image_path.toStdString().c_str(), image_size,
+               &cancel_, &telemetry_, block_map ? &*block_map : nullptr)) {
+    if (cancel_) {
+      LOG_WARNING << "Install cancelled";
+      setState(State::Cancelled);
+      return;
+    }
     LOG_ERROR << "Install failed";
     setState(State::InstallFailed);
     return;
@@ -82,6 +99,11 @@ void DiskWriteThread::formatDrive() {
   setState(State::Success);
 }
 void DiskWriteThread::run() {
+  if (cancel_) {
+    LOG_WARNING << "cancelled before starting";
+    setState(State::Cancelled);
+    return;
+  }
   if (image_path.isEmpty()) {
     formatDrive();
   } else {
@@ -90,6 +112,5 @@ void DiskWriteThread::run() {
 }
 
 void DiskWriteThread::setState(const State state) {
-  QMutexLocker locker(&state_mutex_);
-  state_ = state;
+  state_.store(state, std::memory_order_release);
 }
@@ -16,11 +16,12 @@
 #ifndef SRC_DISKWRITETHREAD_H_
 #define SRC_DISKWRITETHREAD_H_
 
-#include <QMutex>
 #include <QString>
 #include <QThread>
+#include <atomic>
 
 #include "device.h"
+#include "write_telemetry.h"
 
 class DiskWriteThread : public QThread {
   Q_OBJECT
@@ -39,10 +40,19 @@ class DiskWriteThread : public QThread {
     Running,
     GetFileSizeFailed,
     InstallFailed,
+    Cancelled,
     Success,
   };
 
+  // Lock-free, so it can be polled as often as needed without
+  // slowing the write down
   State state() const;
+  const gondar::WriteTelemetry& telemetry() const { return telemetry_; }
+
+  // Ask a running write to stop. The thread finishes with the Cancelled
+  // state within one buffer's write time. Safe to call from any
+  // thread, and before or after the write.
+  void cancel();
 
  protected:
   void run() override;
@@ -52,8 +62,9 @@ class DiskWriteThread : public QThread {
   void writeImage();
   void formatDrive();
 
-  mutable QMutex state_mutex_;
-  State state_ = State::Initial;
+  std::atomic<State> state_{State::Initial};
+  gondar::WriteTelemetry telemetry_;
+  std::atomic<bool> cancel_{false};
   DeviceGuy selected_drive;
   QString image_path;
 };
@@ -1,4 +1,4 @@
-// Copyright 2017 Neverware
+// Copyright 2026 Alex313031
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -15,62 +15,87 @@
 
 #include "download_progress_page.h"
 
+#include <QTimer>
+
 #include "gondarwizard.h"
 
+using gondar::ImageFetcher;
+
 DownloadProgressPage::DownloadProgressPage(QWidget* parent)
     : WizardPage(parent) {
   setTitle("ThoriumOS Download");
   setSubTitle("The installer image is currently downloading.");
-  download_finished = false;
   layout.addWidget(&progress);
   setLayout(&layout);
-  range_set = false;
 }
 
 void DownloadProgressPage::initializePage() {
   setLayout(&layout);
-  const QUrl url = wizard()->imageSelectPage.getUrl();
-  qDebug() << "using url= " << url;
-  connect(&manager, &DownloadManager::finished, this,
-          &DownloadProgressPage::markComplete);
-  manager.append(url.toString());
-  connect(&manager, &DownloadManager::started, this,
-          &DownloadProgressPage::onDownloadStarted);
-  // allow the download manager to access session state in the wizard
-  manager.setWizard(wizard());
-}
+  ImageFetcher& fetcher = wizard()->imageFetcher;
+  const QList<QUrl> mirrors = wizard()->imageSelectPage.getMirrors();
+  qDebug() << "using urls= " << mirrors;
+  connect(&fetcher, &ImageFetcher::downloadProgress, this,
+          &DownloadProgressPage::downloadProgress, Qt::UniqueConnection);
+  connect(&fetcher, &ImageFetcher::verifying, this,
+          &DownloadProgressPage::notifyVerify, Qt::UniqueConnection);
+  connect(&fetcher, &ImageFetcher::extracting, this,
+          &DownloadProgressPage::notifyUnzip, Qt::UniqueConnection);
+  connect(&fetcher, &ImageFetcher::done, this,
+          &DownloadProgressPage::onFetchDone, Qt::UniqueConnection);
+  connect(&fetcher, &ImageFetcher::failed, this,
+          &DownloadProgressPage::onFetchFailed, Qt::UniqueConnection);
+  // normally already running; this retries a fetch that failed before
+  // the user got here
+  fetcher.start(mirrors);
 
-void DownloadProgressPage::onDownloadStarted() {
-  QNetworkReply* cur_download = manager.getCurrentDownload();
-  connect(cur_download, &QNetworkReply::downloadProgress, this,
-          &DownloadProgressPage::downloadProgress);
+  switch (fetcher.state()) {
+    case ImageFetcher::State::Verifying:
+      notifyVerify();
+      break;
+    case ImageFetcher::State::Extracting:
+      notifyUnzip();
+      break;
+    case ImageFetcher::State::Done:
+      // wizard()->next() can't be called from within initializePage
+      QTimer::singleShot(0, this, &DownloadProgressPage::onFetchDone);
+      break;
+    default:
+      progress.setRange(0, 0);
+      progress.setValue(0);
+      if (fetcher.bytesTotal() > 0) {
+        downloadProgress(fetcher.bytesReceived(), fetcher.bytesTotal());
+      }
+      break;
+  }
 }
 
 void DownloadProgressPage::downloadProgress(qint64 sofar, qint64 total) {
-  if (!range_set) {
-    range_set = true;
+  if (progress.maximum() != total) {
     progress.setRange(0, total);
   }
   progress.setValue(sofar);
 }
 
-void DownloadProgressPage::markComplete() {
-  download_finished = true;
-  // now that the download is finished, let's unzip the build.
-  if (manager.hasError()) {
-    wizard()->postError(
-        "An error has occurred downloading the latest image.  Please ensure "
-        "you have a network connection.");
+void DownloadProgressPage::onFetchFailed() {
+  // a fetch that fails in the background is retried once the user gets
+  // here, so only report failures seen while this page is showing
+  if (wizard()->currentPage() != this) {
     return;
   }
-  notifyUnzip();
-  unzipThread = new UnzipThread(manager.outputFileInfo(), this);
-  connect(unzipThread, &UnzipThread::finished, this,
-          &DownloadProgressPage::onUnzipFinished);
-  unzipThread->start();
+  const QString& error = wizard()->imageFetcher.errorString();
+  if (!error.isEmpty()) {
+    wizard()->postError(error);
+    return;
+  }
+  wizard()->postError(
+      "An error has occurred downloading the latest image.  Please ensure "
+      "you have a network connection.");
 }
 
-void DownloadProgressPage::onUnzipFinished() {
+void DownloadProgressPage::onFetchDone() {
+  if (wizard()->currentPage() != this) {
+    return;
+  }
   // unzip has now completed
   qDebug() << "main thread has accepted complete";
   progress.setRange(0, 100);
@@ -80,6 +105,13 @@ void DownloadProgressPage::onUnzipFinished() {
   // immediately progress to writeOperationPage
   wizard()->next();
 }
+
+void DownloadProgressPage::notifyVerify() {
+  setSubTitle("Verifying image file...");
+  progress.setRange(0, 0);
+  progress.setValue(0);
+}
+
 void DownloadProgressPage::notifyUnzip() {
   setSubTitle("Extracting compressed image...");
   // setting range and value to zero results in an 'infinite' progress bar
@@ -88,9 +120,9 @@ void DownloadProgressPage::notifyUnzip() {
 }
 
 bool DownloadProgressPage::isComplete() const {
-  return download_finished;
+  return wizard()->imageFetcher.state() == ImageFetcher::State::Done;
 }
 
 const QString& DownloadProgressPage::getImageFileName() {
-  return unzipThread->getFileName();
+  return wizard()->imageFetcher.imageFileName();
 }
@@ -1,4 +1,4 @@
-// Copyright 2017 Neverware
+// Copyright 2026 Alex313031
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,10 +19,11 @@
 #include <QProgressBar>
 #include <QVBoxLayout>
 
-#include "downloader.h"
-#include "unzipthread.h"
 #include "wizard_page.h"
 
+// Shows the progress of the wizard's gondar::ImageFetcher. The fetch
+// usually starts before this page is reached, in which case the page
+// picks up wherever it has got to, or moves straight on if it is done.
 class DownloadProgressPage : public gondar::WizardPage {
   Q_OBJECT
 
@@ -33,21 +34,17 @@ class DownloadProgressPage : public gondar::WizardPage {
 
  protected:
   void initializePage() override;
+  void notifyVerify();
   void notifyUnzip();
 
  public slots:
-  void markComplete();
   void downloadProgress(qint64 sofar, qint64 total);
-  void onDownloadStarted();
-  void onUnzipFinished();
+  void onFetchDone();
+  void onFetchFailed();
 
  private:
-  bool range_set;
-  DownloadManager manager;
   QProgressBar progress;
-  bool download_finished;
   QVBoxLayout layout;
-  UnzipThread* unzipThread;
 };
 
 #endif  // SRC_DOWNLOAD_PROGRESS_PAGE_H_
@@ -23,13 +23,75 @@
 #include <QString>
 #include <QStringList>
 #include <QTimer>
+#include <algorithm>
 
 #include "gondarwizard.h"
+#include "http_client.h"
 #include "log.h"
 #include "metric.h"
+#include "task_pool.h"
+#include "trace.h"
+
+namespace {
+
+// Below this a mirror is slower than most home connections
+const qint64 default_min_bytes_per_sec = 256 * 1024;
+const int default_throughput_window_ms = 10000;
+
+bool isSha256Hex(const QByteArray& hex) {
+  if (hex.size() != 64) {
+    return false;
+  }
+  return std::all_of(hex.begin(), hex.end(), [](const char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+  });
+}
+
+// The complete length in a "bytes <first>-<last>/<length>" Content-Range
+// header, or -1 if it is missing or unknown
+qint64 contentRangeLength(const QByteArray& content_range) {
+  const int slash = content_range.lastIndexOf('/');
+  if (slash < 0) {
+    return -1;
+  }
+  bool ok = false;
+  const qint64 length = content_range.mid(slash + 1).trimmed().toLongLong(&ok);
+  return ok ? length : -1;
+}
+
+}  // namespace
 
 DownloadManager::DownloadManager(QObject* parent)
-    : QObject(parent), error(false), downloadedCount(0), totalCount(0) {}
+    : QObject(parent),
+      currentDownload(nullptr),
+      transferOffset(0),
+      acceptedBytes(0),
+      checkedStatus(false),
+      statusOk(false),
+      restarting(false),
+      switchingMirror(false),
+      fileLength(-1),
+      windowBytes(0),
+      minBytesPerSec(default_min_bytes_per_sec),
+      wizard(nullptr),
+      error(false),
+      cancelled(false),
+      downloadedCount(0),
+      totalCount(0) {
+  throughputTimer.setInterval(default_throughput_window_ms);
+  connect(&throughputTimer, &QTimer::timeout, this,
+          &DownloadManager::checkThroughput);
+  // queued, since it is emitted from the pool
+  connect(this, &DownloadManager::outputVerified, this,
+          &DownloadManager::onOutputVerified, Qt::QueuedConnection);
+}
+
+DownloadManager::~DownloadManager() {
+  if (verification.valid()) {
+    stopVerifying = true;
+    verification.wait();
+  }
+}
 
 void DownloadManager::append(const QStringList& urlList) {
   for (const auto& url : urlList)
@@ -40,13 +102,27 @@ void DownloadManager::append(const QStringList& urlList) {
 }
 
 void DownloadManager::append(const QUrl& url) {
+  appendMirrors({url});
+}
+
+void DownloadManager::appendMirrors(const QList<QUrl>& mirrors_in) {
   if (downloadQueue.isEmpty())
     QTimer::singleShot(0, this, &DownloadManager::startNextDownload);
 
-  downloadQueue.enqueue(url);
+  downloadQueue.enqueue(mirrors_in);
   ++totalCount;
 }
 
+void DownloadManager::setMinThroughput(const qint64 bytes_per_sec,
+                                       const int window_ms) {
+  minBytesPerSec = bytes_per_sec;
+  throughputTimer.setInterval(window_ms);
+}
+
+void DownloadManager::setOutputDir(const QString& dir) {
+  outputDir = dir;
+}
+
 QString DownloadManager::saveFileName(const QUrl& url) {
   return url.fileName();
 }
@@ -59,10 +135,17 @@ void DownloadManager::startNextDownload() {
     return;
   }
 
-  QUrl url = downloadQueue.dequeue();
+  mirrors = downloadQueue.dequeue();
+  originMirrors.clear();
+  expectedSha256.clear();
+  fileEtag.clear();
+  fileLength = -1;
+  const QUrl url = mirrors.first();
 
   const QDir dir =
-      QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+      outputDir.isEmpty()
+          ? QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)
+          : outputDir;
   if (!dir.exists()) {
     // equivalent of mkdir -p
     bool success = dir.mkpath(".");
@@ -75,6 +158,8 @@ void DownloadManager::startNextDownload() {
 
   output.setFileName(dir.filePath(filename));
   qInfo() << "Download destination:" << output.fileName();
+  // don't serve a file to the LAN while overwriting it
+  gondar::PeerCache::instance()->unshare(output.fileName());
 
   if (!output.open(QIODevice::WriteOnly)) {
     LOG_ERROR << "failed to open " << filename << ": " << output.errorString();
@@ -83,40 +168,357 @@ void DownloadManager::startNextDownload() {
     return;  // skip this download
   }
 
-  QNetworkRequest request(url);
   gondar::SendMetric(wizard, gondar::Metric::DownloadAttempt);
-  currentDownload = manager.get(request);
-  connect(currentDownload, &QNetworkReply::finished, this,
-          &DownloadManager::downloadFinished);
-  connect(currentDownload, &QNetworkReply::readyRead, this,
-          &DownloadManager::downloadReadyRead);
   emit started();
 
   // prepare the output
   LOG_INFO << "downloading " << url;
   downloadTime.start();
+
+  if (gondar::PeerCache::instance()->isRunning()) {
+    // another station may already have it
+    peerLookup = std::make_unique<gondar::PeerLookup>();
+    connect(peerLookup.get(), &gondar::PeerLookup::finished, this,
+            &DownloadManager::peerLookupFinished);
+    peerLookup->start(filename);
+    return;
+  }
+  startRace();
+}
+
+void DownloadManager::peerLookupFinished() {
+  foundPeers = peerLookup->peers();
+  // the lookup is still emitting finished()
+  peerLookup.release()->deleteLater();
+
+  if (foundPeers.isEmpty()) {
+    startRace();
+    return;
+  }
+  // any LAN host can answer the lookup, so the hash the download is
+  // checked against has to come from the origin
+  hashSources.clear();
+  for (const auto& url : mirrors) {
+    if (url.scheme() == "https") {
+      hashSources << url;
+    }
+  }
+  fetchOriginHash();
+}
+
+void DownloadManager::fetchOriginHash() {
+  if (hashSources.isEmpty()) {
+    LOG_WARNING << "no hash from the origin for " << output.fileName()
+                << ", not using LAN peers";
+    foundPeers.clear();
+    startRace();
+    return;
+  }
+  QUrl url = hashSources.takeFirst();
+  url.setPath(url.path() + ".sha256");
+  originHashReply =
+      gondar::GetNetworkManager()->get(gondar::CreateRequest(url));
+  connect(originHashReply, &QNetworkReply::finished, this,
+          &DownloadManager::originHashFinished);
+}
+
+void DownloadManager::originHashFinished() {
+  QNetworkReply* reply = originHashReply;
+  originHashReply = nullptr;
+  reply->deleteLater();
+
+  if (cancelled) {
+    foundPeers.clear();
+    output.close();
+    output.remove();
+    startNextDownload();
+    return;
+  }
+  // sha256sum format, "<hash>  <name>"
+  const QByteArray hash = reply->error() == QNetworkReply::NoError
+                              ? reply->readAll().trimmed().left(64).toLower()
+                              : QByteArray();
+  if (!isSha256Hex(hash)) {
+    LOG_WARNING << "no usable hash at " << reply->url();
+    fetchOriginHash();
+    return;
+  }
+
+  QList<QUrl> trusted;
+  for (const auto& peer : foundPeers) {
+    if (peer.sha256 == hash) {
+      trusted << peer.url;
+    } else {
+      LOG_WARNING << "ignoring " << peer.url
+                  << ", its hash differs from the origin's";
+    }
+  }
+  foundPeers.clear();
+  if (!trusted.isEmpty()) {
+    originMirrors = mirrors;
+    expectedSha256 = hash;
+    // ahead of the WAN mirrors, so they win ties in the race
+    mirrors = trusted + mirrors;
+  }
+  startRace();
+}
+
+void DownloadManager::startRace() {
+  if (mirrors.size() > 1) {
+    race = std::make_unique<gondar::MirrorRace>();
+    connect(race.get(), &gondar::MirrorRace::finished, this,
+            &DownloadManager::mirrorRaceFinished);
+    race->start(mirrors);
+    return;
+  }
+  startTransfer(0);
+}
+
+void DownloadManager::mirrorRaceFinished() {
+  QList<QUrl> ranked;
+  for (const auto& result : race->ranking()) {
+    ranked << result.url;
+  }
+  // the race is still emitting finished()
+  race.release()->deleteLater();
+
+  // if every probe failed, try the mirrors in the order given anyway
+  if (!ranked.isEmpty()) {
+    mirrors = ranked;
+  }
+  LOG_INFO << "using mirror " << mirrors.first();
+  startTransfer(0);
+}
+
+void DownloadManager::startTransfer(const qint64 offset) {
+  QNetworkRequest request = gondar::CreateRequest(mirrors.first());
+  if (offset > 0) {
+    request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-");
+    // Another version of the file comes back whole instead
+    if (!fileEtag.isEmpty()) {
+      request.setRawHeader("If-Range", fileEtag);
+    }
+  }
+  // drop anything past |offset|, such as what a failed mirror sent
+  output.resize(offset);
+  output.seek(offset);
+  transferOffset = offset;
+  acceptedBytes = 0;
+  checkedStatus = false;
+  statusOk = false;
+  restarting = false;
+  currentDownload = gondar::GetNetworkManager()->get(request);
+  connect(currentDownload, &QNetworkReply::finished, this,
+          &DownloadManager::downloadFinished);
+  connect(currentDownload, &QNetworkReply::readyRead, this,
+          &DownloadManager::downloadReadyRead);
+  connect(currentDownload, &QNetworkReply::downloadProgress, this,
+          [this](const qint64 received, const qint64 total) {
+            emit downloadProgress(transferOffset + received,
+                                  total < 0 ? -1 : transferOffset + total);
+          });
+
+  windowBytes = 0;
+  if (minBytesPerSec > 0 && mirrors.size() > 1) {
+    throughputTimer.start();
+  }
+}
+
+void DownloadManager::checkThroughput() {
+  const qint64 bytes_per_sec = windowBytes * 1000 / throughputTimer.interval();
+  windowBytes = 0;
+  if (bytes_per_sec >= minBytesPerSec || mirrors.size() < 2) {
+    return;
+  }
+  LOG_WARNING << "mirror " << mirrors.first() << " slowed to "
+              << bytes_per_sec << " B/s, switching";
+  switchingMirror = true;
+  // downloadFinished() runs from inside abort()
+  currentDownload->abort();
 }
 
 void DownloadManager::downloadFinished() {
+  throughputTimer.stop();
+  // an empty body never triggers readyRead
+  checkStatus();
+  QNetworkReply* reply = currentDownload;
+  currentDownload = nullptr;
+  reply->deleteLater();
+
+  if (restarting && !cancelled) {
+    LOG_INFO << "downloading " << mirrors.first() << " from the start";
+    startTransfer(0);
+    return;
+  }
+
+  const bool failed = reply->error() != QNetworkReply::NoError || !statusOk;
+  if (!cancelled && mirrors.size() > 1 && (switchingMirror || failed)) {
+    if (!switchingMirror) {
+      LOG_WARNING << "mirror " << mirrors.first()
+                  << " failed: " << reply->errorString();
+    }
+    switchingMirror = false;
+    mirrors.removeFirst();
+    const qint64 resume_at = transferOffset + acceptedBytes;
+    LOG_INFO << "resuming from " << mirrors.first() << " at byte "
+             << resume_at;
+    startTransfer(resume_at);
+    return;
+  }
+
   output.close();
 
-  if (currentDownload->error()) {
+  if (cancelled) {
+    LOG_INFO << "download cancelled";
+    output.remove();
+  } else if (failed) {
     // download failed
-    LOG_ERROR << "download failed: " << currentDownload->errorString();
+    LOG_ERROR << "download failed: " << reply->errorString() << ", HTTP "
+              << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                     .toInt();
     error = true;
     gondar::SendMetric(wizard, gondar::Metric::DownloadFailure);
+  } else if (!expectedSha256.isEmpty()) {
+    // part or all of it came from a peer
+    const QString path = output.fileName();
+    const QByteArray expected = expectedSha256;
+    if (wizard) {
+      wizard->timings.start(gondar::RunTimings::Span::Verify);
+    }
+    verification =
+        gondar::TaskPool::instance()->submit([this, path, expected]() {
+          emit outputVerified(gondar::Sha256File(path, &stopVerifying) ==
+                              expected);
+        });
+    return;
   } else {
-    LOG_INFO << "download succeeded";
-    ++downloadedCount;
-    gondar::SendMetric(wizard, gondar::Metric::DownloadSuccess);
+    downloadSucceeded(QByteArray());
+    return;
+  }
+
+  startNextDownload();
+}
+
+void DownloadManager::onOutputVerified(const bool matches) {
+  if (wizard) {
+    wizard->timings.finish(gondar::RunTimings::Span::Verify,
+                           QFileInfo(output.fileName()).size());
+  }
+  if (cancelled) {
+    output.remove();
+    startNextDownload();
+    return;
+  }
+  if (matches) {
+    downloadSucceeded(expectedSha256);
+    return;
   }
 
-  currentDownload->deleteLater();
+  LOG_ERROR << "downloaded file does not match the origin's hash, "
+               "downloading it again without peers";
+  mirrors = originMirrors;
+  originMirrors.clear();
+  expectedSha256.clear();
+  if (!output.open(QIODevice::WriteOnly)) {
+    LOG_ERROR << "failed to reopen " << output.fileName() << ": "
+              << output.errorString();
+    error = true;
+    gondar::SendMetric(wizard, gondar::Metric::DownloadFailure);
+    startNextDownload();
+    return;
+  }
+  startRace();
+}
+
+void DownloadManager::downloadSucceeded(const QByteArray& sha256) {
+  LOG_INFO << "download succeeded";
+  ++downloadedCount;
+  gondar::SendMetric(wizard, gondar::Metric::DownloadSuccess);
+  // let other stations on the LAN have it
+  gondar::PeerCache::instance()->share(output.fileName(), sha256);
   startNextDownload();
 }
 
+void DownloadManager::cancel() {
+  cancelled = true;
+  error = true;
+  stopVerifying = true;
+  downloadQueue.clear();
+  if (currentDownload) {
+    // downloadFinished() runs from inside abort()
+    currentDownload->abort();
+  } else if (originHashReply) {
+    // as does originHashFinished()
+    originHashReply->abort();
+  } else if (race || peerLookup) {
+    race.reset();
+    peerLookup.reset();
+    output.close();
+    output.remove();
+    QTimer::singleShot(0, this, &DownloadManager::startNextDownload);
+  }
+}
+
 void DownloadManager::downloadReadyRead() {
-  output.write(currentDownload->readAll());
+  gondar::TraceScope trace("download", "chunk");
+  checkStatus();
+  if (restarting) {
+    // downloadFinished() runs from inside abort()
+    currentDownload->abort();
+    return;
+  }
+  const QByteArray data = currentDownload->readAll();
+  windowBytes += data.size();
+  if (!statusOk) {
+    // an error page, not part of the file
+    return;
+  }
+  output.write(data);
+  acceptedBytes += data.size();
+  gondar::Trace::counter("downloaded_bytes", output.size());
+}
+
+void DownloadManager::checkStatus() {
+  if (!checkedStatus) {
+    checkedStatus = true;
+    const int status =
+        currentDownload->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+            .toInt();
+    if (transferOffset > 0 && status == 200) {
+      // it ignored the range, or has a different version of the file
+      LOG_WARNING << "mirror " << mirrors.first()
+                  << " sent the whole file, starting over";
+      output.resize(0);
+      output.seek(0);
+      transferOffset = 0;
+    }
+    statusOk = status == (transferOffset > 0 ? 206 : 200);
+    if (!statusOk) {
+      LOG_WARNING << "mirror " << mirrors.first() << " answered HTTP "
+                  << status << ", discarding the body";
+      return;
+    }
+
+    if (transferOffset == 0) {
+      // Weak ETags can't be used in If-Range
+      const QByteArray etag = currentDownload->rawHeader("ETag");
+      fileEtag = etag.startsWith("W/") ? QByteArray() : etag;
+      const QVariant length =
+          currentDownload->header(QNetworkRequest::ContentLengthHeader);
+      fileLength = length.isValid() ? length.toLongLong() : -1;
+      return;
+    }
+    // A mirror without ETags can still show that its file differs
+    const qint64 length =
+        contentRangeLength(currentDownload->rawHeader("Content-Range"));
+    if (fileLength >= 0 && length >= 0 && length != fileLength) {
+      LOG_WARNING << "mirror " << mirrors.first() << " has " << length
+                  << " bytes rather than " << fileLength
+                  << ", starting over";
+      statusOk = false;
+      restarting = true;
+    }
+  }
 }
 
 QNetworkReply* DownloadManager::getCurrentDownload() {
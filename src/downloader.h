@@ -54,11 +54,20 @@
 
 #include <QFile>
 #include <QFileInfo>
-#include <QNetworkAccessManager>
+#include <QNetworkReply>
 #include <QObject>
+#include <QList>
 #include <QQueue>
 #include <QTime>
+#include <QTimer>
 #include <QUrl>
+#include <atomic>
+#include <future>
+#include <memory>
+
+#include "mirror_race.h"
+#include "peer_cache.h"
+#include "sidecar_check.h"
 
 class GondarWizard;
 
@@ -67,35 +76,111 @@ class DownloadManager : public QObject {
 
  public:
   explicit DownloadManager(QObject* parent = 0);
+  // Waits for any hash check of the output to stop
+  ~DownloadManager();
 
   void append(const QUrl& url);
   void append(const QStringList& urlList);
+  // Download one file from whichever of |mirrors| turns out fastest,
+  // switching to the next best at the current offset if it slows down
+  // or fails partway. The mirrors must serve identical content; the
+  // file is named after the first.
+  void appendMirrors(const QList<QUrl>& mirrors);
+  // Give up on a mirror whose throughput over |window_ms| drops below
+  // |bytes_per_sec|, as long as there is another to switch to
+  void setMinThroughput(qint64 bytes_per_sec, int window_ms);
+  // Save files in |dir| instead of the user's download directory
+  void setOutputDir(const QString& dir);
   QString saveFileName(const QUrl& url);
   QNetworkReply* getCurrentDownload();
 
   QFileInfo outputFileInfo() const;
   bool hasError();
+  // Drop the queue and abort the current download, removing its
+  // partial output. finished() is still emitted.
+  void cancel();
   // allow downloader to access wizard state
   void setWizard(GondarWizard* wizard_in);
 
  signals:
   void started();
+  // Progress of the current file as a whole, across mirror switches
+  void downloadProgress(qint64 received, qint64 total);
   void finished();
+  // Emitted from a TaskPool thread once the output has been hashed
+  void outputVerified(bool matches);
 
  private slots:
   void startNextDownload();
   void downloadFinished();
   void downloadReadyRead();
+  void peerLookupFinished();
+  void originHashFinished();
+  void mirrorRaceFinished();
+  void checkThroughput();
+  void onOutputVerified(bool matches);
 
  private:
-  QNetworkAccessManager manager;
-  QQueue<QUrl> downloadQueue;
+  // Pick among |mirrors| if there is a choice, then start downloading
+  void startRace();
+  // Fetch the file's hash from the next HTTPS mirror in |hashSources|,
+  // or give up on the peers if there are none left
+  void fetchOriginHash();
+  // Request the current file from the first of |mirrors|, starting at
+  // |offset|
+  void startTransfer(qint64 offset);
+  // Once per transfer, decide from the HTTP status whether its body
+  // belongs in the file
+  void checkStatus();
+  void downloadSucceeded(const QByteArray& sha256);
+
+  QQueue<QList<QUrl>> downloadQueue;
+  // Mirrors of the current file that are still worth trying, the one
+  // in use first
+  QList<QUrl> mirrors;
+  std::unique_ptr<gondar::PeerLookup> peerLookup;
+  // Peers that answered the lookup, waiting on the origin's hash to
+  // see which of them can be trusted
+  QList<gondar::PeerLookup::Peer> foundPeers;
+  QList<QUrl> hashSources;
+  QNetworkReply* originHashReply = nullptr;
+  std::unique_ptr<gondar::MirrorRace> race;
+  // When LAN peers are among |mirrors|, the mirrors without them and
+  // the hash the origin gave for the file; the download is checked
+  // against it and retried from |originMirrors| if it doesn't match
+  QList<QUrl> originMirrors;
+  QByteArray expectedSha256;
+  std::future<void> verification;
+  std::atomic<bool> stopVerifying{false};
   QNetworkReply* currentDownload;
+  // Where in the file the current transfer started, and how much of
+  // its body has been written after that
+  qint64 transferOffset;
+  qint64 acceptedBytes;
+  bool checkedStatus;
+  // Whether the current transfer's status is one whose body belongs
+  // in the file
+  bool statusOk;
+  // Set when a mirror resumed a different version of the file, which
+  // then has to be downloaded again from the start
+  bool restarting;
+  bool switchingMirror;
+  // What the transfer that started the file said about it, so that a
+  // mirror resuming it can be checked to have the same file: a strong
+  // ETag, empty if there was none, and the length, -1 if unknown
+  QByteArray fileEtag;
+  qint64 fileLength;
+  QTimer throughputTimer;
+  qint64 windowBytes;
+  qint64 minBytesPerSec;
+  // Empty for the download directory
+  QString outputDir;
   QFile output;
   QTime downloadTime;
   GondarWizard* wizard;
 
   bool error;
+  bool cancelled;
   int downloadedCount;
   int totalCount;
 };
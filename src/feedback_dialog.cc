@@ -20,6 +20,7 @@
 #include <stdexcept>
 
 #include "gondarwizard.h"
+#include "http_client.h"
 #include "log.h"
 #include "metric.h"
 #include "util.h"
@@ -33,8 +34,6 @@ FeedbackDialog::FeedbackDialog() {
   submit_button_.setText(tr("&Submit"));
   connect(&submit_button_, &QPushButton::clicked, this,
           &FeedbackDialog::submit);
-  connect(&network_manager_, &QNetworkAccessManager::finished, this,
-          &FeedbackDialog::handleReply);
   connect(&feedback_field_, &QTextEdit::textChanged, this,
           &FeedbackDialog::maybeEnableSubmit);
 
@@ -57,12 +56,13 @@ void FeedbackDialog::setWizard(GondarWizard* wizard_in) {
 
 static QNetworkRequest createFeedbackRequest() {
   auto url = QUrl("https://github.com/Alex313031/ThOS_USB_Maker/issues");
-  QNetworkRequest request(url);
+  QNetworkRequest request = CreateRequest(url);
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
   return request;
 }
 
 void FeedbackDialog::handleReply(QNetworkReply* reply) {
+  reply->deleteLater();
   const auto error = reply->error();
 
   if (error != QNetworkReply::NoError) {
@@ -105,7 +105,10 @@ void FeedbackDialog::submit() {
   }
   QJsonDocument doc(json);
   LOG_INFO << "feedback: " << std::endl << doc.toJson(QJsonDocument::Indented);
-  network_manager_.post(request, doc.toJson(QJsonDocument::Compact));
+  QNetworkReply* reply =
+      GetNetworkManager()->post(request, doc.toJson(QJsonDocument::Compact));
+  connect(reply, &QNetworkReply::finished, this,
+          [this, reply]() { handleReply(reply); });
 
   // clear text field in case user wants to send more feedback later
   feedback_field_.clear();
@@ -19,7 +19,6 @@
 #include <QDialog>
 #include <QLabel>
 #include <QLineEdit>
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QPushButton>
 #include <QTextEdit>
@@ -43,7 +42,6 @@ class FeedbackDialog : public QDialog {
   void handleReply(QNetworkReply* reply);
   QLabel feedback_label_;
   QTextEdit feedback_field_;
-  QNetworkAccessManager network_manager_;
   QPushButton submit_button_;
   QVBoxLayout layout_;
   GondarWizard* wizard;
@@ -30,10 +30,12 @@
 #include <windows.h>
 // clang-format on
 
+#include <algorithm>
 #include <inttypes.h>
 #include <setupapi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <usbioctl.h>
 #include <versionhelpers.h>
 
@@ -41,11 +43,16 @@
 #include "msapi_utf8.h"
 
 // gondar-level includes
+#include "block_map.h"
+#include "buffer_pool.h"
 #include "device.h"
 #include "gpt_pal.h"
+#include "image_analyzer.h"
 #include "log.h"
 #include "mkfs.h"
 #include "shared.h"
+#include "trace.h"
+#include "write_telemetry.h"
 
 static ssize_t size_t_to_signed(const size_t value) {
   if (value <= SSIZE_MAX) {
@@ -100,16 +107,15 @@ static int dword_to_int(const DWORD value) {
     free((void*)p);  \
     p = NULL;        \
   } while (0)
-#define safe_mm_free(p) \
-  do {                  \
-    _mm_free((void*)p); \
-    p = NULL;           \
-  } while (0)
 
 #define DD_BUFFER_SIZE \
   65536  // Minimum size of the buffer we use for DD operations
 
 #define WRITE_RETRIES 3
+#define WRITE_RETRY_DELAY_MS 200
+// The retry delay is slept in slices this long so that a cancel is
+// noticed quickly
+#define CANCEL_POLL_MS 10
 
 #define FAC(f) (f << 16)
 
@@ -372,16 +378,32 @@ out:
   return r;
 }
 
+static bool IsCancelled(const std::atomic<bool>* cancel) {
+  return cancel && *cancel;
+}
+
+// Sleep for |ms|, waking early if |cancel| is set. Returns false if
+// cancelled.
+static bool CancellableSleep(DWORD ms, const std::atomic<bool>* cancel) {
+  for (DWORD slept = 0; slept < ms; slept += CANCEL_POLL_MS) {
+    if (IsCancelled(cancel))
+      return false;
+    Sleep(CANCEL_POLL_MS);
+  }
+  return !IsCancelled(cancel);
+}
+
 // from drive.c
 /*
  * Open a drive or volume with optional write and lock access
  * Return INVALID_HANDLE_VALUE (/!\ which is DIFFERENT from NULL /!\) on
- * failure.
+ * failure, or if cancel is set while waiting for access.
  */
 static HANDLE GetHandle(char* Path,
                         bool bLockDrive,
                         bool bWriteAccess,
-                        bool bWriteShare) {
+                        bool bWriteShare,
+                        const std::atomic<bool>* cancel = nullptr) {
   int i;
   DWORD size;
   HANDLE hDrive = INVALID_HANDLE_VALUE;
@@ -422,7 +444,8 @@ static HANDLE GetHandle(char* Path,
           "sharing enabled...");
       bWriteShare = true;
     }
-    Sleep(DRIVE_ACCESS_TIMEOUT / DRIVE_ACCESS_RETRIES);
+    if (!CancellableSleep(DRIVE_ACCESS_TIMEOUT / DRIVE_ACCESS_RETRIES, cancel))
+      break;
   }
   if (hDrive == INVALID_HANDLE_VALUE) {
     printf("Could not open %s [%s]:\n", Path, DevPath);
@@ -443,7 +466,9 @@ static HANDLE GetHandle(char* Path,
       if (DeviceIoControl(hDrive, FSCTL_LOCK_VOLUME, NULL, 0, NULL, 0, &size,
                           NULL))
         goto out;
-      Sleep(DRIVE_ACCESS_TIMEOUT / DRIVE_ACCESS_RETRIES);
+      if (!CancellableSleep(DRIVE_ACCESS_TIMEOUT / DRIVE_ACCESS_RETRIES,
+                            cancel))
+        break;
     }
     // If we reached this section, either we didn't manage to get a lock or the
     // user cancelled
@@ -898,6 +923,27 @@ out:
   safe_closehandle(handle);
   return r;
 }
+
+/*
+ * Walk up from device_inst to the root hub it hangs off, one per host
+ * controller, and return its Device ID, or an empty string if there is
+ * none. Hubs further down share the root hub's bandwidth, so that is
+ * what devices written at the same time compete for.
+ */
+static std::string GetRootHubId(DEVINST device_inst) {
+  static const char root_hub_prefix[] = "USB\\ROOT_HUB";
+  char device_id[MAX_PATH];
+  DEVINST inst = device_inst;
+  while (CM_Get_Parent(&inst, inst, 0) == CR_SUCCESS) {
+    if (CM_Get_Device_IDA(inst, device_id, MAX_PATH, 0) != CR_SUCCESS)
+      break;
+    if (safe_strnicmp(device_id, root_hub_prefix,
+                      sizeof(root_hub_prefix) - 1) == 0)
+      return device_id;
+  }
+  return std::string();
+}
+
 /*
  * Parse a line of UTF-16 text and return the data if it matches the 'token'
  * The parsed line is of the form: [ ][<][ ]token[ ][=|>][ ]["]data["][ ][<] and
@@ -1411,6 +1457,7 @@ static void GetDevices(DeviceGuyList* device_list) {
   char *p, buffer[MAX_PATH], str[MAX_PATH];
   const char* label;
   const char* method_str;
+  const char* hub_path;
   usb_device_props props;
 
   StrArrayCreate(&dev_if_path, 128);
@@ -1554,6 +1601,7 @@ static void GetDevices(DeviceGuyList* device_list) {
   for (i = 0; SetupDiEnumDeviceInfo(dev_info, i, &dev_info_data); i++) {
     memset(buffer, 0, sizeof(buffer));
     memset(&props, 0, sizeof(props));
+    hub_path = "";
     method_str = "";
     if (!SetupDiGetDeviceRegistryPropertyA(
             dev_info, &dev_info_data, SPDRP_ENUMERATOR_NAME, &datatype,
@@ -1703,9 +1751,8 @@ static void GetDevices(DeviceGuyList* device_list) {
           printf("  Matched with Hub[%d]: '%s'",
                  (uintptr_t)htab_devid.table[j].data,
                  dev_if_path.String[(uintptr_t)htab_devid.table[j].data]);
-          if (GetUSBProperties(
-                  dev_if_path.String[(uintptr_t)htab_devid.table[j].data],
-                  device_id, &props))
+          hub_path = dev_if_path.String[(uintptr_t)htab_devid.table[j].data];
+          if (GetUSBProperties(hub_path, device_id, &props))
             method_str = "";
 #ifdef FORCED_DEVICE
           props.vid = FORCED_VID;
@@ -1890,7 +1937,15 @@ static void GetDevices(DeviceGuyList* device_list) {
       // if we don't already have a ret, make this our ret
       printf("device %lu qualified\n", drive_index);
       uint64_t num_bytes = GetDriveSize(drive_index);
-      device_list->emplace_back(DeviceGuy(drive_index, buffer, num_bytes));
+      DeviceGuy device(drive_index, buffer, num_bytes);
+      // Fall back on the hub if the root hub can't be found
+      device.bus = GetRootHubId(dev_info_data.DevInst);
+      if (device.bus.empty())
+        device.bus = hub_path;
+      if (CM_Get_Device_IDA(dev_info_data.DevInst, str, MAX_PATH, 0) ==
+          CR_SUCCESS)
+        device.instance_path = str;
+      device_list->push_back(device);
     }
   }
 
@@ -2162,12 +2217,136 @@ static uint64_t GetSectorSize(DWORD DriveIndex) {
   return DiskGeometry->Geometry.BytesPerSector;
 }
 
+// Write |size| bytes from |buffer| at the drive's current position,
+// which must be |offset|, retrying a few times before giving up
+static bool WriteWithRetries(HANDLE hPhysicalDrive,
+                             const uint8_t* buffer,
+                             DWORD size,
+                             uint64_t offset,
+                             uint64_t sector_size,
+                             const std::atomic<bool>* cancel,
+                             gondar::WriteTelemetry* telemetry) {
+  LARGE_INTEGER li;
+  DWORD wSize = 0;
+  for (int i = 0; i < WRITE_RETRIES; i++) {
+    const bool s = WriteFile(hPhysicalDrive, buffer, size, &wSize, NULL);
+    if ((s) && (wSize == size))
+      return true;
+    if (s)
+      printf("write error: Wrote %lu bytes, expected %lu bytes", wSize, size);
+    else
+      printf("write error at sector %llu:\n", offset / sector_size);
+    if (i == WRITE_RETRIES - 1) {
+      FormatStatus =
+          ERROR_SEVERITY_ERROR | FAC(FACILITY_STORAGE) | ERROR_WRITE_FAULT;
+      return false;
+    }
+    li.QuadPart = offset;
+    printf("  RETRYING...\n");
+    gondar::Trace::instant("write", "retry");
+    if (telemetry)
+      telemetry->addRetry();
+    if (!SetFilePointerEx(hPhysicalDrive, li, NULL, FILE_BEGIN)) {
+      printf("write error: could not reset position -");
+      return false;
+    }
+    if (!CancellableSleep(WRITE_RETRY_DELAY_MS, cancel)) {
+      LOG_WARNING << "write cancelled while retrying";
+      return false;
+    }
+  }
+  return false;
+}
+
+// Copy only the ranges listed in |block_map|, checking each against
+// its checksum (if it has one) as it is read. Everything between the
+// ranges is left as it is on the drive.
+static bool WriteMappedRanges(HANDLE hPhysicalDrive,
+                              HANDLE hSourceImage,
+                              const gondar::BlockMap& block_map,
+                              uint8_t* buffer,
+                              DWORD BufSize,
+                              uint64_t sector_size,
+                              uint64_t drive_size,
+                              const std::atomic<bool>* cancel,
+                              gondar::WriteTelemetry* telemetry) {
+  LARGE_INTEGER li;
+  DWORD rSize;
+  uint64_t written = 0;
+  for (const auto& range : block_map.ranges()) {
+    const uint64_t start = block_map.rangeStart(range);
+    const uint64_t end = block_map.rangeEnd(range);
+    if (end > drive_size) {
+      LOG_ERROR << "block map range " << range.first << "-" << range.last
+                << " is past the end of the drive";
+      return false;
+    }
+    li.QuadPart = start;
+    if (!SetFilePointerEx(hSourceImage, li, NULL, FILE_BEGIN) ||
+        !SetFilePointerEx(hPhysicalDrive, li, NULL, FILE_BEGIN)) {
+      printf("could not seek to block %llu\n", range.first);
+      return false;
+    }
+
+    const bool check = !range.checksum.isEmpty();
+    QCryptographicHash hash(block_map.checksumType());
+    for (uint64_t pos = start; pos < end; pos += rSize) {
+      gondar::TraceScope trace("write", "batch");
+      if (IsCancelled(cancel)) {
+        LOG_WARNING << "write cancelled at sector " << pos / sector_size;
+        return false;
+      }
+      const DWORD want = (DWORD)std::min<uint64_t>(BufSize, end - pos);
+      if (!ReadFile(hSourceImage, buffer, want, &rSize, NULL) ||
+          rSize != want) {
+        FormatStatus =
+            ERROR_SEVERITY_ERROR | FAC(FACILITY_STORAGE) | ERROR_READ_FAULT;
+        printf("read error:\n");
+        return false;
+      }
+      if (check)
+        hash.addData(reinterpret_cast<const char*>(buffer), (int)rSize);
+
+      // only the image's last block can be short; pad it out to a
+      // whole sector
+      DWORD aligned = rSize;
+      if (aligned % sector_size != 0) {
+        aligned = ((aligned + sector_size - 1) / sector_size) * sector_size;
+        memset(buffer + rSize, 0, aligned - rSize);
+      }
+      if (!WriteWithRetries(hPhysicalDrive, buffer, aligned, pos, sector_size,
+                            cancel, telemetry))
+        return false;
+      written += rSize;
+      if (telemetry)
+        telemetry->addBytes(rSize, (pos + aligned) / sector_size);
+      gondar::Trace::counter("written_bytes", written);
+    }
+
+    if (check && hash.result().toHex() != range.checksum) {
+      LOG_ERROR << "image blocks " << range.first << "-" << range.last
+                << " do not match the block map";
+      FormatStatus =
+          ERROR_SEVERITY_ERROR | FAC(FACILITY_STORAGE) | ERROR_READ_FAULT;
+      return false;
+    }
+  }
+  return true;
+}
+
 // from format.c
+// |cancel| is checked before every buffer, so a cancelled write stops
+// within one buffer's write time. Writes are synchronous, so there is
+// never any I/O left in flight when this returns. With a |block_map|
+// only the mapped ranges of the image are written.
 static bool WriteDrive(HANDLE hPhysicalDrive,
                        HANDLE hSourceImage,
                        uint64_t sector_size,
                        uint64_t drive_size,
-                       int64_t image_size) {
+                       int64_t image_size,
+                       const gondar::BlockMap* block_map,
+                       const std::atomic<bool>* cancel,
+                       gondar::WriteTelemetry* telemetry) {
   bool s, ret = false;
   LARGE_INTEGER li;
   DWORD rSize, wSize, BufSize;
@@ -2179,7 +2358,7 @@ static bool WriteDrive(HANDLE hPhysicalDrive,
 
   uint64_t wb, target_size = projected_size;
   uint8_t* buffer = NULL;
-  int i;
+  size_t buffer_capacity = 0;
 
   // We poked the MBR and other stuff, so we need to rewind
   li.QuadPart = 0;
@@ -2200,7 +2379,7 @@ static bool WriteDrive(HANDLE hPhysicalDrive,
   }
   // return true;
   BufSize = ((DD_BUFFER_SIZE + sector_size - 1) / sector_size) * sector_size;
-  buffer = (uint8_t*)_mm_malloc(BufSize, sector_size);
+  buffer = gondar::BufferPool::instance()->acquire(BufSize, &buffer_capacity);
   if (buffer == NULL) {
     FormatStatus =
         ERROR_SEVERITY_ERROR | FAC(FACILITY_STORAGE) | ERROR_NOT_ENOUGH_MEMORY;
@@ -2220,9 +2399,27 @@ static bool WriteDrive(HANDLE hPhysicalDrive,
   // operations
   // will be as fast, if not faster, than whatever async scheme you can come up
   // with.
+  if (block_map && block_map->blockSize() % sector_size != 0) {
+    LOG_WARNING << "block map uses " << block_map->blockSize()
+                << "-byte blocks, which are not whole sectors; writing "
+                   "the full image";
+    block_map = nullptr;
+  }
+  if (block_map && hSourceImage != NULL) {
+    if (!WriteMappedRanges(hPhysicalDrive, hSourceImage, *block_map, buffer,
+                           BufSize, sector_size, drive_size, cancel,
+                           telemetry))
+      goto out;
+    goto written;
+  }
   rSize = BufSize;
   // i made this
   for (wb = 0, wSize = 0; wb < drive_size; wb += wSize) {
+    gondar::TraceScope trace("write", "batch");
+    if (IsCancelled(cancel)) {
+      LOG_WARNING << "write cancelled at sector " << wb / sector_size;
+      goto out;
+    }
     if (hSourceImage != NULL) {
       s = ReadFile(hSourceImage, buffer, BufSize, &rSize, NULL);
       if (!s) {
@@ -2242,36 +2439,26 @@ static bool WriteDrive(HANDLE hPhysicalDrive,
     // WriteFile fails unless the size is a multiple of sector size
     if (rSize % sector_size != 0)
       rSize = ((rSize + sector_size - 1) / sector_size) * sector_size;
-    for (i = 0; i < WRITE_RETRIES; i++) {
-      s = WriteFile(hPhysicalDrive, buffer, rSize, &wSize, NULL);
-      if ((s) && (wSize == rSize))
-        break;
-      if (s)
-        printf("write error: Wrote %lu bytes, expected %lu bytes", wSize,
-               rSize);
-      else
-        printf("write error at sector %llu:\n", wb / sector_size);
-      if (i < WRITE_RETRIES - 1) {
-        li.QuadPart = wb;
-        printf("  RETRYING...\n");
-        if (!SetFilePointerEx(hPhysicalDrive, li, NULL, FILE_BEGIN)) {
-          printf("write error: could not reset position -");
-          goto out;
-        }
-      } else {
-        FormatStatus =
-            ERROR_SEVERITY_ERROR | FAC(FACILITY_STORAGE) | ERROR_WRITE_FAULT;
-        goto out;
-      }
-      Sleep(200);
-    }
-    if (i >= WRITE_RETRIES)
+    if (!WriteWithRetries(hPhysicalDrive, buffer, rSize, wb, sector_size,
+                          cancel, telemetry))
       goto out;
+    wSize = rSize;
+    if (telemetry)
+      telemetry->addBytes(wSize, (wb + wSize) / sector_size);
+    gondar::Trace::counter("written_bytes", wb + wSize);
+  }
+written:
+  if (telemetry) {
+    telemetry->endStage(gondar::WriteTelemetry::Stage::Write);
+    telemetry->beginStage(gondar::WriteTelemetry::Stage::Sync);
+  }
+  {
+    gondar::TraceScope trace("write", "refresh_layout");
+    RefreshDriveLayout(hPhysicalDrive);
   }
-  RefreshDriveLayout(hPhysicalDrive);
   ret = true;
 out:
-  safe_mm_free(buffer);
+  gondar::BufferPool::instance()->release(buffer, buffer_capacity);
   return ret;
 }
 
@@ -2281,8 +2468,13 @@ DeviceGuyList GetDeviceList() {
   return device_list;
 }
 
-static bool formatShared(char* physical_path) {
+// Returns false if clearing fails or |cancel| is set, which is only
+// checked on either side of the clear itself
+static bool formatShared(char* physical_path,
+                         const std::atomic<bool>* cancel = nullptr) {
   LOG_INFO << "using physical_path=" << physical_path;
+  if (IsCancelled(cancel))
+    return false;
   bool success = clearMbrGpt(physical_path);
   if (!success) {
     LOG_WARNING << "error clearing mbr/gpt";
@@ -2290,22 +2482,58 @@ static bool formatShared(char* physical_path) {
     return false;
   }
   LOG_INFO << "success clearing mbr/gpt";
-  return true;
+  return !IsCancelled(cancel);
+}
+
+// Find the parts of the image its own partition table and filesystems
+// say are unused, so the write can skip them
+static gondar::Option<gondar::BlockMap> AnalyzeImageFile(
+    const char* image_path,
+    int64_t image_size,
+    const std::atomic<bool>* cancel) {
+  gondar::TraceScope trace("write", "analyze_image");
+  uint32_t sector_size = 0;
+  std::vector<gondar::PartitionExtent> partitions;
+  if (!gondar::ReadImagePartitions(QString::fromUtf8(image_path),
+                                   &sector_size, &partitions)) {
+    LOG_INFO << "no usable GPT in " << image_path << ", writing all of it";
+    return gondar::nullopt;
+  }
+  return gondar::AnalyzeImage(QString::fromUtf8(image_path),
+                              static_cast<uint64_t>(image_size), sector_size,
+                              partitions, cancel);
 }
 
 bool Install(DeviceGuy* target_device,
              const char* image_path,
-             int64_t image_size) {
+             int64_t image_size,
+             const std::atomic<bool>* cancel,
+             gondar::WriteTelemetry* telemetry,
+             const gondar::BlockMap* block_map) {
+  using Stage = gondar::WriteTelemetry::Stage;
+  if (IsCancelled(cancel))
+    return false;
+  gondar::Option<gondar::BlockMap> analyzed;
+  if (!block_map) {
+    analyzed = AnalyzeImageFile(image_path, image_size, cancel);
+    if (IsCancelled(cancel))
+      return false;
+    if (analyzed)
+      block_map = &*analyzed;
+  }
+  if (telemetry)
+    telemetry->beginStage(Stage::Partition);
   uint64_t device_num = target_device->device_num;
   uint64_t sector_size = GetSectorSize(device_num);
   uint64_t drive_size = GetDriveSize(device_num);
   // FIXME: this is a leak
   char* physical_path = GetPhysicalName(device_num);
-  if (!formatShared(physical_path)) {
+  if (!formatShared(physical_path, cancel)) {
     // pass up the failure
+    safe_free(physical_path);
     return false;
   }
-  HANDLE phys_handle = GetHandle(physical_path, true, true, false);
+  HANDLE phys_handle = GetHandle(physical_path, true, true, false, cancel);
   // HANDLE phys_handle = GetHandle(physical_path, true, true, true);
   // ^ i have not noticed any difference in behavior whether we share or not
   HANDLE source_img =
@@ -2318,6 +2546,11 @@ bool Install(DeviceGuy* target_device,
       source_img != INVALID_HANDLE_VALUE) {
     printf("Handles are valid\n");
   }
+  if (IsCancelled(cancel)) {
+    safe_closehandle(phys_handle);
+    safe_closehandle(source_img);
+    return false;
+  }
   HANDLE hLogicalVolume = GetLogicalHandle(device_num, true, false, false);
   if (hLogicalVolume == INVALID_HANDLE_VALUE) {
     printf("Could not lock volume\n");
@@ -2328,14 +2561,24 @@ bool Install(DeviceGuy* target_device,
     printf("Physical handle invalid\n");
   }
 
-  ret =
-      WriteDrive(phys_handle, source_img, sector_size, drive_size, image_size);
+  if (telemetry) {
+    telemetry->endStage(Stage::Partition);
+    telemetry->setTotalBytes(
+        block_map ? block_map->mappedBytes()
+                  : std::min<uint64_t>(static_cast<uint64_t>(image_size),
+                                       drive_size));
+    telemetry->beginStage(Stage::Write);
+  }
+  ret = WriteDrive(phys_handle, source_img, sector_size, drive_size,
+                   image_size, block_map, cancel, telemetry);
 
   // close the handles we created so that Install() may be called again
   // within this same run
   safe_closehandle(phys_handle);
   safe_closehandle(hLogicalVolume);
   safe_closehandle(source_img);
+  if (ret && telemetry)
+    telemetry->endStage(Stage::Sync);
 
   return ret;
 }
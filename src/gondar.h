@@ -16,15 +16,30 @@
 #ifndef SRC_GONDAR_H_
 #define SRC_GONDAR_H_
 
+#include <atomic>
+
 #include "device.h"
 #include "shared.h"
 
+namespace gondar {
+class BlockMap;
+class WriteTelemetry;
+}
+
 DeviceGuyList GetDeviceList();
 
-// Returns true on success
+// Returns true on success. If |cancel| is given and becomes true, the
+// write stops before its next buffer and false is returned. Progress
+// is published to |telemetry| if it is given. With a |block_map| only
+// the image's mapped ranges are written and checked against it;
+// without one, the image's GPT and ext filesystems are read to find
+// the ranges that are in use.
 bool Install(DeviceGuy* target_device,
              const char* image_path,
-             int64_t image_size);
+             int64_t image_size,
+             const std::atomic<bool>* cancel = nullptr,
+             gondar::WriteTelemetry* telemetry = nullptr,
+             const gondar::BlockMap* block_map = nullptr);
 bool Format(DeviceGuy* target_device);
 bool IsCurrentProcessElevated();
 void CleanUp();
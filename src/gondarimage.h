@@ -16,12 +16,15 @@
 #ifndef SRC_GONDARIMAGE_H_
 #define SRC_GONDARIMAGE_H_
 
+#include <QString>
+#include <QUrl>
+
 class GondarImage {
  public:
   GondarImage() {}
   GondarImage(QString productIn, QString imageNameIn, QUrl urlIn)
       : product(productIn), imageName(imageNameIn), url(urlIn) {}
-  QString getCompositeName() { return product + " " + imageName; }
+  QString getCompositeName() const { return product + " " + imageName; }
   bool isDeployable() const {
     return imageName.contains("deployable", Qt::CaseInsensitive);
   }
@@ -23,9 +23,11 @@
 #include "device_select_page.h"
 #include "error_page.h"
 #include "feedback_dialog.h"
+#include "http_client.h"
 #include "log.h"
 #include "metric.h"
 #include "site_select_page.h"
+#include "trace.h"
 #include "update_check.h"
 
 class GondarWizard::Private {
@@ -44,6 +46,7 @@ class GondarWizard::Private {
   ErrorPage errorPage;
 
   std::vector<GondarSite> sites;
+  QString localImage;
 
   QDateTime runTime;
 };
@@ -89,21 +92,41 @@ void GondarWizard::init() {
           &gondar::AboutDialog::show);
   connect(this, &GondarWizard::customButtonClicked, this,
           &GondarWizard::handleCustomButton);
+  connect(this, &QWizard::currentIdChanged, this, [this]() {
+    if (gondar::Trace::enabled() && currentPage()) {
+      gondar::Trace::instant("ui", currentPage()->metaObject()->className());
+    }
+  });
   // appropriately move to error screen if there is a problem getting
   // latest beerover url
   connect(&newestImageUrl, &NewestImageUrl::errorOccurred, this,
           &GondarWizard::handleNewestImageUrlError);
+  connect(&newestImageUrl, &NewestImageUrl::ready, this, [this]() {
+    timings.finish(gondar::RunTimings::Span::ResolveUrl);
+    // beerover has only one image, so there is nothing left to choose
+    if (!formatOnly && p_->localImage.isEmpty()) {
+      imageFetcher.start(newestImageUrl.get64Mirrors());
+    }
+  });
   // wizard is responsible for this connection as wizard() is not callable
   // at construction time
   connect(&meepo_, &gondar::Meepo::finished, &p_->chromeoverLoginPage,
           &ChromeoverLoginPage::handleMeepoFinished);
   connect(&meepo_, &gondar::Meepo::failed, &p_->chromeoverLoginPage,
           &ChromeoverLoginPage::handleMeepoFailed);
+  // the site select page reads the list when it is shown, so it picks
+  // up the revalidated sites if they arrive first
+  connect(&meepo_, &gondar::Meepo::sitesUpdated, this,
+          [this]() { setSites(meepo_.sites()); });
 
   p_->feedbackDialog.setWizard(this);
+  imageFetcher.setWizard(this);
 
   p_->runTime = QDateTime::currentDateTime();
   p_->updateCheck.start(this);
+  // get the handshakes out of the way while the user reads the first
+  // page
+  gondar::PreconnectKnownHosts();
 
   // resize the window (width, height)
   resize(720, 480);
@@ -180,6 +203,24 @@ qint64 GondarWizard::getRunTime() {
   return p_->runTime.secsTo(QDateTime::currentDateTime());
 }
 
+void GondarWizard::setFormatOnly(bool newValue) {
+  formatOnly = newValue;
+  if (formatOnly) {
+    // no image is needed to format a drive
+    imageFetcher.cancel();
+  }
+}
+
+const QString& GondarWizard::localImage() const {
+  return p_->localImage;
+}
+
+void GondarWizard::setLocalImage(const QString& path) {
+  p_->localImage = path;
+  // verify or extract it while the user picks a device
+  imageFetcher.start({QUrl::fromLocalFile(path)});
+}
+
 bool GondarWizard::getSessionError() {
   return session_error;
 }
@@ -194,6 +235,7 @@ void GondarWizard::setSessionError(bool error_in) {
 void GondarWizard::maybe_fetch() {
   if (!gondar::isChromeover()) {
     // for beerover, we'll have to check what the latest release is
+    timings.start(gondar::RunTimings::Span::ResolveUrl);
     newestImageUrl.fetch();
   }
 }
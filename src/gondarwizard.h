@@ -24,9 +24,11 @@
 
 #include "device_picker.h"
 #include "download_progress_page.h"
+#include "image_fetcher.h"
 #include "image_select_page.h"
 #include "meepo.h"
 #include "newest_image_url.h"
+#include "run_timings.h"
 #include "usb_insert_page.h"
 #include "write_operation_page.h"
 
@@ -61,13 +63,22 @@ class GondarWizard : public QWizard {
   UsbInsertPage usbInsertPage;
   WriteOperationPage writeOperationPage;
   NewestImageUrl newestImageUrl;
+  // Started as soon as the image URL is known, so the download overlaps
+  // with the user picking a device
+  gondar::ImageFetcher imageFetcher;
+  // Stage timings of the current run, reported once a USB is made
+  gondar::RunTimings timings;
 
   gondar::Meepo meepo_;
 
   const std::vector<GondarSite>& sites() const;
   void setSites(const std::vector<GondarSite>& sites);
   bool isFormatOnly() const { return formatOnly; }
-  void setFormatOnly(bool newValue) { formatOnly = newValue; }
+  void setFormatOnly(bool newValue);
+  // An image file on disk or a mounted share to write instead of
+  // downloading one; empty if none was chosen
+  const QString& localImage() const;
+  void setLocalImage(const QString& path);
   bool getSessionError();
   void setSessionError(bool);
   bool newestIsReady();
@@ -23,6 +23,8 @@
 #include "../gdisk/gpt.h"
 #include "../gdisk/parttypes.h"
 
+#include "trace.h"
+
 class PalData : public GPTData {
  public:
   PalData();
@@ -57,6 +59,7 @@ void PalData::ClearDisk() {
 
 // shared logic between writing cloudready usb and formatting disk
 bool clearMbrGpt(const char* physical_path) {
+  gondar::TraceScope trace("gpt", "clear");
   std::string physical_path_str(physical_path);
   PalData gptdata;
   // set the physical path for this GPT object to act on
@@ -77,6 +80,7 @@ bool clearMbrGpt(const char* physical_path) {
 
 // make a new partition using the whole disk, but do not format yet
 bool makeEmptyPartition(const char* physical_path) {
+  gondar::TraceScope trace("gpt", "make_empty_partition");
   PalData gptdata;
   gptdata.LoadPartitions(std::string(physical_path));
   // make an unformatted partition with label for fat32
@@ -0,0 +1,252 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "headless_installer.h"
+
+#include <QUrl>
+#include <algorithm>
+
+#include "log.h"
+#include "unzipthread.h"
+#include "write_telemetry.h"
+
+namespace gondar {
+
+namespace {
+
+// Download and write progress are reported at most this often
+const int progress_interval_ms = 250;
+
+QJsonObject deviceJson(const DeviceGuy& device) {
+  QJsonObject json;
+  json["id"] = static_cast<qint64>(device.device_num);
+  json["name"] = QString::fromStdString(device.name);
+  json["bytes"] = static_cast<qint64>(device.num_bytes);
+  json["bus"] = QString::fromStdString(device.bus);
+  return json;
+}
+
+QString stageName(const WriteTelemetry::Stage stage) {
+  switch (stage) {
+    case WriteTelemetry::Stage::Partition:
+      return "partition";
+    case WriteTelemetry::Stage::Write:
+      return "write";
+    case WriteTelemetry::Stage::Sync:
+      return "sync";
+  }
+  return QString();
+}
+
+}  // namespace
+
+HeadlessInstaller::HeadlessInstaller(QObject* parent) : QObject(parent) {
+  connect(&download_manager_, &DownloadManager::downloadProgress, this,
+          &HeadlessInstaller::onDownloadProgress);
+  connect(&download_manager_, &DownloadManager::finished, this,
+          &HeadlessInstaller::onDownloadFinished);
+  connect(&sidecar_check_, &SidecarCheck::finished, this,
+          &HeadlessInstaller::onLocalChecked);
+  write_progress_timer_.setInterval(progress_interval_ms);
+  connect(&write_progress_timer_, &QTimer::timeout, this,
+          &HeadlessInstaller::onWriteProgressTimer);
+}
+
+void HeadlessInstaller::start(const QString& source,
+                              const DeviceGuyList& devices) {
+  elapsed_.start();
+  devices_ = devices;
+
+  const QFileInfo local_file(source);
+  if (local_file.exists()) {
+    report("source", {{"path", local_file.absoluteFilePath()}});
+    local_file_ = local_file;
+    report("verify-started");
+    sidecar_check_.start(local_file.absoluteFilePath());
+    return;
+  }
+
+  const QUrl url(source);
+  if (url.scheme() == "http" || url.scheme() == "https") {
+    report("source", {{"url", url.toString()}});
+    startDownload(url);
+    return;
+  }
+
+  fail("image source is neither a file nor an http(s) URL: " + source);
+}
+
+void HeadlessInstaller::setScheduler(WriteScheduler* scheduler) {
+  scheduler_ = scheduler;
+}
+
+void HeadlessInstaller::setWorkDir(const QString& dir) {
+  work_dir_ = dir;
+  download_manager_.setOutputDir(dir);
+}
+
+void HeadlessInstaller::startDownload(const QUrl& url) {
+  report("download-started");
+  download_manager_.append(url);
+}
+
+void HeadlessInstaller::onDownloadProgress(const qint64 received,
+                                           const qint64 total) {
+  const qint64 now = elapsed_.elapsed();
+  if (received != total && last_progress_ms_ >= 0 &&
+      now - last_progress_ms_ < progress_interval_ms) {
+    return;
+  }
+  last_progress_ms_ = now;
+  report("download-progress", {{"received", received}, {"total", total}});
+}
+
+void HeadlessInstaller::onDownloadFinished() {
+  if (download_manager_.hasError()) {
+    fail("download failed");
+    return;
+  }
+  const QFileInfo output = download_manager_.outputFileInfo();
+  report("download-finished", {{"path", output.absoluteFilePath()}});
+  startUnzip(output);
+}
+
+void HeadlessInstaller::onLocalChecked(const SidecarCheck::Result result) {
+  switch (result) {
+    case SidecarCheck::Result::Mismatch:
+      fail("image does not match its .sha256 file");
+      return;
+    case SidecarCheck::Result::Unreadable:
+      fail("image could not be read");
+      return;
+    case SidecarCheck::Result::Verified:
+    case SidecarCheck::Result::NoSidecar:
+      break;
+  }
+  report("verify-finished",
+         {{"verified", result == SidecarCheck::Result::Verified}});
+  if (local_file_.suffix().compare("zip", Qt::CaseInsensitive) == 0) {
+    startUnzip(local_file_);
+  } else {
+    startWrites(local_file_.absoluteFilePath());
+  }
+}
+
+void HeadlessInstaller::startUnzip(const QFileInfo& zipfile) {
+  report("extract-started");
+  unzip_thread_ = new UnzipThread(zipfile, this);
+  unzip_thread_->setOutputDir(work_dir_);
+  connect(unzip_thread_, &UnzipThread::finished, this,
+          &HeadlessInstaller::onUnzipFinished);
+  unzip_thread_->start();
+}
+
+void HeadlessInstaller::onUnzipFinished() {
+  const QString image_path = unzip_thread_->getFileName();
+  if (image_path.isEmpty()) {
+    fail("extraction failed");
+    return;
+  }
+  report("extract-finished", {{"path", image_path}});
+  startWrites(image_path);
+}
+
+void HeadlessInstaller::startWrites(const QString& image_path) {
+  if (devices_.empty()) {
+    fail("no target devices");
+    return;
+  }
+
+  connect(scheduler_, &WriteScheduler::writeStarted, this,
+          &HeadlessInstaller::onWriteStarted);
+  connect(scheduler_, &WriteScheduler::writeFinished, this,
+          &HeadlessInstaller::onWriteFinished);
+
+  writes_remaining_ = static_cast<int>(devices_.size());
+  for (const auto& device : devices_) {
+    report("write-queued", {{"device", deviceJson(device)}});
+    scheduler_->enqueue(device, image_path);
+  }
+  write_progress_timer_.start();
+}
+
+bool HeadlessInstaller::isOurDevice(const DeviceGuy& device) const {
+  // A shared scheduler reports writes for other installers too
+  return std::find(devices_.begin(), devices_.end(), device) !=
+         devices_.end();
+}
+
+void HeadlessInstaller::onWriteStarted(const DeviceGuy& device) {
+  if (isOurDevice(device)) {
+    report("write-started", {{"device", deviceJson(device)}});
+  }
+}
+
+void HeadlessInstaller::onWriteProgressTimer() {
+  for (const auto& device : devices_) {
+    reportWriteProgress(device);
+  }
+}
+
+void HeadlessInstaller::reportWriteProgress(const DeviceGuy& device) {
+  // Null while the write is still queued
+  const WriteTelemetry* telemetry = scheduler_->telemetry(device);
+  if (!telemetry) {
+    return;
+  }
+  const auto snapshot = telemetry->snapshot();
+  report("write-progress",
+         {{"device", deviceJson(device)},
+          {"written", static_cast<qint64>(snapshot.bytes_written)},
+          {"total", static_cast<qint64>(snapshot.total_bytes)},
+          {"stage", stageName(snapshot.stage)}});
+}
+
+void HeadlessInstaller::onWriteFinished(const DeviceGuy& device,
+                                        const bool success) {
+  if (!isOurDevice(device)) {
+    return;
+  }
+  if (!success) {
+    write_failed_ = true;
+  }
+  // Writes can finish between ticks, so the last progress is always
+  // reported
+  reportWriteProgress(device);
+  report("write-finished",
+         {{"device", deviceJson(device)}, {"success", success}});
+
+  writes_remaining_--;
+  if (writes_remaining_ == 0) {
+    write_progress_timer_.stop();
+    report("done", {{"success", !write_failed_}});
+    emit finished(!write_failed_);
+  }
+}
+
+void HeadlessInstaller::report(const QString& name, QJsonObject fields) {
+  fields["event"] = name;
+  fields["elapsed_ms"] = elapsed_.elapsed();
+  emit event(fields);
+}
+
+void HeadlessInstaller::fail(const QString& error) {
+  LOG_ERROR << "headless install failed: " << error;
+  report("error", {{"message", error}});
+  report("done", {{"success", false}});
+  emit finished(false);
+}
+
+}  // namespace gondar
@@ -0,0 +1,103 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_HEADLESS_INSTALLER_H_
+#define SRC_HEADLESS_INSTALLER_H_
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <vector>
+
+#include "device.h"
+#include "downloader.h"
+#include "sidecar_check.h"
+#include "write_scheduler.h"
+
+class UnzipThread;
+
+namespace gondar {
+
+// Runs the same download -> unzip -> write steps as the wizard, but
+// without any widgets. Progress is reported through the event()
+// signal as JSON objects that always carry an "event" name and the
+// milliseconds elapsed since start().
+class HeadlessInstaller : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit HeadlessInstaller(QObject* parent = nullptr);
+
+  // |source| is either an http(s) URL or the path of a local .zip or
+  // .bin image. A local image with a .sha256 sidecar is checked against
+  // it first. The image is written to every device in |devices|.
+  void start(const QString& source, const DeviceGuyList& devices);
+
+  // Queue writes on |scheduler| instead of a scheduler of our own, so
+  // that several installers share the per-hub writer limit. Must be
+  // called before start().
+  void setScheduler(WriteScheduler* scheduler);
+
+  // Download and extract into |dir| instead of the download directory
+  // and next to a local zip, so that installers of the same image
+  // don't write over each other's files. Must be called before
+  // start().
+  void setWorkDir(const QString& dir);
+
+ signals:
+  void event(const QJsonObject& event);
+  void finished(bool success);
+
+ private:
+  void startDownload(const QUrl& url);
+  void onDownloadProgress(qint64 received, qint64 total);
+  void onDownloadFinished();
+
+  void onLocalChecked(SidecarCheck::Result result);
+
+  void startUnzip(const QFileInfo& zipfile);
+  void onUnzipFinished();
+
+  void startWrites(const QString& image_path);
+  void onWriteStarted(const DeviceGuy& device);
+  void onWriteProgressTimer();
+  void reportWriteProgress(const DeviceGuy& device);
+  void onWriteFinished(const DeviceGuy& device, bool success);
+  bool isOurDevice(const DeviceGuy& device) const;
+
+  void report(const QString& name, QJsonObject fields = QJsonObject());
+  void fail(const QString& error);
+
+  DownloadManager download_manager_;
+  SidecarCheck sidecar_check_;
+  QFileInfo local_file_;
+  UnzipThread* unzip_thread_ = nullptr;
+  WriteScheduler own_scheduler_;
+  WriteScheduler* scheduler_ = &own_scheduler_;
+  DeviceGuyList devices_;
+  QString work_dir_;
+  QElapsedTimer elapsed_;
+  qint64 last_progress_ms_ = -1;
+  QTimer write_progress_timer_;
+  int writes_remaining_ = 0;
+  bool write_failed_ = false;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_HEADLESS_INSTALLER_H_
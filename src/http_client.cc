@@ -0,0 +1,67 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "http_client.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QStringList>
+
+#include "log.h"
+#include "util.h"
+
+namespace gondar {
+
+QNetworkAccessManager* GetNetworkManager() {
+  // Owned by the application, so that it goes with the rest of Qt
+  // rather than in static destruction once the application is gone
+  static QPointer<QNetworkAccessManager> manager;
+  if (!manager) {
+    manager = new QNetworkAccessManager(QCoreApplication::instance());
+  }
+  return manager;
+}
+
+QNetworkRequest CreateRequest(const QUrl& url) {
+  QNetworkRequest request(url);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+  request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+  return request;
+}
+
+void PreconnectKnownHosts() {
+  QStringList hosts;
+  if (isChromeover()) {
+    // Meepo
+    hosts << "api." + getDomain();
+  } else {
+    // where NewestImageUrl looks up the image, and where the image is
+    hosts << "s3.amazonaws.com"
+          << "cloudready-free-downloads.neverware.com";
+  }
+  // UpdateCheck
+  if (!getGondarVersion().isEmpty()) {
+    hosts << "usb-maker-downloads.neverware.com";
+  }
+
+  QNetworkAccessManager* manager = GetNetworkManager();
+  for (const QString& host : hosts) {
+    LOG_INFO << "preconnecting to " << host;
+    manager->connectToHostEncrypted(host);
+  }
+}
+
+}  // namespace gondar
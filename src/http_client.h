@@ -0,0 +1,43 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_HTTP_CLIENT_H_
+#define SRC_HTTP_CLIENT_H_
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QUrl>
+
+namespace gondar {
+
+// The network manager shared by everything that makes HTTP requests
+// from the main thread, so that DNS lookups, connections and TLS
+// sessions are reused instead of each class paying for its own. Since
+// all replies come through the same manager, users must connect to
+// each reply's finished() signal rather than the manager's. The
+// manager is a child of the application; call this only while it
+// exists.
+QNetworkAccessManager* GetNetworkManager();
+
+// A request for |url| that may use HTTP/2 if the server offers it
+QNetworkRequest CreateRequest(const QUrl& url);
+
+// Open connections to the hosts this run is going to talk to, so that
+// the first real request to each does not wait for DNS, TCP and TLS
+void PreconnectKnownHosts();
+
+}  // namespace gondar
+
+#endif  // SRC_HTTP_CLIENT_H_
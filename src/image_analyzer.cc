@@ -0,0 +1,421 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_analyzer.h"
+
+#include <QFile>
+#include <QUuid>
+#include <QtEndian>
+#include <algorithm>
+#include <utility>
+
+#include "log.h"
+#include "trace.h"
+
+namespace gondar {
+
+namespace {
+
+// Granularity of the map; a whole number of sectors on any drive
+const uint32_t map_block_size = 4096;
+
+// Largest filesystem, in blocks, whose bitmaps we're willing to hold
+// in memory
+const uint64_t max_fs_blocks = 1ull << 28;
+
+const uint16_t ext_magic = 0xef53;
+const uint32_t compat_sparse_super2 = 0x200;
+const uint32_t incompat_meta_bg = 0x10;
+const uint32_t incompat_64bit = 0x80;
+const uint32_t ro_compat_sparse_super = 0x1;
+// Group descriptor flag for a block bitmap that was never written
+const uint16_t bg_block_uninit = 0x2;
+
+// Half-open byte range within the image
+using Extent = std::pair<uint64_t, uint64_t>;
+
+const char gpt_signature[] = "EFI PART";
+const uint32_t min_gpt_header_size = 92;
+const uint32_t min_gpt_entry_size = 128;
+// gdisk won't go past this many entries either
+const uint64_t max_gpt_entries_size = 1024 * 1024;
+
+// The partition types AnalyzeImage tells apart, by gdisk hex code
+const struct {
+  uint16_t type;
+  const char* guid;
+} known_partition_types[] = {
+    {0x0700, "{ebd0a0a2-b9e5-4433-87c0-68b6b72699c7}"},
+    {0x7f00, "{fe3a2a5d-4f32-41a7-b725-accc3285a309}"},
+    {0x7f01, "{3cb8e202-3b7e-47dd-8a3c-7ff2a13cfcec}"},
+    {0x7f02, "{2e0a753d-9e48-43b0-8337-b15192cb1b5e}"},
+    {0x8300, "{0fc63daf-8483-4772-8e79-3d69d8477de4}"},
+    {0xef00, "{c12a7328-f81f-11d2-ba4b-00a0c93ec93b}"},
+};
+
+// Basic data and Linux filesystem partitions; ChromeOS puts its
+// stateful partition in one of these
+bool isDataPartition(const uint16_t type) {
+  return type == 0x0700 || type == 0x8300;
+}
+
+uint16_t le16(const QByteArray& data, const uint64_t at) {
+  return qFromLittleEndian<quint16>(
+      reinterpret_cast<const uchar*>(data.constData() + at));
+}
+
+uint32_t le32(const QByteArray& data, const uint64_t at) {
+  return qFromLittleEndian<quint32>(
+      reinterpret_cast<const uchar*>(data.constData() + at));
+}
+
+uint64_t le64(const QByteArray& data, const uint64_t at) {
+  return qFromLittleEndian<quint64>(
+      reinterpret_cast<const uchar*>(data.constData() + at));
+}
+
+// The CRC-32 the GPT uses for its header and entry array
+uint32_t gptCrc32(const char* data, const uint64_t size) {
+  uint32_t crc = 0xffffffff;
+  for (uint64_t i = 0; i < size; i++) {
+    crc ^= static_cast<uint8_t>(data[i]);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+// A GUID as the GPT stores it, with the first three fields little
+// endian
+QUuid gptGuid(const QByteArray& data, const uint64_t at) {
+  const uchar* bytes = reinterpret_cast<const uchar*>(data.constData() + at);
+  return QUuid(le32(data, at), le16(data, at + 4), le16(data, at + 6),
+               bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13],
+               bytes[14], bytes[15]);
+}
+
+uint16_t partitionType(const QUuid& guid) {
+  for (const auto& known : known_partition_types) {
+    if (guid == QUuid(known.guid)) {
+      return known.type;
+    }
+  }
+  return 0;
+}
+
+bool readAt(QFile* file,
+            const uint64_t offset,
+            const uint64_t size,
+            QByteArray* out) {
+  if (!file->seek(static_cast<qint64>(offset))) {
+    return false;
+  }
+  *out = file->read(static_cast<qint64>(size));
+  return static_cast<uint64_t>(out->size()) == size;
+}
+
+bool isPowerOf(uint64_t n, const uint64_t base) {
+  while (n > 1 && n % base == 0) {
+    n /= base;
+  }
+  return n == 1;
+}
+
+// Whether |group| holds a copy of the superblock and group descriptors
+bool groupHasSuper(const uint64_t group, const bool sparse_super) {
+  if (group <= 1 || !sparse_super) {
+    return true;
+  }
+  return isPowerOf(group, 3) || isPowerOf(group, 5) || isPowerOf(group, 7);
+}
+
+// Append the parts of the ext2/3/4 filesystem at |offset| that are in
+// use to |used|. Returns false, appending nothing, if there is no such
+// filesystem there, it is laid out in a way this doesn't handle or
+// |cancel| is set.
+bool extUsedExtents(QFile* file,
+                    const uint64_t offset,
+                    const uint64_t length,
+                    const std::atomic<bool>* cancel,
+                    std::vector<Extent>* used) {
+  QByteArray sb;
+  if (length < 2048 || !readAt(file, offset + 1024, 1024, &sb) ||
+      le16(sb, 0x38) != ext_magic) {
+    return false;
+  }
+
+  const uint32_t log_block_size = le32(sb, 0x18);
+  if (log_block_size > 6) {
+    return false;
+  }
+  const uint64_t block_size = 1024ull << log_block_size;
+  const uint32_t compat = le32(sb, 0x5c);
+  const uint32_t incompat = le32(sb, 0x60);
+  const uint32_t ro_compat = le32(sb, 0x64);
+  if ((incompat & incompat_meta_bg) || (compat & compat_sparse_super2)) {
+    LOG_INFO << "ext filesystem at " << offset
+             << " uses meta_bg or sparse_super2, keeping it whole";
+    return false;
+  }
+  const bool is_64bit = incompat & incompat_64bit;
+  uint64_t blocks_count = le32(sb, 0x4);
+  if (is_64bit) {
+    blocks_count |= static_cast<uint64_t>(le32(sb, 0x150)) << 32;
+  }
+  const uint64_t first_data_block = le32(sb, 0x14);
+  const uint64_t blocks_per_group = le32(sb, 0x20);
+  const uint64_t inodes_per_group = le32(sb, 0x28);
+  const uint64_t inode_size = le32(sb, 0x4c) == 0 ? 128 : le16(sb, 0x58);
+  const uint64_t reserved_gdt_blocks = le16(sb, 0xce);
+  const uint64_t desc_size = is_64bit ? le16(sb, 0xfe) : 32;
+  if (blocks_per_group == 0 || blocks_per_group > block_size * 8 ||
+      blocks_count <= first_data_block || blocks_count > max_fs_blocks ||
+      blocks_count > length / block_size || desc_size < 32 ||
+      desc_size > block_size) {
+    LOG_WARNING << "ext filesystem at " << offset
+                << " has an implausible superblock";
+    return false;
+  }
+
+  const uint64_t groups =
+      (blocks_count - first_data_block + blocks_per_group - 1) /
+      blocks_per_group;
+  const uint64_t gdt_blocks =
+      (groups * desc_size + block_size - 1) / block_size;
+  const uint64_t itable_blocks =
+      (inodes_per_group * inode_size + block_size - 1) / block_size;
+  QByteArray gdt;
+  if (!readAt(file, offset + (first_data_block + 1) * block_size,
+              groups * desc_size, &gdt)) {
+    return false;
+  }
+
+  std::vector<bool> in_use(blocks_count, false);
+  auto mark = [&](const uint64_t first, const uint64_t count) {
+    for (uint64_t i = first; i < first + count && i < blocks_count; i++) {
+      in_use[i] = true;
+    }
+  };
+  // Boot block and primary superblock
+  mark(0, first_data_block + 1);
+
+  QByteArray bitmap;
+  for (uint64_t group = 0; group < groups; group++) {
+    if (cancel && *cancel) {
+      return false;
+    }
+    const uint64_t at = group * desc_size;
+    uint64_t block_bitmap = le32(gdt, at);
+    uint64_t inode_bitmap = le32(gdt, at + 0x4);
+    uint64_t inode_table = le32(gdt, at + 0x8);
+    if (desc_size >= 64) {
+      block_bitmap |= static_cast<uint64_t>(le32(gdt, at + 0x20)) << 32;
+      inode_bitmap |= static_cast<uint64_t>(le32(gdt, at + 0x24)) << 32;
+      inode_table |= static_cast<uint64_t>(le32(gdt, at + 0x28)) << 32;
+    }
+    const uint64_t group_first = first_data_block + group * blocks_per_group;
+    const uint64_t group_blocks =
+        std::min(blocks_per_group, blocks_count - group_first);
+
+    // An uninitialized bitmap doesn't record the group's metadata, so
+    // mark that explicitly
+    if (groupHasSuper(group, ro_compat & ro_compat_sparse_super)) {
+      mark(group_first, 1 + gdt_blocks + reserved_gdt_blocks);
+    }
+    mark(block_bitmap, 1);
+    mark(inode_bitmap, 1);
+    mark(inode_table, itable_blocks);
+    if (le16(gdt, at + 0x12) & bg_block_uninit) {
+      continue;
+    }
+
+    if (block_bitmap >= blocks_count ||
+        !readAt(file, offset + block_bitmap * block_size, block_size,
+                &bitmap)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < group_blocks; i++) {
+      if ((bitmap[static_cast<int>(i / 8)] >> (i % 8)) & 1) {
+        in_use[group_first + i] = true;
+      }
+    }
+  }
+
+  uint64_t run_start = 0;
+  for (uint64_t block = 0; block <= blocks_count; block++) {
+    const bool block_used = block < blocks_count && in_use[block];
+    if (block_used && (block == 0 || !in_use[block - 1])) {
+      run_start = block;
+    } else if (!block_used && block > 0 && in_use[block - 1]) {
+      used->emplace_back(offset + run_start * block_size,
+                         offset + block * block_size);
+    }
+  }
+  return true;
+}
+
+// Read the GPT header at |sector_size| into |header|, if there is a
+// valid one there
+bool readGptHeader(QFile* file,
+                   const uint32_t sector_size,
+                   QByteArray* header) {
+  if (!readAt(file, sector_size, sector_size, header) ||
+      !header->startsWith(gpt_signature)) {
+    return false;
+  }
+  const uint32_t header_size = le32(*header, 12);
+  if (header_size < min_gpt_header_size || header_size > sector_size) {
+    return false;
+  }
+  // The CRC covers the header with its own CRC field zeroed
+  QByteArray check = header->left(static_cast<int>(header_size));
+  const uint32_t crc = le32(check, 16);
+  check.replace(16, 4, QByteArray(4, '\0'));
+  return gptCrc32(check.constData(), header_size) == crc;
+}
+
+}  // namespace
+
+bool ReadImagePartitions(const QString& image_path,
+                         uint32_t* sector_size,
+                         std::vector<PartitionExtent>* partitions) {
+  TraceScope trace("gpt", "read_image");
+  QFile file(image_path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG_WARNING << "can't open " << image_path << ": " << file.errorString();
+    return false;
+  }
+
+  // The header is in the second sector, whatever size that is
+  QByteArray header;
+  uint32_t found_sector_size = 0;
+  for (const uint32_t size : {512u, 4096u}) {
+    if (readGptHeader(&file, size, &header)) {
+      found_sector_size = size;
+      break;
+    }
+  }
+  if (found_sector_size == 0) {
+    return false;
+  }
+
+  const uint64_t entries_lba = le64(header, 72);
+  const uint64_t entry_count = le32(header, 80);
+  const uint64_t entry_size = le32(header, 84);
+  if (entry_size < min_gpt_entry_size || entry_size % 8 != 0 ||
+      entry_count * entry_size > max_gpt_entries_size) {
+    LOG_WARNING << image_path << " has an implausible GPT header";
+    return false;
+  }
+  QByteArray entries;
+  if (!readAt(&file, entries_lba * found_sector_size,
+              entry_count * entry_size, &entries) ||
+      gptCrc32(entries.constData(), entries.size()) != le32(header, 88)) {
+    LOG_WARNING << image_path << " has a damaged GPT entry array";
+    return false;
+  }
+
+  std::vector<PartitionExtent> found;
+  for (uint64_t i = 0; i < entry_count; i++) {
+    const uint64_t at = i * entry_size;
+    const QUuid type = gptGuid(entries, at);
+    if (type.isNull()) {
+      continue;
+    }
+    PartitionExtent extent;
+    extent.first_lba = le64(entries, at + 32);
+    extent.last_lba = le64(entries, at + 40);
+    extent.type = partitionType(type);
+    found.push_back(extent);
+  }
+  *sector_size = found_sector_size;
+  partitions->insert(partitions->end(), found.begin(), found.end());
+  return true;
+}
+
+Option<BlockMap> AnalyzeImage(const QString& image_path,
+                              const uint64_t image_size,
+                              const uint32_t sector_size,
+                              const std::vector<PartitionExtent>& partitions,
+                              const std::atomic<bool>* cancel) {
+  if (partitions.empty() || sector_size == 0 ||
+      map_block_size % sector_size != 0) {
+    return nullopt;
+  }
+  QFile file(image_path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG_WARNING << "can't open " << image_path << ": " << file.errorString();
+    return nullopt;
+  }
+
+  std::vector<Extent> used;
+  uint64_t lowest = image_size;
+  uint64_t highest = 0;
+  for (const auto& partition : partitions) {
+    const uint64_t start = partition.first_lba * sector_size;
+    const uint64_t end =
+        std::min(image_size, (partition.last_lba + 1) * sector_size);
+    if (partition.last_lba < partition.first_lba || start >= end) {
+      continue;
+    }
+    lowest = std::min(lowest, start);
+    highest = std::max(highest, end);
+    if (!isDataPartition(partition.type) ||
+        !extUsedExtents(&file, start, end - start, cancel, &used)) {
+      used.emplace_back(start, end);
+    }
+  }
+  if (cancel && *cancel) {
+    return nullopt;
+  }
+  if (lowest >= highest) {
+    return nullopt;
+  }
+  // The protective MBR and primary GPT come before the partitions, the
+  // backup GPT after them
+  used.emplace_back(0, lowest);
+  used.emplace_back(highest, image_size);
+
+  // Round out to whole map blocks, merging as we go
+  std::sort(used.begin(), used.end());
+  std::vector<BlockMap::Range> ranges;
+  for (const auto& extent : used) {
+    if (extent.first >= extent.second) {
+      continue;
+    }
+    const uint64_t first = extent.first / map_block_size;
+    const uint64_t last = (extent.second - 1) / map_block_size;
+    if (!ranges.empty() && first <= ranges.back().last + 1) {
+      ranges.back().last = std::max(ranges.back().last, last);
+      continue;
+    }
+    BlockMap::Range range;
+    range.first = first;
+    range.last = last;
+    ranges.push_back(range);
+  }
+
+  auto map = BlockMap::fromRanges(image_size, map_block_size,
+                                  std::move(ranges));
+  if (map.mappedBytes() >= image_size) {
+    return nullopt;
+  }
+  LOG_INFO << image_path << ": " << map.mappedBytes() << " of "
+           << image_size << " bytes in use";
+  return map;
+}
+
+}  // namespace gondar
@@ -0,0 +1,63 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_IMAGE_ANALYZER_H_
+#define SRC_IMAGE_ANALYZER_H_
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "block_map.h"
+#include "option.h"
+
+namespace gondar {
+
+// One entry of a disk image's partition table
+struct PartitionExtent {
+  // Inclusive, in sectors
+  uint64_t first_lba = 0;
+  uint64_t last_lba = 0;
+  // gdisk's hex code for the partition type, e.g. 0x8300, or 0 for a
+  // type this doesn't know
+  uint16_t type = 0;
+};
+
+// Read the GPT of the disk image at |image_path| without gdisk, so it
+// works on every platform. Fails unless the primary header and entry
+// array are intact.
+bool ReadImagePartitions(const QString& image_path,
+                         uint32_t* sector_size,
+                         std::vector<PartitionExtent>* partitions);
+
+// Work out which parts of the GPT disk image at |image_path| hold data,
+// given its |partitions|. Space outside every partition is unused, as
+// are the free blocks of ext2/3/4 filesystems in Linux and basic data
+// partitions. ChromeOS kernel and root partitions are always kept
+// whole, since dm-verity covers their free blocks too. Anything that
+// can't be parsed is treated as used.
+//
+// Returns a map without checksums, or nothing if there is nothing to
+// skip or |cancel| is set.
+Option<BlockMap> AnalyzeImage(const QString& image_path,
+                              uint64_t image_size,
+                              uint32_t sector_size,
+                              const std::vector<PartitionExtent>& partitions,
+                              const std::atomic<bool>* cancel = nullptr);
+
+}  // namespace gondar
+
+#endif  // SRC_IMAGE_ANALYZER_H_
@@ -0,0 +1,217 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_fetcher.h"
+
+#include "gondarwizard.h"
+#include "log.h"
+
+namespace gondar {
+
+ImageFetcher::ImageFetcher() {}
+
+ImageFetcher::~ImageFetcher() {
+  cancel();
+}
+
+void ImageFetcher::setWizard(GondarWizard* wizard) {
+  wizard_ = wizard;
+}
+
+void ImageFetcher::start(const QList<QUrl>& mirrors) {
+  const QUrl& url = mirrors.first();
+  if (url == url_ && state_ != State::Idle && state_ != State::Failed) {
+    return;
+  }
+  cancel();
+
+  url_ = url;
+  if (url.isLocalFile()) {
+    startLocal(url.toLocalFile());
+    return;
+  }
+
+  LOG_INFO << "fetching " << url;
+  state_ = State::Downloading;
+  if (wizard_) {
+    wizard_->timings.start(RunTimings::Span::Download);
+  }
+  download_ = std::make_unique<DownloadManager>();
+  download_->setWizard(wizard_);
+  connect(download_.get(), &DownloadManager::downloadProgress, this,
+          [this](const qint64 received, const qint64 total) {
+            bytes_received_ = received;
+            bytes_total_ = total;
+            emit downloadProgress(received, total);
+          });
+  connect(download_.get(), &DownloadManager::finished, this,
+          &ImageFetcher::onDownloadFinished);
+  download_->appendMirrors(mirrors);
+}
+
+void ImageFetcher::cancel() {
+  if (state_ == State::Downloading || state_ == State::Verifying ||
+      state_ == State::Extracting) {
+    LOG_INFO << "cancelling fetch of " << url_;
+  }
+  if (download_) {
+    // nothing more is wanted from it, including the finished() that
+    // cancel() emits
+    disconnect(download_.get(), nullptr, this, nullptr);
+    download_->cancel();
+    download_.release()->deleteLater();
+  }
+  // waits for the hashing to stop
+  check_.reset();
+  if (unzip_) {
+    // waits for the extraction to stop
+    disconnect(unzip_.get(), nullptr, this, nullptr);
+    unzip_.reset();
+  }
+  state_ = State::Idle;
+  url_ = QUrl();
+  bytes_received_ = 0;
+  bytes_total_ = 0;
+  image_file_name_.clear();
+  error_.clear();
+}
+
+ImageFetcher::State ImageFetcher::state() const {
+  return state_;
+}
+
+qint64 ImageFetcher::bytesReceived() const {
+  return bytes_received_;
+}
+
+qint64 ImageFetcher::bytesTotal() const {
+  return bytes_total_;
+}
+
+const QString& ImageFetcher::imageFileName() const {
+  return image_file_name_;
+}
+
+const QString& ImageFetcher::errorString() const {
+  return error_;
+}
+
+void ImageFetcher::startLocal(const QString& path) {
+  LOG_INFO << "using local image " << path;
+  if (!QFileInfo(path).isFile()) {
+    fail("The image file " + path + " could not be found.");
+    return;
+  }
+  state_ = State::Verifying;
+  emit verifying();
+  if (wizard_) {
+    wizard_->timings.start(RunTimings::Span::Verify);
+  }
+  check_ = std::make_unique<SidecarCheck>();
+  connect(check_.get(), &SidecarCheck::finished, this,
+          [this, path](const SidecarCheck::Result result) {
+            check_.release()->deleteLater();
+            onLocalChecked(path, result);
+          });
+  check_->start(path);
+}
+
+void ImageFetcher::onLocalChecked(const QString& path,
+                                  const SidecarCheck::Result result) {
+  if (wizard_) {
+    // without a sidecar nothing was hashed
+    const bool hashed = result == SidecarCheck::Result::Verified ||
+                        result == SidecarCheck::Result::Mismatch;
+    wizard_->timings.finish(RunTimings::Span::Verify,
+                            hashed ? QFileInfo(path).size() : 0);
+  }
+  if (result == SidecarCheck::Result::Mismatch) {
+    fail("The image file " + path +
+         " does not match its .sha256 file. It may be damaged or "
+         "incomplete.");
+    return;
+  }
+  if (result == SidecarCheck::Result::Unreadable) {
+    fail("The image file " + path + " could not be read.");
+    return;
+  }
+
+  const QFileInfo info(path);
+  if (info.suffix().compare("zip", Qt::CaseInsensitive) == 0) {
+    startUnzip(info);
+    return;
+  }
+  // a raw image goes straight to the writer
+  image_file_name_ = info.absoluteFilePath();
+  state_ = State::Done;
+  emit done();
+}
+
+void ImageFetcher::fail(const QString& error) {
+  LOG_ERROR << error;
+  error_ = error;
+  state_ = State::Failed;
+  emit failed();
+}
+
+void ImageFetcher::onDownloadFinished() {
+  if (download_->hasError()) {
+    state_ = State::Failed;
+    emit failed();
+    return;
+  }
+
+  const QFileInfo zipfile = download_->outputFileInfo();
+  if (wizard_) {
+    wizard_->timings.finish(RunTimings::Span::Download, zipfile.size());
+  }
+  startUnzip(zipfile);
+}
+
+void ImageFetcher::startUnzip(const QFileInfo& zipfile) {
+  if (wizard_) {
+    wizard_->timings.start(RunTimings::Span::Unzip);
+  }
+  state_ = State::Extracting;
+  emit extracting();
+  unzip_ = std::make_unique<UnzipThread>(zipfile);
+  const int generation = ++unzip_generation_;
+  connect(unzip_.get(), &UnzipThread::finished, this,
+          [this, generation]() { onUnzipFinished(generation); });
+  unzip_->start();
+}
+
+void ImageFetcher::onUnzipFinished(const int generation) {
+  // a queued finished() can outlive a cancelled extraction, even once
+  // another has started in its place
+  if (generation != unzip_generation_ || state_ != State::Extracting ||
+      !unzip_) {
+    return;
+  }
+  image_file_name_ = unzip_->getFileName();
+  if (image_file_name_.isEmpty()) {
+    state_ = State::Failed;
+    emit failed();
+    return;
+  }
+  if (wizard_) {
+    wizard_->timings.finish(RunTimings::Span::Unzip,
+                            QFileInfo(image_file_name_).size());
+  }
+  state_ = State::Done;
+  emit done();
+}
+
+}  // namespace gondar
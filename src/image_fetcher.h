@@ -0,0 +1,109 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_IMAGE_FETCHER_H_
+#define SRC_IMAGE_FETCHER_H_
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <memory>
+
+#include "downloader.h"
+#include "sidecar_check.h"
+#include "unzipthread.h"
+
+class GondarWizard;
+
+namespace gondar {
+
+// Downloads and extracts the chosen image. The wizard starts this as
+// soon as it knows the image URL, so the work overlaps with the user
+// picking a USB device; DownloadProgressPage then picks up wherever the
+// fetch has got to.
+//
+// A file:// URL names an image already on disk or on a mounted share.
+// Nothing is downloaded: the file is checked against its .sha256
+// sidecar if it has one, then a .zip is extracted and a raw .bin is
+// handed to the writer as is.
+class ImageFetcher : public QObject {
+  Q_OBJECT
+
+ public:
+  enum class State {
+    Idle,
+    Downloading,
+    Verifying,
+    Extracting,
+    Done,
+    Failed,
+  };
+
+  ImageFetcher();
+  ~ImageFetcher();
+
+  // for timings and metrics
+  void setWizard(GondarWizard* wizard);
+
+  // Start fetching the image from the fastest of |mirrors|, the first
+  // of which identifies it. Does nothing if that image is already being
+  // fetched or has been; a fetch of any other image is cancelled first.
+  void start(const QList<QUrl>& mirrors);
+  // Stop and forget the current fetch
+  void cancel();
+
+  State state() const;
+  qint64 bytesReceived() const;
+  qint64 bytesTotal() const;
+  // The extracted image, once the state is Done
+  const QString& imageFileName() const;
+  // Why a local image was rejected; empty for download failures
+  const QString& errorString() const;
+
+ signals:
+  void downloadProgress(qint64 received, qint64 total);
+  void verifying();
+  void extracting();
+  void done();
+  void failed();
+
+ private:
+  void startLocal(const QString& path);
+  void onLocalChecked(const QString& path, SidecarCheck::Result result);
+  void onDownloadFinished();
+  void startUnzip(const QFileInfo& zipfile);
+  // |generation| is that of the extraction that finished
+  void onUnzipFinished(int generation);
+  void fail(const QString& error);
+
+  GondarWizard* wizard_ = nullptr;
+  State state_ = State::Idle;
+  QUrl url_;
+  qint64 bytes_received_ = 0;
+  qint64 bytes_total_ = 0;
+  QString image_file_name_;
+  QString error_;
+  std::unique_ptr<DownloadManager> download_;
+  std::unique_ptr<SidecarCheck> check_;
+  std::unique_ptr<UnzipThread> unzip_;
+  // Bumped for every extraction, so that a finished() queued by one
+  // that has since been replaced is recognised
+  int unzip_generation_ = 0;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_IMAGE_FETCHER_H_
@@ -0,0 +1,288 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_prep.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "zip.h"
+
+#ifdef _WIN32
+#define USEWIN32IOAPI
+#include "iowin32.h"
+#endif
+
+#include "block_map.h"
+#include "chunked_image.h"
+#include "image_analyzer.h"
+#include "log.h"
+#include "neverware_unzipper.h"
+#include "sidecar_check.h"
+#include "trace.h"
+
+namespace gondar {
+
+namespace {
+
+// Same granularity AnalyzeImage uses
+const uint32_t default_block_size = 4096;
+
+const qint64 read_size = 1024 * 1024;
+
+// The ranges of the image that are in use, without checksums. Without
+// a GPT to go on, that's all of it.
+BlockMap usedRanges(const QString& image_path, const uint64_t image_size) {
+  uint32_t sector_size = 0;
+  std::vector<PartitionExtent> partitions;
+  if (ReadImagePartitions(image_path, &sector_size, &partitions)) {
+    auto analyzed =
+        AnalyzeImage(image_path, image_size, sector_size, partitions);
+    if (analyzed) {
+      return *analyzed;
+    }
+  } else {
+    LOG_WARNING << "no usable GPT in " << image_path
+                << ", mapping the whole image";
+  }
+
+  std::vector<BlockMap::Range> ranges;
+  if (image_size > 0) {
+    BlockMap::Range all;
+    all.last = (image_size - 1) / default_block_size;
+    ranges.push_back(all);
+  }
+  return BlockMap::fromRanges(image_size, default_block_size, ranges);
+}
+
+// Hashes each range of a map as the image streams past
+class RangeHasher {
+ public:
+  explicit RangeHasher(const BlockMap& map)
+      : map_(map), ranges_(map.ranges()) {}
+
+  // |data| is the image's bytes at |offset|; calls must cover the
+  // image in order
+  void addData(uint64_t offset, const QByteArray& data) {
+    uint64_t used = 0;
+    const uint64_t size = static_cast<uint64_t>(data.size());
+    while (next_ < ranges_.size() && used < size) {
+      const uint64_t start = map_.rangeStart(ranges_[next_]);
+      const uint64_t end = map_.rangeEnd(ranges_[next_]);
+      if (offset + (size - used) <= start) {
+        return;
+      }
+      if (offset < start) {
+        used += start - offset;
+        offset = start;
+      }
+      const uint64_t take = std::min(end - offset, size - used);
+      hash_.addData(data.constData() + used, static_cast<int>(take));
+      used += take;
+      offset += take;
+      if (offset == end) {
+        ranges_[next_].checksum = hash_.result().toHex();
+        hash_.reset();
+        next_++;
+      }
+    }
+  }
+
+  // The map with every range's checksum, once the whole image has
+  // been seen
+  BlockMap result() const {
+    return BlockMap::fromRanges(map_.imageSize(), map_.blockSize(),
+                                ranges_);
+  }
+
+ private:
+  const BlockMap& map_;
+  std::vector<BlockMap::Range> ranges_;
+  size_t next_ = 0;
+  QCryptographicHash hash_{QCryptographicHash::Sha256};
+};
+
+class ZipWriter {
+  ZipWriter& operator=(ZipWriter&) = delete;
+  ZipWriter(ZipWriter&) = delete;
+
+ public:
+  explicit ZipWriter(const QString& path) {
+    const std::string path_str = path.toStdString();
+#ifdef USEWIN32IOAPI
+    zlib_filefunc64_def ffunc;
+    fill_win32_filefunc64A(&ffunc);
+    file_ = zipOpen2_64(path_str.c_str(), APPEND_STATUS_CREATE, nullptr,
+                        &ffunc);
+#else
+    file_ = zipOpen64(path_str.c_str(), APPEND_STATUS_CREATE);
+#endif
+    if (!file_) {
+      throw std::runtime_error("can't create " + path_str);
+    }
+  }
+
+  ~ZipWriter() {
+    if (file_) {
+      zipClose(file_, nullptr);
+    }
+  }
+
+  void openEntry(const QString& name) {
+    zip_fileinfo info = {};
+    const auto rc = zipOpenNewFileInZip64(
+        file_, name.toStdString().c_str(), &info, nullptr, 0, nullptr, 0,
+        nullptr, Z_DEFLATED, Z_DEFAULT_COMPRESSION, 1);
+    if (rc != ZIP_OK) {
+      LOG_ERROR << "zipOpenNewFileInZip64 failed: " << rc;
+      throw std::runtime_error("can't add " + name.toStdString());
+    }
+  }
+
+  void write(const QByteArray& data) {
+    const auto rc = zipWriteInFileInZip(file_, data.constData(),
+                                        static_cast<unsigned>(data.size()));
+    if (rc != ZIP_OK) {
+      LOG_ERROR << "zipWriteInFileInZip failed: " << rc;
+      throw std::runtime_error("compression failed");
+    }
+  }
+
+  void closeEntry() {
+    const auto rc = zipCloseFileInZip(file_);
+    if (rc != ZIP_OK) {
+      LOG_ERROR << "zipCloseFileInZip failed: " << rc;
+      throw std::runtime_error("compression failed");
+    }
+  }
+
+  void close() {
+    const auto rc = zipClose(file_, nullptr);
+    file_ = nullptr;
+    if (rc != ZIP_OK) {
+      LOG_ERROR << "zipClose failed: " << rc;
+      throw std::runtime_error("compression failed");
+    }
+  }
+
+ private:
+  zipFile file_ = nullptr;
+};
+
+bool writeFile(const QString& path, const QByteArray& data) {
+  QFile file(path);
+  return file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+         file.write(data) == data.size();
+}
+
+}  // namespace
+
+bool PrepareImage(const QString& input,
+                  const QString& output_dir,
+                  const uint64_t chunk_size,
+                  ImagePrepResult* result,
+                  QString* error) {
+  if (chunk_size == 0) {
+    *error = "the chunk size must not be zero";
+    return false;
+  }
+
+  QString image_path = input;
+  if (input.endsWith(".zip", Qt::CaseInsensitive)) {
+    TraceScope trace("prep", "unzip");
+    try {
+      image_path = neverware_unzip(QFileInfo(input)).absoluteFilePath();
+    } catch (const std::exception& exc) {
+      *error = "can't extract " + input + ": " + exc.what();
+      return false;
+    }
+  }
+
+  QFile image(image_path);
+  if (!image.open(QIODevice::ReadOnly)) {
+    *error = "can't open " + image_path + ": " + image.errorString();
+    return false;
+  }
+  const uint64_t image_size = static_cast<uint64_t>(image.size());
+  const QString name = QFileInfo(image_path).fileName();
+  const QDir dir(output_dir);
+  result->archive_path = dir.filePath(name + ".chunks.zip");
+  result->manifest_path = dir.filePath(name + ".chunks");
+  result->block_map_path = dir.filePath(name + ".bmap");
+  result->sidecar_path = Sha256SidecarPath(dir.filePath(name));
+  result->image_size = image_size;
+
+  const BlockMap used = usedRanges(image_path, image_size);
+  RangeHasher range_hasher(used);
+  QCryptographicHash image_hash(QCryptographicHash::Sha256);
+  ChunkManifest manifest;
+  manifest.image_name = name;
+  manifest.image_size = image_size;
+  manifest.chunk_size = chunk_size;
+
+  try {
+    ZipWriter zip(result->archive_path);
+    for (uint64_t offset = 0; offset < image_size; offset += chunk_size) {
+      TraceScope trace("prep", "chunk");
+      zip.openEntry(ChunkEntryName(manifest.chunkCount()));
+      QCryptographicHash chunk_hash(QCryptographicHash::Sha256);
+      const uint64_t chunk_end = std::min(image_size, offset + chunk_size);
+      for (uint64_t pos = offset; pos < chunk_end;) {
+        const QByteArray data = image.read(
+            std::min<qint64>(read_size, static_cast<qint64>(chunk_end - pos)));
+        if (data.isEmpty()) {
+          throw std::runtime_error("can't read " + image_path.toStdString() +
+                                   ": " + image.errorString().toStdString());
+        }
+        chunk_hash.addData(data);
+        image_hash.addData(data);
+        range_hasher.addData(pos, data);
+        zip.write(data);
+        pos += static_cast<uint64_t>(data.size());
+      }
+      zip.closeEntry();
+      manifest.chunk_sha256.push_back(chunk_hash.result().toHex());
+    }
+    zip.openEntry(chunk_manifest_entry);
+    zip.write(manifest.serialize());
+    zip.closeEntry();
+    zip.close();
+  } catch (const std::exception& exc) {
+    QFile::remove(result->archive_path);
+    *error = exc.what();
+    return false;
+  }
+
+  const BlockMap block_map = range_hasher.result();
+  result->mapped_bytes = block_map.mappedBytes();
+  if (!writeFile(result->manifest_path, manifest.serialize()) ||
+      !writeFile(result->block_map_path, block_map.toXml()) ||
+      !WriteSha256Sidecar(dir.filePath(name), image_hash.result().toHex())) {
+    *error = "can't write to " + output_dir;
+    return false;
+  }
+  LOG_INFO << "prepared " << image_path << ": " << manifest.chunkCount()
+           << " chunks, " << result->mapped_bytes << " of " << image_size
+           << " bytes mapped";
+  return true;
+}
+
+}  // namespace gondar
@@ -0,0 +1,49 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_IMAGE_PREP_H_
+#define SRC_IMAGE_PREP_H_
+
+#include <QString>
+#include <cstdint>
+
+namespace gondar {
+
+struct ImagePrepResult {
+  // Chunked image archive, see chunked_image.h
+  QString archive_path;
+  // The archive's manifest on its own
+  QString manifest_path;
+  // bmap of the ranges in use, found by BlockMap::findFor
+  QString block_map_path;
+  // SHA-256 sidecar of the raw image
+  QString sidecar_path;
+  uint64_t image_size = 0;
+  uint64_t mapped_bytes = 0;
+};
+
+// Turn the raw image at |input|, or a release .zip holding one, into
+// the artifacts stations can use to write it quickly. They are named
+// after the raw image and written to |output_dir|. A .zip is extracted
+// next to itself first. Returns false with |error| set on failure.
+bool PrepareImage(const QString& input,
+                  const QString& output_dir,
+                  uint64_t chunk_size,
+                  ImagePrepResult* result,
+                  QString* error);
+
+}  // namespace gondar
+
+#endif  // SRC_IMAGE_PREP_H_
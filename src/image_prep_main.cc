@@ -0,0 +1,106 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Release tool: run once per image so every station can download it
+// as a chunked archive, skip the unused parts of it while writing and
+// check each chunk as it arrives.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <cstdio>
+
+#include "image_prep.h"
+#include "log.h"
+#include "trace.h"
+
+namespace {
+
+const int default_chunk_size_mib = 16;
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gondar::InitializeLogging(false);
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("thoriumos-image-prep");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Turn a ThoriumOS image into a chunked archive, a block map of the "
+      "ranges in use, a per-chunk hash manifest and a SHA-256 sidecar.");
+  parser.addHelpOption();
+  parser.addPositionalArgument(
+      "image", "Raw .bin image, or the release .zip holding one.");
+  const QCommandLineOption output_option(
+      "output-dir", "Where to write the results (default: next to the image).",
+      "dir");
+  const QCommandLineOption chunk_option(
+      "chunk-size",
+      QString("Uncompressed size of each chunk in MiB (default %1).")
+          .arg(default_chunk_size_mib),
+      "mib", QString::number(default_chunk_size_mib));
+  const QCommandLineOption trace_option(
+      "trace",
+      "Record a Chrome trace-event file of the run, for chrome://tracing "
+      "or Perfetto.",
+      "file");
+  parser.addOption(output_option);
+  parser.addOption(chunk_option);
+  parser.addOption(trace_option);
+  parser.process(app);
+
+  const QStringList args = parser.positionalArguments();
+  if (args.size() != 1) {
+    fprintf(stderr, "exactly one image is required\n");
+    return 1;
+  }
+  bool ok = false;
+  const uint64_t chunk_mib = parser.value(chunk_option).toULongLong(&ok);
+  if (!ok || chunk_mib == 0) {
+    fprintf(stderr, "invalid chunk size: %s\n",
+            qPrintable(parser.value(chunk_option)));
+    return 1;
+  }
+  const QString input = args[0];
+  const QString output_dir = parser.isSet(output_option)
+                                 ? parser.value(output_option)
+                                 : QFileInfo(input).absolutePath();
+
+  if (parser.isSet(trace_option)) {
+    gondar::Trace::start(parser.value(trace_option));
+  } else {
+    gondar::Trace::startFromEnvironment();
+  }
+
+  gondar::ImagePrepResult result;
+  QString error;
+  const bool success = gondar::PrepareImage(
+      input, output_dir, chunk_mib * 1024 * 1024, &result, &error);
+  gondar::Trace::stop();
+  if (!success) {
+    LOG_ERROR << "image prep failed: " << error;
+    fprintf(stderr, "%s\n", qPrintable(error));
+    return 1;
+  }
+
+  printf("%s\n%s\n%s\n%s\n", qPrintable(result.archive_path),
+         qPrintable(result.manifest_path), qPrintable(result.block_map_path),
+         qPrintable(result.sidecar_path));
+  printf("%llu of %llu bytes in use\n",
+         static_cast<unsigned long long>(result.mapped_bytes),
+         static_cast<unsigned long long>(result.image_size));
+  return 0;
+}
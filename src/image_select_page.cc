@@ -23,27 +23,33 @@
 #include "log.h"
 #include "util.h"
 
-class DownloadButton : public QRadioButton {
- public:
-  explicit DownloadButton(QUrl& url_in) : url(url_in) {}
-  QUrl getUrl() const { return url; }
-
- private:
-  QUrl url;
-};
-
 ImageSelectPage::ImageSelectPage(QWidget* parent) : WizardPage(parent) {
   setTitle("Which version of ThoriumOS do you need?");
   setSubTitle(" ");
   setLayout(&layout);
+
+  findLabel.setText("Search:");
+  findLayout.addWidget(&findLabel);
+  findLayout.addWidget(&findEdit);
+  layout.addLayout(&findLayout);
+
+  filterModel.setSourceModel(&imagesModel);
+  imagesView.setModel(&filterModel);
+  imagesView.setUniformItemSizes(true);
+  layout.addWidget(&imagesView);
+
+  connect(&findEdit, &QLineEdit::textChanged, &filterModel,
+          &gondar::SearchFilterModel::setQuery);
 }
 
 bool ImageSelectPage::validatePage() {
   // currently this is only a concern in the chromeover case, but we would
   // be equally worried were this true in either case
-  if (!bitnessButtons.checkedButton()) {
+  if (selectedRow() == -1) {
     return false;
   }
+  // start downloading while the user inserts and picks a USB device
+  wizard()->imageFetcher.start(getMirrors());
   return true;
 }
 
@@ -52,31 +58,39 @@ int ImageSelectPage::nextId() const {
 }
 
 void ImageSelectPage::addImage(GondarImage image) {
-  // do not list deployable images
-  if (image.isDeployable()) {
-    return;
-  }
-  DownloadButton* newButton = new DownloadButton(image.url);
-  newButton->setText(image.getCompositeName());
-  bitnessButtons.addButton(newButton);
-  layout.addWidget(newButton);
+  addImages({image});
 }
 
 void ImageSelectPage::addImages(QList<GondarImage> images) {
-  for (const auto& curImage : images) {
-    addImage(curImage);
-  }
+  // deployable images are filtered out by the model
+  imagesModel.addImages(images);
 }
 
 // this is what is used later in the wizard to find what url should be used
 QUrl ImageSelectPage::getUrl() {
-  QAbstractButton* selected = bitnessButtons.checkedButton();
-  if (gondar::isChromeover()) {
-    // for chromeover, use the download button's url attribute
-    DownloadButton* selected_download_button =
-        dynamic_cast<DownloadButton*>(selected);
-    return selected_download_button->getUrl();
+  if (!wizard()->localImage().isEmpty()) {
+    return QUrl::fromLocalFile(wizard()->localImage());
+  } else if (gondar::isChromeover()) {
+    // for chromeover, use the selected image's url
+    return imagesModel.image(selectedRow()).url;
   } else {
     return wizard()->newestImageUrl.get64Url();
   }
 }
+
+QList<QUrl> ImageSelectPage::getMirrors() {
+  if (gondar::isChromeover() || !wizard()->localImage().isEmpty()) {
+    return {getUrl()};
+  } else {
+    return wizard()->newestImageUrl.get64Mirrors();
+  }
+}
+
+int ImageSelectPage::selectedRow() const {
+  // an image hidden by the search is no longer selected
+  const auto selected = imagesView.selectionModel()->selectedIndexes();
+  if (selected.isEmpty()) {
+    return -1;
+  }
+  return filterModel.mapToSource(selected.first()).row();
+}
@@ -16,13 +16,17 @@
 #ifndef SRC_IMAGE_SELECT_PAGE_H_
 #define SRC_IMAGE_SELECT_PAGE_H_
 
-#include <QButtonGroup>
+#include <QHBoxLayout>
 #include <QLabel>
+#include <QLineEdit>
+#include <QListView>
 #include <QRadioButton>
 #include <QUrl>
 #include <QVBoxLayout>
 
 #include "gondarimage.h"
+#include "picker_models.h"
+#include "search_filter_model.h"
 #include "wizard_page.h"
 
 class ImageSelectPage : public gondar::WizardPage {
@@ -34,12 +38,22 @@ class ImageSelectPage : public gondar::WizardPage {
   void addImage(GondarImage image);
   void addImages(QList<GondarImage> images);
   QUrl getUrl();
+  // Every URL the selected image can be downloaded from
+  QList<QUrl> getMirrors();
 
  protected:
   bool validatePage() override;
 
  private:
-  QButtonGroup bitnessButtons;
+  // Get the selected image's row in |imagesModel|, or -1
+  int selectedRow() const;
+
+  QHBoxLayout findLayout;
+  QLabel findLabel;
+  QLineEdit findEdit;
+  gondar::ImageListModel imagesModel;
+  gondar::SearchFilterModel filterModel;
+  QListView imagesView;
   QRadioButton sixtyFour;
   QLabel sixtyFourDetails;
   QVBoxLayout layout;
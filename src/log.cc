@@ -15,12 +15,14 @@
 
 #include "log.h"
 
-#include <plog/Appenders/ConsoleAppender.h>
-
 #include <QDir>
 #include <QStandardPaths>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <exception>
 
+#include "async_log_appender.h"
 #include "device.h"
 
 namespace plog {
@@ -65,9 +67,29 @@ std::string CreateLogPath() {
   return path.toStdString();
 }
 
+AsyncLogAppender* async_log = nullptr;
+
+// Get whatever is still queued onto disk before the process dies.
+// Only async-signal-safe calls are allowed here, so this can't use
+// flush().
+void flushOnSignal(const int sig) {
+  if (async_log) {
+    async_log->flushFromSignal();
+  }
+  std::signal(sig, SIG_DFL);
+  std::raise(sig);
+}
+
+void flushOnTerminate() {
+  if (async_log) {
+    async_log->flush(false);
+  }
+  std::abort();
+}
+
 }  // namespace
 
-void InitializeLogging() {
+void InitializeLogging(const bool log_to_console) {
   const plog::Severity max_severity = plog::debug;
   const std::string path = CreateLogPath();
   const size_t max_file_size = 5 * 1024 * 1024;  // 5 MiB
@@ -75,12 +97,18 @@ void InitializeLogging() {
 
   fprintf(stderr, "initializing log: %s\n", path.c_str());
 
-  // Log to both log files and to the console (if present)
-  static plog::RollingFileAppender<plog::TxtFormatter> file_log(
-      path.c_str(), max_file_size, max_files);
-  static plog::ConsoleAppender<plog::TxtFormatter> console_log;
+  // Log to both log files and to the console (if present). The writes
+  // happen on a background thread so that logging is cheap enough for
+  // hot paths; the appender's destructor writes out the rest at exit.
+  static AsyncLogAppender appender(QString::fromStdString(path),
+                                   max_file_size, max_files, log_to_console);
+  async_log = &appender;
+  plog::init(max_severity, &appender);
 
-  plog::init(max_severity, &file_log).addAppender(&console_log);
+  for (const int sig : {SIGABRT, SIGFPE, SIGILL, SIGSEGV}) {
+    std::signal(sig, flushOnSignal);
+  }
+  std::set_terminate(flushOnTerminate);
 
   LOG_INFO << "log initialized";
 }
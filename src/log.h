@@ -32,7 +32,11 @@ void operator<<(util::nstringstream& stream, const QUrl& url);
 
 namespace gondar {
 
-void InitializeLogging();
+// Set up the rolling log file. Console logging goes to stdout, so
+// callers that use stdout for their own output can turn it off. Log
+// calls only format the message; the I/O happens on a background
+// thread.
+void InitializeLogging(bool log_to_console = true);
 
 }  // namespace gondar
 
@@ -24,6 +24,9 @@
 #include "gondarwizard.h"
 #include "log.h"
 #include "metric.h"
+#include "metrics_queue.h"
+#include "peer_cache.h"
+#include "trace.h"
 #include "util.h"
 
 int main(int argc, char* argv[]) {
@@ -32,6 +35,7 @@ int main(int argc, char* argv[]) {
 #endif
   Q_INIT_RESOURCE(gondarwizard);
   gondar::InitializeLogging();
+  gondar::Trace::startFromEnvironment();
   gondar::SendMetricGondar(gondar::Metric::Use);
 #if defined(Q_OS_WIN)
   // dismiss Windows 'format disk' popups
@@ -40,12 +44,20 @@ int main(int argc, char* argv[]) {
 #endif
   QApplication app(argc, argv);
   app.setStyleSheet(gondar::readUtf8File(":/style.css"));
+  gondar::MetricsQueue::instance()->start();
+  // opt-in, since it serves downloads to the whole LAN
+  if (!qgetenv("THORIUMOS_USB_MAKER_PEER_CACHE").isEmpty()) {
+    gondar::PeerCache::instance()->start();
+  }
 
   GondarWizard wizard;
   wizard.show();
 
   const auto ret = app.exec();
   LOG_INFO << "app.exec() returned " << ret;
+  gondar::PeerCache::instance()->stop();
+  gondar::MetricsQueue::instance()->shutdown();
+  gondar::Trace::stop();
   CleanUp();
   return ret;
 }
@@ -20,11 +20,14 @@
 #include <QJsonObject>
 #include <QNetworkRequest>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QUrlQuery>
+#include <algorithm>
 
 #include "config.h"
 #include "gondarsite.h"
+#include "http_client.h"
 #include "log.h"
 #include "metric.h"
 #include "util.h"
@@ -37,6 +40,10 @@ const char path_google_auth[] = "/google-auth";
 const char path_sites[] = "/sites";
 const char path_downloads[] = "/downloads";
 
+// Site and download requests outstanding at once. This matches the
+// number of connections QNetworkAccessManager opens to one host.
+const int max_in_flight = 6;
+
 QUrl createUrl(const QString& path) {
   return QUrl("https://api." + gondar::getDomain() + "/poof" + path);
 }
@@ -72,14 +79,14 @@ int siteIdFromUrl(const QUrl& url) {
 
 QNetworkRequest createAuthRequest() {
   auto url = createUrl(path_auth);
-  QNetworkRequest request(url);
+  auto request = gondar::CreateRequest(url);
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
   return request;
 }
 
 QNetworkRequest createGoogleAuthRequest() {
   auto url = createUrl(path_google_auth);
-  QNetworkRequest request(url);
+  auto request = gondar::CreateRequest(url);
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
   return request;
 }
@@ -90,7 +97,7 @@ QNetworkRequest createSitesRequest(const QString& api_token, int page) {
   query.addQueryItem("token", api_token);
   query.addQueryItem("page", QString::number(page));
   url.setQuery(query);
-  return QNetworkRequest(url);
+  return gondar::CreateRequest(url);
 }
 
 QNetworkRequest createDownloadsRequest(const QString& api_token,
@@ -101,7 +108,7 @@ QNetworkRequest createDownloadsRequest(const QString& api_token,
   QUrlQuery query;
   query.addQueryItem("token", api_token);
   url.setQuery(query);
-  QNetworkRequest request(url);
+  auto request = gondar::CreateRequest(url);
   return request;
 }
 
@@ -118,39 +125,66 @@ std::vector<GondarSite> sitesFromReply(const QJsonArray& rawSites) {
   return sites;
 }
 
-// Get the next page from the pagination dict. If on the last page, return 0.
-int getNextPage(const QJsonObject& outer_json) {
+// Get the number of pages from the pagination dict
+int getTotalPages(const QJsonObject& outer_json) {
   const QJsonObject json = outer_json["pagination"].toObject();
-  auto cur = json.value("current").toInt();
-  auto total = json.value("total").toInt();
-  if (cur < total) {
-    return cur + 1;
-  } else {
-    return 0;
+  return std::max(json.value("total").toInt(), 1);
+}
+
+// Get the page number this reply is for
+int getCurrentPage(const QJsonObject& outer_json) {
+  const QJsonObject json = outer_json["pagination"].toObject();
+  return json.value("current").toInt(1);
+}
+
+// Google ID tokens are JWTs; the account's email is in the payload
+QString emailFromIdToken(const QString& id_token) {
+  const QStringList parts = id_token.split('.');
+  if (parts.size() < 2) {
+    return QString();
   }
+  const QByteArray payload = QByteArray::fromBase64(
+      parts[1].toUtf8(), QByteArray::Base64UrlEncoding);
+  return QJsonDocument::fromJson(payload).object()["email"].toString();
 }
 
 }  // namespace
 
 namespace gondar {
 
-Meepo::Meepo() {
+Meepo::Meepo() : cache_(MeepoCache::defaultDir()) {}
+
+void Meepo::watch(QNetworkReply* reply) {
   // All replies are handled by dispatchReply
-  connect(&network_manager_, &QNetworkAccessManager::finished, this,
-          &Meepo::dispatchReply);
+  const int generation = generation_;
+  connect(reply, &QNetworkReply::finished, this,
+          [this, reply, generation]() { dispatchReply(reply, generation); });
 }
 
 void Meepo::clear() {
   api_token_.clear();
-  sites_.clear();
+  clearSites();
+  failed_ = false;
   error_.clear();
-  sites_remaining_ = 0;
+  revalidating_ = false;
+  cache_hits_ = 0;
+  cache_misses_ = 0;
+}
+
+void Meepo::clearSites() {
+  pages_.clear();
+  site_index_.clear();
+  queued_requests_.clear();
+  in_flight_ = 0;
+  pages_remaining_ = 0;
+  generation_++;
 }
 
 void Meepo::start(const QAuthenticator& auth) {
   google_mode_ = false;
   LOG_INFO << "starting meepo flow";
   clear();
+  cache_.setAccount(auth.user());
   requestAuth(auth);
 }
 
@@ -158,6 +192,7 @@ void Meepo::startGoogle(QString id_token) {
   google_mode_ = true;
   LOG_INFO << "starting meepo flow with google";
   clear();
+  cache_.setAccount(emailFromIdToken(id_token));
   requestGoogleAuth(id_token);
 }
 
@@ -175,7 +210,11 @@ QString Meepo::error() const {
 }
 
 Meepo::Sites Meepo::sites() const {
-  return sites_;
+  Sites sites;
+  for (const auto& page : pages_) {
+    sites.insert(sites.end(), page.second.begin(), page.second.end());
+  }
+  return sites;
 }
 
 void Meepo::requestAuth(const QAuthenticator& auth) {
@@ -185,7 +224,8 @@ void Meepo::requestAuth(const QAuthenticator& auth) {
   QJsonDocument doc(json);
   auto request = createAuthRequest();
   LOG_INFO << "POST " << request.url().toString();
-  network_manager_.post(request, doc.toJson(QJsonDocument::Compact));
+  watch(GetNetworkManager()->post(request,
+                                  doc.toJson(QJsonDocument::Compact)));
 }
 
 void Meepo::requestGoogleAuth(QString id_token) {
@@ -195,7 +235,8 @@ void Meepo::requestGoogleAuth(QString id_token) {
   QJsonDocument doc(json);
   auto request = createGoogleAuthRequest();
   LOG_INFO << "POST " << request.url().toString();
-  network_manager_.post(request, doc.toJson(QJsonDocument::Compact));
+  watch(GetNetworkManager()->post(request,
+                                  doc.toJson(QJsonDocument::Compact)));
 }
 
 void Meepo::handleAuthReply(QNetworkReply* reply) {
@@ -207,50 +248,111 @@ void Meepo::handleAuthReply(QNetworkReply* reply) {
   }
 
   LOG_INFO << "token received";
-  // request the first page of sites
+  if (loadCachedSites()) {
+    // let the user carry on with the cached list while it is checked
+    // against the server in the background
+    LOG_INFO << "using " << site_index_.size() << " cached site(s)";
+    revalidating_ = true;
+    emit finished();
+  }
+  clearSites();
+
+  // request the first page of sites; it says how many more there are
+  pages_remaining_ = 1;
   requestSites(1);
 }
 
 void Meepo::requestSites(int page) {
-  const auto request = createSitesRequest(api_token_, page);
-  LOG_INFO << "GET " << request.url().toString();
-  network_manager_.get(request);
+  queued_requests_.push_back(createSitesRequest(api_token_, page));
+  startQueuedRequests();
 }
 
 void Meepo::handleSitesReply(QNetworkReply* reply) {
-  const QJsonObject json = gondar::jsonFromReply(reply);
-  const QJsonArray rawSites = json["sites"].toArray();
-  auto new_sites = sitesFromReply(rawSites);
-  sites_.insert(sites_.end(), new_sites.begin(), new_sites.end());
+  const QJsonObject json = QJsonDocument::fromJson(replyBody(reply)).object();
+  std::vector<int> new_site_ids;
+  const int page = addSitesPage(json, &new_site_ids);
+  pages_remaining_--;
+
+  // the first page tells us how many there are, so fetch the rest of
+  // them all at once rather than one after another
+  if (page == 1) {
+    const int total_pages = getTotalPages(json);
+    for (int next_page = 2; next_page <= total_pages; next_page++) {
+      pages_remaining_++;
+      requestSites(next_page);
+    }
+  }
+
+  for (const int site_id : new_site_ids) {
+    requestDownloads(site_id);
+  }
+
+  LOG_INFO << "received page " << page << " with " << new_site_ids.size()
+           << " new site(s), " << pages_remaining_ << " page(s) to go";
+  maybeFinish();
+}
+
+int Meepo::addSitesPage(const QJsonObject& json,
+                        std::vector<int>* new_site_ids) {
+  const int page = getCurrentPage(json);
+  Sites& sites = pages_[page];
+  for (const auto& site : sitesFromReply(json["sites"].toArray())) {
+    const int site_id = site.getSiteId();
+    // the same site can show up on more than one page if the list
+    // changes while we are paging through it
+    if (site_index_.count(site_id)) {
+      continue;
+    }
+    site_index_[site_id] = std::make_pair(page, sites.size());
+    sites.push_back(site);
+    new_site_ids->push_back(site_id);
+  }
+  return page;
+}
 
-  LOG_INFO << "received " << sites_.size() << " site(s)";
+void Meepo::requestDownloads(const int site_id) {
+  queued_requests_.push_back(createDownloadsRequest(api_token_, site_id));
+  startQueuedRequests();
+}
 
-  // sites starts at zero, and every time we go get another page,
-  // there are more sites remaining to get downloads from
-  sites_remaining_ += sites_.size();
-  LOG_INFO << "sites_remaining increased, now " << sites_remaining_;
+void Meepo::startQueuedRequests() {
+  while (in_flight_ < max_in_flight && !queued_requests_.empty()) {
+    QNetworkRequest request = queued_requests_.front();
+    queued_requests_.pop_front();
+    cache_.addValidators(&request);
+    LOG_INFO << "GET " << request.url().toString();
+    watch(GetNetworkManager()->get(request));
+    in_flight_++;
+  }
+}
 
-  // this logic should still work for the multi-page case
-  if (sites_remaining_ == 0) {
-    fail(no_sites_error);
+void Meepo::maybeFinish() {
+  if (failed_ || pages_remaining_ > 0 || in_flight_ > 0 ||
+      !queued_requests_.empty()) {
     return;
   }
 
-  for (const auto& site : sites_) {
-    requestDownloads(site);
-  }
-  // see if there's another batch
-  int next_page = getNextPage(json);
-  if (next_page > 0) {
-    LOG_INFO << "getting next page of sites, page " << next_page;
-    requestSites(next_page);
+  if (site_index_.empty()) {
+    fail(no_sites_error);
+    return;
   }
-}
 
-void Meepo::requestDownloads(const GondarSite& site) {
-  const auto request = createDownloadsRequest(api_token_, site.getSiteId());
-  LOG_INFO << "GET " << request.url().toString();
-  network_manager_.get(request);
+  LOG_INFO << "received information for all " << site_index_.size()
+           << " site(s); " << cache_hits_ << " cache hit(s), "
+           << cache_misses_ << " miss(es)";
+  SendMetricGondar(Metric::MeepoCache, "", 0,
+                   QJsonObject{{"hits", cache_hits_},
+                               {"misses", cache_misses_},
+                               {"served_cached", revalidating_}});
+  if (revalidating_) {
+    revalidating_ = false;
+    emit sitesUpdated();
+    return;
+  }
+  // we don't want users to be able to pass through the screen by pressing
+  // next while processing.  this will make validatePage pass and immediately
+  // move the user on to the next screen
+  emit finished();
 }
 
 void Meepo::handleDownloadsReply(QNetworkReply* reply) {
@@ -266,7 +368,11 @@ void Meepo::handleDownloadsReply(QNetworkReply* reply) {
     return;
   }
 
-  const auto jsonObj = jsonFromReply(reply);
+  addDownloads(site, QJsonDocument::fromJson(replyBody(reply)).object());
+  maybeFinish();
+}
+
+void Meepo::addDownloads(GondarSite* site, const QJsonObject& jsonObj) {
   QJsonObject productsObj = jsonObj["links"].toObject();
 
   for (const auto& product : productsObj.keys()) {
@@ -279,17 +385,44 @@ void Meepo::handleDownloadsReply(QNetworkReply* reply) {
       site->addImage(gondarImage);
     }
   }
-  sites_remaining_--;
-  LOG_INFO << "processed a site; sites remaining = " << sites_remaining_;
-
-  // see if we're done
-  if (sites_remaining_ == 0) {
-    LOG_INFO << "received information for all outstanding site requests";
-    // we don't want users to be able to pass through the screen by pressing
-    // next while processing.  this will make validatePage pass and immediately
-    // move the user on to the next screen
-    emit finished();
+}
+
+bool Meepo::loadCachedSites() {
+  std::vector<int> site_ids;
+  QByteArray body;
+  if (!cache_.lookup(createSitesRequest(api_token_, 1).url(), &body)) {
+    return false;
   }
+  const QJsonObject first_page = QJsonDocument::fromJson(body).object();
+  addSitesPage(first_page, &site_ids);
+  const int total_pages = getTotalPages(first_page);
+  for (int page = 2; page <= total_pages; page++) {
+    if (!cache_.lookup(createSitesRequest(api_token_, page).url(), &body)) {
+      return false;
+    }
+    addSitesPage(QJsonDocument::fromJson(body).object(), &site_ids);
+  }
+
+  for (const int site_id : site_ids) {
+    const auto url = createDownloadsRequest(api_token_, site_id).url();
+    if (!cache_.lookup(url, &body)) {
+      return false;
+    }
+    addDownloads(siteFromSiteId(site_id),
+                 QJsonDocument::fromJson(body).object());
+  }
+  return !site_index_.empty();
+}
+
+QByteArray Meepo::replyBody(QNetworkReply* reply) {
+  bool hit = false;
+  const QByteArray body = cache_.body(reply, &hit);
+  if (hit) {
+    cache_hits_++;
+  } else {
+    cache_misses_++;
+  }
+  return body;
 }
 
 QString Meepo::getMetricJson(std::string metric, std::string value) {
@@ -331,7 +464,7 @@ QNetworkRequest Meepo::getMetricRequest() {
   QUrlQuery query;
   query.addQueryItem("token", api_token_);
   url.setQuery(query);
-  QNetworkRequest request(url);
+  auto request = gondar::CreateRequest(url);
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
   return request;
 }
@@ -339,7 +472,7 @@ QNetworkRequest Meepo::getMetricRequest() {
 void Meepo::sendMetric(std::string metric, std::string value) {
   QNetworkRequest request = getMetricRequest();
   QString json = getMetricJson(metric, value);
-  network_manager_.post(request, QByteArray(json.toUtf8()));
+  watch(GetNetworkManager()->post(request, QByteArray(json.toUtf8())));
 }
 
 void Meepo::handleMetricsReply(QNetworkReply* reply) {
@@ -350,9 +483,30 @@ void Meepo::handleMetricsReply(QNetworkReply* reply) {
   }
 }
 
-void Meepo::dispatchReply(QNetworkReply* reply) {
+void Meepo::dispatchReply(QNetworkReply* reply, const int generation) {
   const auto error = reply->error();
   const auto url = reply->url();
+  const bool site_request = url.path().endsWith("/sites") ||
+                            url.path().endsWith("/downloads");
+
+  // Metrics don't belong to any flow
+  if (generation != generation_ && !url.path().endsWith("/activity")) {
+    // a reply from before a restart, which is not counted in
+    // |in_flight_| any more
+    LOG_INFO << "dropping stale reply from " << url.toString();
+    reply->deleteLater();
+    return;
+  }
+
+  if (site_request) {
+    in_flight_--;
+    if (failed_) {
+      // the flow already failed; drop the stragglers
+      reply->deleteLater();
+      return;
+    }
+    startQueuedRequests();
+  }
 
   if (error != QNetworkReply::NoError) {
     // TODO(nicholasbishop): make this more readable
@@ -377,18 +531,25 @@ void Meepo::dispatchReply(QNetworkReply* reply) {
 }
 
 void Meepo::fail(const QString& error) {
+  failed_ = true;
+  queued_requests_.clear();
+  if (revalidating_) {
+    // the user is already going on with the cached sites
+    LOG_WARNING << "failed to revalidate cached sites: " << error;
+    revalidating_ = false;
+    return;
+  }
   LOG_ERROR << "error: " << error;
   error_ = error;
   emit failed(google_mode_);
 }
 
 GondarSite* Meepo::siteFromSiteId(const int site_id_in) {
-  for (auto& site : sites_) {
-    if (site.getSiteId() == site_id_in) {
-      return &site;
-    }
+  const auto iter = site_index_.find(site_id_in);
+  if (iter == site_index_.end()) {
+    return nullptr;
   }
-  return nullptr;
+  return &pages_[iter->second.first][iter->second.second];
 }
 
 int Meepo::getSiteId() {
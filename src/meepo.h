@@ -17,11 +17,16 @@
 #define SRC_MEEPO_H_
 
 #include <QAuthenticator>
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QString>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "gondarsite.h"
+#include "meepo_cache.h"
 
 namespace gondar {
 
@@ -59,6 +64,9 @@ class Meepo : public QObject {
  signals:
   void finished();
   void failed(bool google_mode);
+  // finished() was emitted early with the cached site list, and the
+  // fresh list has now arrived
+  void sitesUpdated();
 
  private:
   void requestAuth(const QAuthenticator& auth);
@@ -67,26 +75,61 @@ class Meepo : public QObject {
 
   void requestSites(int page);
   void handleSitesReply(QNetworkReply* reply);
+  // Add the sites in a page that have not been seen yet. Returns the
+  // page number.
+  int addSitesPage(const QJsonObject& json, std::vector<int>* new_site_ids);
 
-  void requestDownloads(const GondarSite& site);
+  void requestDownloads(int site_id);
   void handleDownloadsReply(QNetworkReply* reply);
+  void addDownloads(GondarSite* site, const QJsonObject& json);
+
+  // Fill in the sites from the cache. Only succeeds if every page and
+  // every site's downloads are cached.
+  bool loadCachedSites();
+  // Get the reply's body, going through the cache
+  QByteArray replyBody(QNetworkReply* reply);
+
+  // Send queued site and download requests, keeping at most
+  // max_in_flight of them outstanding
+  void startQueuedRequests();
+  // Emit finished() once every page and every site's downloads are in
+  void maybeFinish();
 
   void handleMetricsReply(QNetworkReply* reply);
 
-  void dispatchReply(QNetworkReply* reply);
+  // Route |reply| to dispatchReply() when it finishes, tagged with the
+  // current generation
+  void watch(QNetworkReply* reply);
+  void dispatchReply(QNetworkReply* reply, int generation);
   void fail(const QString& error);
 
   // used by requestAuth() and requestGoogleAuth()
   void clear();
+  void clearSites();
 
   GondarSite* siteFromSiteId(const int site_id);
 
-  QNetworkAccessManager network_manager_;
-
   QString api_token_;
-  Sites sites_;
+  // Sites by page number, so that sites() keeps the server's order
+  // however the pages arrive
+  std::map<int, Sites> pages_;
+  // Site ID -> (page, index within the page)
+  std::unordered_map<int, std::pair<int, size_t>> site_index_;
+  // Site and download requests waiting for a free slot
+  std::deque<QNetworkRequest> queued_requests_;
+  int in_flight_ = 0;
+  // Bumped whenever the sites are cleared; replies to requests made
+  // before that are dropped
+  int generation_ = 0;
+  int pages_remaining_ = 0;
+  bool failed_ = false;
   QString error_;
-  int sites_remaining_ = 0;
+  MeepoCache cache_;
+  // Set while the cached site list is being revalidated after
+  // finished() was emitted for it
+  bool revalidating_ = false;
+  int cache_hits_ = 0;
+  int cache_misses_ = 0;
   // whether or not the user is currently authenticating using
   // 'sign in with google'
   bool google_mode_ = false;
@@ -0,0 +1,147 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "meepo_cache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QUrlQuery>
+
+#include "log.h"
+
+namespace gondar {
+
+namespace {
+
+const int http_not_modified = 304;
+
+// The URL without the session token, which changes on every login
+QString cacheKey(const QString& account, const QUrl& url) {
+  QUrl stripped(url);
+  QUrlQuery query(stripped);
+  query.removeAllQueryItems("token");
+  stripped.setQuery(query);
+  return account + " " + stripped.toString();
+}
+
+}  // namespace
+
+MeepoCache::MeepoCache(const QString& dir) : dir_(dir) {
+  QDir().mkpath(dir_);
+}
+
+QString MeepoCache::defaultDir() {
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+      .filePath("meepo");
+}
+
+void MeepoCache::setAccount(const QString& account) {
+  account_ = account.toLower();
+}
+
+bool MeepoCache::enabled() const {
+  return !account_.isEmpty();
+}
+
+bool MeepoCache::lookup(const QUrl& url, QByteArray* body) const {
+  if (!enabled()) {
+    return false;
+  }
+  QFile file(entryPath(url));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const QJsonObject entry = QJsonDocument::fromJson(file.readAll()).object();
+  // guard against a hash collision
+  if (entry["key"].toString() != cacheKey(account_, url)) {
+    return false;
+  }
+  *body = entry["body"].toString().toUtf8();
+  return true;
+}
+
+void MeepoCache::addValidators(QNetworkRequest* request) const {
+  if (!enabled()) {
+    return;
+  }
+  QFile file(entryPath(request->url()));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return;
+  }
+  const QJsonObject entry = QJsonDocument::fromJson(file.readAll()).object();
+  if (entry["key"].toString() != cacheKey(account_, request->url())) {
+    return;
+  }
+  const QString etag = entry["etag"].toString();
+  if (!etag.isEmpty()) {
+    request->setRawHeader("If-None-Match", etag.toUtf8());
+  }
+  const QString last_modified = entry["last_modified"].toString();
+  if (!last_modified.isEmpty()) {
+    request->setRawHeader("If-Modified-Since", last_modified.toUtf8());
+  }
+}
+
+QByteArray MeepoCache::body(QNetworkReply* reply, bool* hit) {
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  QByteArray body;
+  if (status == http_not_modified) {
+    *hit = lookup(reply->url(), &body);
+    if (!*hit) {
+      LOG_WARNING << "not modified, but no cache entry for " << reply->url();
+    }
+    return body;
+  }
+  *hit = false;
+  body = reply->readAll();
+  store(reply->url(), reply->rawHeader("ETag"),
+        reply->rawHeader("Last-Modified"), body);
+  return body;
+}
+
+void MeepoCache::store(const QUrl& url,
+                       const QByteArray& etag,
+                       const QByteArray& last_modified,
+                       const QByteArray& body) {
+  if (!enabled()) {
+    return;
+  }
+  QJsonObject entry;
+  entry.insert("key", cacheKey(account_, url));
+  entry.insert("etag", QString::fromUtf8(etag));
+  entry.insert("last_modified", QString::fromUtf8(last_modified));
+  entry.insert("body", QString::fromUtf8(body));
+
+  QFile file(entryPath(url));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG_WARNING << "failed to write meepo cache entry " << file.fileName()
+                << ": " << file.errorString();
+    return;
+  }
+  file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact));
+}
+
+QString MeepoCache::entryPath(const QUrl& url) const {
+  const QByteArray hash = QCryptographicHash::hash(
+      cacheKey(account_, url).toUtf8(), QCryptographicHash::Sha1);
+  return QDir(dir_).filePath(QString::fromLatin1(hash.toHex()) + ".json");
+}
+
+}  // namespace gondar
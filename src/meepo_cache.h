@@ -0,0 +1,67 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_MEEPO_CACHE_H_
+#define SRC_MEEPO_CACHE_H_
+
+#include <QByteArray>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QString>
+#include <QUrl>
+
+namespace gondar {
+
+// On-disk cache of Meepo GET responses. Entries are keyed by account
+// and by URL minus the session token, and keep the ETag and
+// Last-Modified validators so that later runs can send conditional
+// requests and get a 304 back when nothing changed.
+class MeepoCache {
+ public:
+  // |dir| is created if needed
+  explicit MeepoCache(const QString& dir);
+
+  // Under the user's cache directory
+  static QString defaultDir();
+
+  // Entries are only read and written while an account is set, so
+  // that two users of the same machine never see each other's sites
+  void setAccount(const QString& account);
+  bool enabled() const;
+
+  // Get the cached body for |url|. Returns false if there is none.
+  bool lookup(const QUrl& url, QByteArray* body) const;
+  // Add If-None-Match/If-Modified-Since headers for any cached entry
+  void addValidators(QNetworkRequest* request) const;
+  // Get the body of |reply|: the cached one for a 304, otherwise the
+  // reply's own, which is stored for next time. |hit| is set to
+  // whether the cache was used.
+  QByteArray body(QNetworkReply* reply, bool* hit);
+
+  void store(const QUrl& url,
+             const QByteArray& etag,
+             const QByteArray& last_modified,
+             const QByteArray& body);
+
+ private:
+  QString entryPath(const QUrl& url) const;
+
+  const QString dir_;
+  QString account_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_MEEPO_CACHE_H_
@@ -18,27 +18,20 @@
 #include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
 #include <QStandardPaths>
-#include <QUrl>
 #include <QUrlQuery>
 #include <QUuid>
 
 #include "config.h"
 #include "log.h"
 #include "meepo.h"
+#include "metrics_queue.h"
 #include "util.h"
 
 namespace gondar {
 
 namespace {
 
-QNetworkAccessManager* getNetworkManager() {
-  static QNetworkAccessManager manager;
-  return &manager;
-}
-
 std::string getMetricString(Metric metric) {
   switch (metric) {
     case Metric::BeeroverUse:
@@ -57,6 +50,8 @@ std::string getMetricString(Metric metric) {
       return "format-attempt";
     case Metric::FormatSuccess:
       return "format-success";
+    case Metric::MeepoCache:
+      return "meepo-cache";
     case Metric::UsbAttempt:
       return "usb-attempt";
     case Metric::UsbSuccess:
@@ -65,20 +60,23 @@ std::string getMetricString(Metric metric) {
       return "use";
     case Metric::SuccessDuration:
       return "success-duration";
+    case Metric::StageTimings:
+      return "stage-timings";
     // not sure we want to crash the program on a bad metric lookup
     default:
       return "unknown";
   }
 }
 
-QByteArray getMetricsApiKey() {
+}  // namespace
+
+QByteArray GetMetricsApiKey() {
 #ifdef METRICS_API_KEY
   return QByteArray(METRICS_API_KEY);
 #else
   return QByteArray();
 #endif
 }
-}  // namespace
 
 QString GetUuid() {
   static QString id;
@@ -109,7 +107,7 @@ QString GetUuid() {
 }
 
 static bool shouldSendMetrics() {
-  const auto api_key = getMetricsApiKey();
+  const auto api_key = GetMetricsApiKey();
   if (api_key.isEmpty()) {
     // all production builds should sent metrics
     LOG_WARNING << "not sending metrics!";
@@ -119,15 +117,15 @@ static bool shouldSendMetrics() {
 }
 
 // send regular gondar metrics
-void SendMetricGondar(Metric metric, const std::string& value, int site_id) {
+void SendMetricGondar(Metric metric,
+                      const std::string& value,
+                      int site_id,
+                      const QJsonObject& details) {
   if (!shouldSendMetrics()) {
     return;
   }
   LOG_INFO << "sending a Klassic Metric: " << getMetricString(metric);
-  const auto api_key = getMetricsApiKey();
   std::string metricStr = getMetricString(metric);
-  QNetworkAccessManager* manager = getNetworkManager();
-  QUrl url("https://gondar-metrics.neverware.com/prod");
   QJsonObject json;
   QString id = GetUuid();
   json["identifier"] = id;
@@ -136,6 +134,9 @@ void SendMetricGondar(Metric metric, const std::string& value, int site_id) {
     // then we append the value to the metric
     json.insert("value", QString::fromStdString(value));
   }
+  if (!details.isEmpty()) {
+    json.insert("details", details);
+  }
   const auto version = gondar::getGondarVersion();
   if (!version.isEmpty()) {
     json.insert("version", version);
@@ -152,13 +153,7 @@ void SendMetricGondar(Metric metric, const std::string& value, int site_id) {
   if (isChromeover() && site_id != 0) {
     json.insert("site", site_id);
   }
-  QNetworkRequest request(url);
-  request.setRawHeader(QByteArray("x-api-key"), api_key);
-  request.setHeader(QNetworkRequest::ContentTypeHeader,
-                    "application/x-www-form-urlencoded");
-  QJsonDocument doc(json);
-  QString strJson(doc.toJson(QJsonDocument::Compact));
-  manager->post(request, QByteArray(strJson.toUtf8()));
+  MetricsQueue::instance()->enqueue(json);
 }
 
 static void SendMetricMeepo(Metric metric,
@@ -175,10 +170,23 @@ static void SendMetricMeepo(Metric metric,
 }
 
 void SendMetric(GondarWizard* wizard, Metric metric, const std::string& value) {
-  SendMetricGondar(metric, value, wizard->getSiteId());
+  // the headless installer has no wizard
+  const int site_id = wizard ? wizard->getSiteId() : 0;
+  SendMetricGondar(metric, value, site_id);
   // if we have a token, also send the metric to meepo
   if (wizard && wizard->meepo_.hasToken()) {
     SendMetricMeepo(metric, value, wizard);
   }
 }
+
+void SendTimings(GondarWizard* wizard, const RunTimings& timings) {
+  const QJsonObject details = timings.toJson();
+  const int site_id = wizard ? wizard->getSiteId() : 0;
+  SendMetricGondar(Metric::StageTimings, "", site_id, details);
+  if (wizard && wizard->meepo_.hasToken()) {
+    const QByteArray value =
+        QJsonDocument(details).toJson(QJsonDocument::Compact);
+    SendMetricMeepo(Metric::StageTimings, value.toStdString(), wizard);
+  }
+}
 }  // namespace gondar
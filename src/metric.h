@@ -16,10 +16,12 @@
 #ifndef SRC_METRIC_H_
 #define SRC_METRIC_H_
 
+#include <QJsonObject>
 #include <QString>
 #include <string>
 
 #include "gondarwizard.h"
+#include "run_timings.h"
 
 namespace gondar {
 
@@ -32,22 +34,31 @@ enum class Metric {
   Error,
   FormatAttempt,
   FormatSuccess,
+  MeepoCache,
+  StageTimings,
   SuccessDuration,
   UsbAttempt,
   UsbSuccess,
   Use,
 };
 
-// send a metric just to gondar endpoint, not both gondar and meepo
+// send a metric just to gondar endpoint, not both gondar and meepo.
+// |details| is sent along as a structured "details" object.
 void SendMetricGondar(Metric metric,
                       const std::string& value = "",
-                      int site_id = 0);
+                      int site_id = 0,
+                      const QJsonObject& details = QJsonObject());
 // send a metric to gondar endpoint and meepo endpoint if we have a session
 void SendMetric(GondarWizard* wizard,
                 Metric metric,
                 const std::string& value = "");
+// send the per-stage timings of a successful run. Meepo only takes
+// string values, so it gets the same JSON serialized.
+void SendTimings(GondarWizard* wizard, const RunTimings& timings);
 
 QString GetUuid();
+// Empty in builds that do not send metrics
+QByteArray GetMetricsApiKey();
 }  // namespace gondar
 
 #endif  // SRC_METRIC_H_
@@ -0,0 +1,207 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "metrics_queue.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QUrl>
+
+#include "log.h"
+#include "metric.h"
+
+namespace gondar {
+
+MetricsQueue::MetricsQueue(const QString& path,
+                           const QUrl& url,
+                           const QByteArray& api_key)
+    : path_(path), url_(url), api_key_(api_key) {}
+
+MetricsQueue::~MetricsQueue() {
+  if (thread_.isRunning()) {
+    shutdown(0);
+  }
+}
+
+MetricsQueue* MetricsQueue::instance() {
+  static MetricsQueue queue(
+      QDir(QStandardPaths::writableLocation(QStandardPaths::ConfigLocation))
+          .filePath("cloudready_installer_metrics"),
+      QUrl("https://gondar-metrics.neverware.com/prod"), GetMetricsApiKey());
+  return &queue;
+}
+
+void MetricsQueue::enqueue(const QJsonObject& event) {
+  const QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+  QMutexLocker locker(&mutex_);
+  QFile file(path_);
+  if (!file.open(QIODevice::Append)) {
+    LOG_WARNING << "failed to open metrics queue " << path_ << ": "
+                << file.errorString();
+    return;
+  }
+  file.write(line + "\n");
+}
+
+int MetricsQueue::queued() {
+  QMutexLocker locker(&mutex_);
+  return readQueue().size();
+}
+
+void MetricsQueue::start() {
+  if (thread_.isRunning()) {
+    return;
+  }
+  sender_ = new QObject;
+  network_ = new QNetworkAccessManager(sender_);
+  timer_ = new QTimer(sender_);
+  timer_->setInterval(flush_interval_ms);
+  sender_->moveToThread(&thread_);
+
+  connect(timer_, &QTimer::timeout, sender_, [this]() { flush(); });
+  connect(this, &MetricsQueue::flushRequested, sender_,
+          [this]() { flush(); });
+  connect(&thread_, &QThread::started, sender_, [this]() {
+    // the network manager is tied to this thread, so it gets its own
+    // connection rather than sharing the main thread's
+    network_->connectToHostEncrypted(url_.host());
+    timer_->start();
+    // Send whatever an earlier run left behind
+    flush();
+  });
+  connect(&thread_, &QThread::finished, sender_, &QObject::deleteLater);
+  thread_.start();
+}
+
+void MetricsQueue::shutdown(const int timeout_ms) {
+  if (!thread_.isRunning()) {
+    return;
+  }
+  drain_requested_ = true;
+  emit flushRequested();
+  if (!drained_.tryAcquire(1, timeout_ms)) {
+    LOG_WARNING << "metrics not sent before exit, " << queued()
+                << " left for next time";
+  }
+  thread_.quit();
+  thread_.wait();
+  sender_ = nullptr;
+}
+
+void MetricsQueue::flush() {
+  if (flushing_) {
+    return;
+  }
+  {
+    QMutexLocker locker(&mutex_);
+    QList<QByteArray> lines = readQueue();
+    if (lines.size() > max_queued) {
+      LOG_WARNING << "dropping " << lines.size() - max_queued
+                  << " old metric events";
+      lines = lines.mid(lines.size() - max_queued);
+      writeQueue(lines);
+    }
+    batch_ = lines.mid(0, batch_size);
+  }
+  if (batch_.isEmpty()) {
+    finishFlush();
+    return;
+  }
+  flushing_ = true;
+  sent_ = 0;
+  sendNext();
+}
+
+void MetricsQueue::sendNext() {
+  if (sent_ == batch_.size()) {
+    finishFlush();
+    return;
+  }
+
+  QNetworkRequest request(url_);
+  request.setRawHeader(QByteArray("x-api-key"), api_key_);
+  request.setHeader(QNetworkRequest::ContentTypeHeader,
+                    "application/x-www-form-urlencoded");
+  // The endpoint takes one event per request, so a batch goes out
+  // back to back over the same kept-alive connection
+  QNetworkReply* reply = network_->post(request, batch_[sent_]);
+  connect(reply, &QNetworkReply::finished, sender_, [this, reply]() {
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+      LOG_WARNING << "failed to send metric, will retry: "
+                  << reply->errorString();
+      finishFlush();
+      return;
+    }
+    sent_++;
+    sendNext();
+  });
+}
+
+void MetricsQueue::finishFlush() {
+  if (sent_ > 0) {
+    LOG_INFO << "sent " << sent_ << " queued metrics";
+    QMutexLocker locker(&mutex_);
+    // Only the front of the file was sent; events appended since then
+    // stay queued
+    writeQueue(readQueue().mid(sent_));
+  }
+  const bool more = sent_ == batch_size;
+  batch_.clear();
+  sent_ = 0;
+  flushing_ = false;
+
+  if (more) {
+    flush();
+    return;
+  }
+  if (drain_requested_.exchange(false)) {
+    drained_.release();
+  }
+}
+
+QList<QByteArray> MetricsQueue::readQueue() {
+  QList<QByteArray> lines;
+  QFile file(path_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return lines;
+  }
+  for (const QByteArray& line : file.readAll().split('\n')) {
+    if (!line.isEmpty()) {
+      lines.append(line);
+    }
+  }
+  return lines;
+}
+
+void MetricsQueue::writeQueue(const QList<QByteArray>& lines) {
+  QFile file(path_);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG_WARNING << "failed to rewrite metrics queue " << path_ << ": "
+                << file.errorString();
+    return;
+  }
+  for (const QByteArray& line : lines) {
+    file.write(line + "\n");
+  }
+}
+
+}  // namespace gondar
@@ -0,0 +1,107 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_METRICS_QUEUE_H_
+#define SRC_METRICS_QUEUE_H_
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+#include <QUrl>
+#include <atomic>
+
+class QNetworkAccessManager;
+class QTimer;
+
+namespace gondar {
+
+// Metric events waiting to be sent, kept in an append-only file so
+// that they survive a lost network connection or the app being
+// closed. A sender thread of its own drains the file in batches every
+// so often and at exit. Events are only removed once the server has
+// accepted them; anything left over is retried on the next flush, or
+// the next time the app runs.
+class MetricsQueue : public QObject {
+  Q_OBJECT
+
+ public:
+  static const int flush_interval_ms = 30 * 1000;
+  // Events sent per flush
+  static const int batch_size = 50;
+  // Oldest events are dropped beyond this
+  static const int max_queued = 1000;
+
+  // |path| is the queue file. Events are posted to |url| with
+  // |api_key|.
+  MetricsQueue(const QString& path, const QUrl& url, const QByteArray& api_key);
+  ~MetricsQueue();
+
+  // The queue for the gondar metrics endpoint
+  static MetricsQueue* instance();
+
+  // Append |event| to the queue file. Cheap, thread-safe and usable
+  // before start().
+  void enqueue(const QJsonObject& event);
+  // Events waiting to be sent
+  int queued();
+
+  // Start the sender thread. Needs a QCoreApplication.
+  void start();
+  // Try to send everything still queued, waiting at most |timeout_ms|,
+  // then stop the sender thread
+  void shutdown(int timeout_ms = 3000);
+
+ signals:
+  void flushRequested();
+
+ private:
+  // Everything from here on runs on the sender thread, except where
+  // noted
+  void flush();
+  void sendNext();
+  void finishFlush();
+
+  // Called with |mutex_| held
+  QList<QByteArray> readQueue();
+  void writeQueue(const QList<QByteArray>& lines);
+
+  const QString path_;
+  const QUrl url_;
+  const QByteArray api_key_;
+  QMutex mutex_;
+
+  QThread thread_;
+  // Owns the network manager and timer; lives on |thread_|
+  QObject* sender_ = nullptr;
+  QNetworkAccessManager* network_ = nullptr;
+  QTimer* timer_ = nullptr;
+
+  QList<QByteArray> batch_;
+  int sent_ = 0;
+  bool flushing_ = false;
+  // Set by shutdown(); the sender releases |drained_| when the next
+  // flush ends
+  std::atomic<bool> drain_requested_{false};
+  QSemaphore drained_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_METRICS_QUEUE_H_
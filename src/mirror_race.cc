@@ -0,0 +1,165 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mirror_race.h"
+
+#include <QNetworkRequest>
+#include <algorithm>
+
+#include "http_client.h"
+#include "log.h"
+
+namespace gondar {
+
+namespace {
+
+// Enough to get past TCP slow start on a typical connection without
+// wasting much if the mirror loses
+const qint64 default_probe_size = 512 * 1024;
+const int default_timeout_ms = 10000;
+
+}  // namespace
+
+MirrorRace::MirrorRace(QObject* parent)
+    : QObject(parent), probe_size_(default_probe_size) {
+  timeout_.setSingleShot(true);
+  timeout_.setInterval(default_timeout_ms);
+  connect(&timeout_, &QTimer::timeout, this, [this]() {
+    LOG_WARNING << "mirror race timed out";
+    finish();
+  });
+}
+
+MirrorRace::~MirrorRace() {
+  done_ = true;
+  for (auto& probe : probes_) {
+    if (probe.reply) {
+      probe.reply->disconnect(this);
+      probe.reply->abort();
+      probe.reply->deleteLater();
+    }
+  }
+}
+
+void MirrorRace::setProbeSize(const qint64 bytes) {
+  probe_size_ = bytes;
+}
+
+void MirrorRace::setTimeout(const int ms) {
+  timeout_.setInterval(ms);
+}
+
+void MirrorRace::start(const QList<QUrl>& mirrors) {
+  // the probes are referred to by address, so size the vector up front
+  probes_.resize(mirrors.size());
+  elapsed_.start();
+  timeout_.start();
+
+  for (int i = 0; i < mirrors.size(); i++) {
+    Probe* probe = &probes_[i];
+    probe->result.url = mirrors[i];
+    QNetworkRequest request = CreateRequest(mirrors[i]);
+    request.setRawHeader("Range",
+                         "bytes=0-" + QByteArray::number(probe_size_ - 1));
+    probe->reply = GetNetworkManager()->get(request);
+    connect(probe->reply, &QNetworkReply::readyRead, this,
+            [this, probe]() { onReadyRead(probe); });
+    connect(probe->reply, &QNetworkReply::finished, this,
+            [this, probe]() { onFinished(probe); });
+  }
+}
+
+const std::vector<MirrorRace::Result>& MirrorRace::ranking() const {
+  return ranking_;
+}
+
+void MirrorRace::onReadyRead(Probe* probe) {
+  Result& result = probe->result;
+  if (result.latency_ms < 0) {
+    result.latency_ms = elapsed_.elapsed();
+  }
+  // a mirror that ignores the range sends the whole file, so the probe
+  // is judged on its first |probe_size_| bytes either way
+  result.bytes_received += probe->reply->readAll().size();
+  if (result.bytes_received >= probe_size_) {
+    finish();
+  }
+}
+
+void MirrorRace::onFinished(Probe* probe) {
+  if (done_) {
+    return;
+  }
+  QNetworkReply* reply = probe->reply;
+  probe->reply = nullptr;
+  reply->deleteLater();
+
+  if (reply->error() != QNetworkReply::NoError) {
+    LOG_WARNING << "mirror " << probe->result.url
+                << " failed: " << reply->errorString();
+    probe->failed = true;
+  } else {
+    // a file smaller than the probe
+    finish();
+    return;
+  }
+
+  const bool all_failed =
+      std::all_of(probes_.begin(), probes_.end(),
+                  [](const Probe& other) { return other.failed; });
+  if (all_failed) {
+    finish();
+  }
+}
+
+void MirrorRace::finish() {
+  if (done_) {
+    return;
+  }
+  done_ = true;
+  timeout_.stop();
+
+  const qint64 now = elapsed_.elapsed();
+  for (auto& probe : probes_) {
+    if (probe.reply) {
+      probe.reply->disconnect(this);
+      probe.reply->abort();
+      probe.reply->deleteLater();
+      probe.reply = nullptr;
+    }
+    if (probe.failed) {
+      continue;
+    }
+    Result& result = probe.result;
+    if (result.latency_ms >= 0) {
+      result.bytes_per_sec = result.bytes_received * 1000 /
+                             std::max<qint64>(1, now - result.latency_ms);
+    }
+    ranking_.push_back(result);
+  }
+
+  // whoever got furthest in the same time is fastest
+  std::stable_sort(ranking_.begin(), ranking_.end(),
+                   [](const Result& a, const Result& b) {
+                     return a.bytes_received > b.bytes_received;
+                   });
+  for (const auto& result : ranking_) {
+    LOG_INFO << "mirror " << result.url << ": " << result.latency_ms
+             << " ms to first byte, " << result.bytes_per_sec << " B/s";
+  }
+  emit finished();
+}
+
+}  // namespace gondar
@@ -0,0 +1,84 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_MIRROR_RACE_H_
+#define SRC_MIRROR_RACE_H_
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QNetworkReply>
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+#include <vector>
+
+namespace gondar {
+
+// Probes every mirror of a file at once with a small range request and
+// ranks them by how soon each delivered the probe, which accounts for
+// both latency and throughput. As soon as one mirror has delivered the
+// whole probe the rest are stopped and ranked by how much they had
+// received by then.
+class MirrorRace : public QObject {
+  Q_OBJECT
+
+ public:
+  struct Result {
+    QUrl url;
+    // Time to the first byte, or -1 if nothing arrived
+    qint64 latency_ms = -1;
+    qint64 bytes_received = 0;
+    // Zero until the probe has received something
+    qint64 bytes_per_sec = 0;
+  };
+
+  explicit MirrorRace(QObject* parent = nullptr);
+  ~MirrorRace();
+
+  // Bytes requested from each mirror
+  void setProbeSize(qint64 bytes);
+  // Give up on mirrors that have not delivered the probe by then
+  void setTimeout(int ms);
+
+  void start(const QList<QUrl>& mirrors);
+  // Mirrors that did not fail, fastest first. Valid once finished() is
+  // emitted.
+  const std::vector<Result>& ranking() const;
+
+ signals:
+  void finished();
+
+ private:
+  struct Probe {
+    Result result;
+    QNetworkReply* reply = nullptr;
+    bool failed = false;
+  };
+
+  void onReadyRead(Probe* probe);
+  void onFinished(Probe* probe);
+  void finish();
+
+  qint64 probe_size_;
+  QTimer timeout_;
+  QElapsedTimer elapsed_;
+  std::vector<Probe> probes_;
+  std::vector<Result> ranking_;
+  bool done_ = false;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_MIRROR_RACE_H_
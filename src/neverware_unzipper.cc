@@ -15,8 +15,16 @@
 
 #include "neverware_unzipper.h"
 
+#include <QCryptographicHash>
 #include <QDir>
+#include <QFile>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <utility>
 
 #include "unzip.h"
 
@@ -25,42 +33,81 @@
 #include "iowin32.h"
 #endif
 
+#include "buffer_pool.h"
+#include "chunked_image.h"
 #include "log.h"
-
-// Defined in minizip/miniunz.c
-extern "C" {
-int miniunz_extract_currentfile(unzFile uf,
-                                int opt_extract_without_path,
-                                int* popt_overwrite,
-                                const char* password);
-}
+#include "pipeline.h"
+#include "task_pool.h"
+#include "trace.h"
 
 namespace {
 
-// RAII class for changing the current working directory. When it goes
-// out of scope the working directory is reset.
-class ScopedWorkingDirectory {
+// Extraction reads this much at a time, checking for cancellation
+// between reads
+const size_t extract_chunk_size = 1024 * 1024;
+
+// Far more than the manifest of any real image needs
+const int max_manifest_size = 16 * 1024 * 1024;
+
+class ZipError : public std::runtime_error {
  public:
-  ScopedWorkingDirectory() : orig_dir_(QDir::current()) {}
+  explicit ZipError(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Whether |name| can be used as is for a file in the output directory,
+// without leading anywhere else
+bool isPlainFileName(const QString& name) {
+  return !name.isEmpty() && !name.contains('/') && !name.contains('\\') &&
+         !name.contains("..");
+}
 
-  ~ScopedWorkingDirectory() { setCwd(orig_dir_); }
+// Inflates the current entry of an open zip file
+class ZipEntrySource : public gondar::Source {
+ public:
+  // |*cancelled| is set if reading stops because |cancel| was set
+  ZipEntrySource(unzFile file,
+                 const QString& name,
+                 const std::atomic<bool>* cancel,
+                 bool* cancelled)
+      : Source("inflate " + name.toStdString()),
+        file_(file),
+        cancel_(cancel),
+        cancelled_(cancelled) {}
 
-  static void setCwd(const QDir& dir) {
-    const QString path = dir.absolutePath();
-    if (QDir::setCurrent(path)) {
-      LOG_INFO << "set current working directory to " << path;
-    } else {
-      LOG_ERROR << "failed to set current working directory to " << path;
+  bool read(gondar::BufferRef* buffer) override {
+    if (cancel_ && *cancel_) {
+      *cancelled_ = true;
+      return false;
     }
+    std::shared_ptr<gondar::Buffer> block;
+    try {
+      block = gondar::Buffer::create(extract_chunk_size);
+    } catch (const std::bad_alloc&) {
+      LOG_ERROR << "no buffer available to inflate into";
+      return false;
+    }
+    const int count = unzReadCurrentFile(
+        file_, block->data(), static_cast<unsigned>(block->capacity()));
+    if (count < 0) {
+      LOG_ERROR << "unzReadCurrentFile failed: " << count;
+      return false;
+    }
+    if (count == 0) {
+      buffer->reset();
+      return true;
+    }
+    block->setSize(static_cast<size_t>(count));
+    block->setOffset(offset_);
+    offset_ += static_cast<uint64_t>(count);
+    *buffer = std::move(block);
+    return true;
   }
 
  private:
-  const QDir orig_dir_;
-};
-
-class ZipError : std::runtime_error {
- public:
-  explicit ZipError(const std::string& what) : std::runtime_error(what) {}
+  unzFile file_;
+  const std::atomic<bool>* cancel_;
+  bool* cancelled_;
+  uint64_t offset_ = 0;
 };
 
 class ZipFile {
@@ -69,9 +116,14 @@ class ZipFile {
 
  public:
   // Open a file for unzipping. Throw a ZipError if the open fails, so
-  // the object is never partially constructed.
-  explicit ZipFile(const QFileInfo& zipfile_info)
-      : zipfile_info_(zipfile_info), file_(open(zipfile_info)) {}
+  // the object is never partially constructed. Output goes to
+  // |output_dir|, or next to the zipfile if that's empty.
+  explicit ZipFile(const QFileInfo& zipfile_info,
+                   const QString& output_dir = QString())
+      : zipfile_info_(zipfile_info),
+        output_dir_(output_dir.isEmpty() ? zipfile_info.absoluteDir()
+                                         : QDir(output_dir)),
+        file_(open(zipfile_info)) {}
 
   ~ZipFile() {
     const auto rc = unzClose(file_);
@@ -80,31 +132,277 @@ class ZipFile {
     }
   }
 
-  // Extract the first file in the zip in the same directory as the
-  // zipfile. Throw a ZipError if anything goes wrong.
-  QFileInfo extractFirstFile() {
-    const QString firstFileName = goToFirstFile();
+  // Extract the first file in the zip into the output directory,
+  // dropping any directories in its name. Throw a ZipError if anything
+  // goes wrong or |cancel| is set.
+  QFileInfo extractFirstFile(const std::atomic<bool>* cancel) {
+    const QString entry_name = goToFirstFile();
+    // Archives can come from mirrors and LAN peers, so an entry must
+    // not be able to point outside the output directory
+    const QString firstFileName = QFileInfo(entry_name).fileName();
+    if (entry_name.contains("..") || !isPlainFileName(firstFileName)) {
+      LOG_ERROR << "refusing to extract zip entry " << entry_name;
+      throw ZipError("bad entry name in zip");
+    }
+    const QString output_path = output_dir_.absoluteFilePath(firstFileName);
+
+    auto rc = unzOpenCurrentFile(file_);
+    if (rc != UNZ_OK) {
+      LOG_ERROR << "unzOpenCurrentFile failed: " << rc;
+      throw ZipError("unzOpenCurrentFile failed");
+    }
+
+    // Inflating and writing overlap, each on a thread of its own. The
+    // pipeline is scoped so the output is closed before it is removed,
+    // which Windows refuses while the file is open.
+    bool cancelled = false;
+    bool ok = false;
+    {
+      gondar::Pipeline pipeline;
+      pipeline.setSource(std::unique_ptr<gondar::Source>(
+          new ZipEntrySource(file_, firstFileName, cancel, &cancelled)));
+      pipeline.addSink(
+          std::unique_ptr<gondar::Sink>(new gondar::FileSink(output_path)));
+      ok = pipeline.run();
+    }
+
+    rc = unzCloseCurrentFile(file_);
+    if (ok && rc != UNZ_OK) {
+      // This is where a CRC mismatch shows up
+      LOG_ERROR << "unzCloseCurrentFile failed: " << rc;
+      ok = false;
+    }
+
+    if (cancelled) {
+      LOG_WARNING << "extraction cancelled";
+      QFile::remove(output_path);
+      throw ZipError("extraction cancelled");
+    }
+    if (!ok) {
+      QFile::remove(output_path);
+      throw ZipError("extraction failed");
+    }
+    return output_path;
+  }
 
-    const int opt_extract_without_path = 1;
-    int opt_overwrite = 1;
-    const char* password = nullptr;
+  // Whether this is a chunked image archive
+  bool isChunked() {
+    return unzLocateFile(file_, gondar::chunk_manifest_entry, 1) == UNZ_OK;
+  }
 
+  // Reassemble the image in a chunked archive in the output directory.
+  // Chunks are inflated in parallel on the TaskPool, each into its own
+  // part of the output, and checked against the manifest. Throw a
+  // ZipError if anything goes wrong or |cancel| is set.
+  QFileInfo extractChunks(const std::atomic<bool>* cancel) {
+    const auto manifest = gondar::ChunkManifest::parse(readManifest());
+    if (!manifest) {
+      throw ZipError("malformed chunk manifest");
+    }
+    // parse() already refuses such names, but the output must never
+    // land outside the archive's directory
+    const QString& image_name = manifest->image_name;
+    if (!isPlainFileName(image_name)) {
+      LOG_ERROR << "bad image name in chunk manifest: " << image_name;
+      throw ZipError("malformed chunk manifest");
+    }
+    const QString output_path = output_dir_.absoluteFilePath(image_name);
     {
-      ScopedWorkingDirectory scoped_wd;
-      scoped_wd.setCwd(zipfile_info_.absolutePath());
-
-      const auto rc = miniunz_extract_currentfile(
-          file_, opt_extract_without_path, &opt_overwrite, password);
-      if (rc != UNZ_OK) {
-        LOG_ERROR << "miniunz_extract_currentfile failed: " << rc;
-        throw ZipError("miniunz_extract_currentfile failed");
+      QFile output(output_path);
+      if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+          !output.resize(static_cast<qint64>(manifest->image_size))) {
+        LOG_ERROR << "failed to create " << output_path << ": "
+                  << output.errorString();
+        throw ZipError("extraction failed");
       }
     }
+    const size_t chunk_count = manifest->chunkCount();
+    LOG_INFO << "extracting " << chunk_count << " chunks to " << output_path;
 
-    return zipfile_info_.absoluteDir().absoluteFilePath(firstFileName);
+    auto job = std::make_shared<ChunkJob>();
+    job->manifest = *manifest;
+    job->zipfile_info = zipfile_info_;
+    job->output_path = output_path;
+    job->cancel = cancel;
+
+    // This may itself be running on the pool, with the helpers queued
+    // behind it on the same worker. So it takes chunks too, and then
+    // waits only for helpers that actually started; any that start
+    // later find the job closed and return at once.
+    gondar::TaskPool* pool = gondar::TaskPool::instance();
+    const size_t helper_count =
+        chunk_count > 1 ? std::min<size_t>(pool->workerCount() - 1,
+                                           chunk_count - 1)
+                        : 0;
+    for (size_t i = 0; i < helper_count; i++) {
+      pool->submit([job]() {
+        {
+          std::lock_guard<std::mutex> lock(job->mutex);
+          if (job->closed) {
+            return;
+          }
+          job->running++;
+        }
+        takeChunks(job.get());
+        {
+          std::lock_guard<std::mutex> lock(job->mutex);
+          job->running--;
+        }
+        job->idle.notify_all();
+      });
+    }
+    takeChunks(job.get());
+    {
+      std::unique_lock<std::mutex> lock(job->mutex);
+      job->closed = true;
+      job->idle.wait(lock, [&job]() { return job->running == 0; });
+    }
+
+    if (cancel && *cancel) {
+      LOG_WARNING << "extraction cancelled";
+      QFile::remove(output_path);
+      throw ZipError("extraction cancelled");
+    }
+    if (job->failed) {
+      QFile::remove(output_path);
+      throw ZipError("extraction failed");
+    }
+    return output_path;
   }
 
  private:
+  // Shared by the threads extracting one chunked archive
+  struct ChunkJob {
+    gondar::ChunkManifest manifest;
+    QFileInfo zipfile_info;
+    QString output_path;
+    const std::atomic<bool>* cancel = nullptr;
+
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> failed{false};
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    // Helpers inside takeChunks()
+    int running = 0;
+    // Set once the extracting thread is done taking chunks
+    bool closed = false;
+  };
+
+  // Extract chunks of |job| until there are none left, one fails or
+  // the job is cancelled
+  static void takeChunks(ChunkJob* job) {
+    try {
+      ZipFile zip(job->zipfile_info);
+      while (!job->failed && !(job->cancel && *job->cancel)) {
+        const size_t index = job->next_chunk++;
+        if (index >= job->manifest.chunkCount()) {
+          break;
+        }
+        zip.extractChunk(job->manifest, index, job->output_path, job->cancel);
+      }
+    } catch (const std::exception& exc) {
+      LOG_ERROR << "chunk extraction failed: " << exc.what();
+      job->failed = true;
+    }
+  }
+
+  QByteArray readManifest() {
+    unz_file_info64 info = {};
+    if (unzLocateFile(file_, gondar::chunk_manifest_entry, 1) != UNZ_OK ||
+        unzGetCurrentFileInfo64(file_, &info, nullptr, 0, nullptr, 0, nullptr,
+                                0) != UNZ_OK ||
+        info.uncompressed_size > max_manifest_size ||
+        unzOpenCurrentFile(file_) != UNZ_OK) {
+      throw ZipError("can't open the chunk manifest");
+    }
+    QByteArray data(static_cast<int>(info.uncompressed_size), '\0');
+    const int count = unzReadCurrentFile(file_, data.data(),
+                                         static_cast<unsigned>(data.size()));
+    const auto rc = unzCloseCurrentFile(file_);
+    if (count != data.size() || rc != UNZ_OK) {
+      LOG_ERROR << "reading the chunk manifest failed: " << count << ", "
+                << rc;
+      throw ZipError("can't read the chunk manifest");
+    }
+    return data;
+  }
+
+  // Inflate chunk |index| into its place in |output_path|. Throw a
+  // ZipError if it doesn't match |manifest|. Returns early, leaving
+  // the chunk incomplete, if |cancel| is set.
+  void extractChunk(const gondar::ChunkManifest& manifest,
+                    const size_t index,
+                    const QString& output_path,
+                    const std::atomic<bool>* cancel) {
+    gondar::TraceScope trace("unzip", "chunk");
+    const std::string name = gondar::ChunkEntryName(index).toStdString();
+    if (unzLocateFile(file_, name.c_str(), 1) != UNZ_OK ||
+        unzOpenCurrentFile(file_) != UNZ_OK) {
+      throw ZipError("can't open " + name);
+    }
+
+    QFile output(output_path);
+    bool ok = output.open(QIODevice::ReadWrite) &&
+              output.seek(static_cast<qint64>(manifest.chunkOffset(index)));
+    if (!ok) {
+      LOG_ERROR << "failed to open " << output_path << ": "
+                << output.errorString();
+    }
+
+    gondar::BufferPool* pool = gondar::BufferPool::instance();
+    size_t capacity = 0;
+    uint8_t* buffer = nullptr;
+    if (ok) {
+      buffer = pool->acquire(extract_chunk_size, &capacity);
+      ok = buffer != nullptr;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    const uint64_t chunk_length = manifest.chunkLength(index);
+    uint64_t length = 0;
+    bool cancelled = false;
+    while (ok) {
+      if (cancel && *cancel) {
+        cancelled = true;
+        break;
+      }
+      // Never read past the chunk's end, which belongs to the next
+      // chunk; one byte more than is left shows the entry is too long
+      const uint64_t remaining = chunk_length - length;
+      const int count = unzReadCurrentFile(
+          file_, buffer,
+          static_cast<unsigned>(std::min<uint64_t>(capacity, remaining + 1)));
+      if (count < 0) {
+        LOG_ERROR << "unzReadCurrentFile failed: " << count;
+        ok = false;
+      } else if (count == 0) {
+        break;
+      } else if (static_cast<uint64_t>(count) > remaining) {
+        LOG_ERROR << name << " is longer than the manifest says";
+        ok = false;
+      } else if (output.write(reinterpret_cast<const char*>(buffer),
+                              count) != count) {
+        LOG_ERROR << "failed to write " << output_path << ": "
+                  << output.errorString();
+        ok = false;
+      } else {
+        hash.addData(reinterpret_cast<const char*>(buffer), count);
+        length += static_cast<uint64_t>(count);
+      }
+    }
+    pool->release(buffer, capacity);
+
+    const auto rc = unzCloseCurrentFile(file_);
+    if (cancelled) {
+      return;
+    }
+    if (!ok || rc != UNZ_OK || length != chunk_length ||
+        hash.result().toHex() != manifest.chunk_sha256[index]) {
+      LOG_ERROR << name << " does not match the manifest";
+      throw ZipError(name + " does not match the manifest");
+    }
+  }
+
   static unzFile open(const QFileInfo zipfile_info) {
     const std::string path = zipfile_info.absoluteFilePath().toStdString();
     LOG_INFO << "opening zipfile " << path;
@@ -149,11 +447,18 @@ class ZipFile {
   }
 
   const QFileInfo zipfile_info_;
+  const QDir output_dir_;
   unzFile file_;
 };
 
 }  // namespace
 
-QFileInfo neverware_unzip(const QFileInfo& input_file) {
-  return ZipFile(input_file).extractFirstFile();
+QFileInfo neverware_unzip(const QFileInfo& input_file,
+                          const std::atomic<bool>* cancel,
+                          const QString& output_dir) {
+  ZipFile zip(input_file, output_dir);
+  if (zip.isChunked()) {
+    return zip.extractChunks(cancel);
+  }
+  return zip.extractFirstFile(cancel);
 }
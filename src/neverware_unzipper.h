@@ -17,7 +17,16 @@
 #define SRC_NEVERWARE_UNZIPPER_H_
 
 #include <QFileInfo>
+#include <QString>
+#include <atomic>
 
-QFileInfo neverware_unzip(const QFileInfo& input_file);
+// Extract the first file in |input_file| into |output_dir|, or next to
+// it if that's empty, and return the extracted file. For a chunked
+// image archive (see chunked_image.h) the image it holds is
+// reassembled instead. Throws a std::runtime_error on failure, or if
+// |cancel| is set while extracting; the partial output is removed.
+QFileInfo neverware_unzip(const QFileInfo& input_file,
+                          const std::atomic<bool>* cancel = nullptr,
+                          const QString& output_dir = QString());
 
 #endif  // SRC_NEVERWARE_UNZIPPER_H_
@@ -17,41 +17,64 @@
 
 #include <QNetworkReply>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 
+#include "http_client.h"
 #include "log.h"
 
-static QUrl getLatestUrl(QNetworkReply* reply) {
-  const char base[] = "https://cloudready-free-downloads.neverware.com/";
-  const auto path = QString::fromUtf8(reply->readAll());
-  return QUrl(base + path.trimmed());
+static const char cdnBase[] =
+    "https://cloudready-free-downloads.neverware.com/";
+static const char s3Base[] =
+    "https://s3.amazonaws.com/neverware-cloudready-free-releases/";
+
+// Every base URL the image can be downloaded from. Extra mirrors, such
+// as an on-premise cache, can be listed comma separated in
+// THORIUMOS_USB_MAKER_MIRRORS.
+static QStringList getMirrorBases() {
+  QStringList bases;
+  const QString extra =
+      QString::fromLocal8Bit(qgetenv("THORIUMOS_USB_MAKER_MIRRORS"));
+  for (QString base : extra.split(',', QString::SkipEmptyParts)) {
+    base = base.trimmed();
+    if (!base.endsWith('/')) {
+      base += '/';
+    }
+    bases << base;
+  }
+  bases << cdnBase << s3Base;
+  return bases;
 }
 
 void NewestImageUrl::fetch() {
-  QString baseUrl(
-      "https://s3.amazonaws.com/neverware-cloudready-free-releases/");
   // for the free version, we have to find out what the url is
-  connect(&networkManager, &QNetworkAccessManager::finished, this,
-          &NewestImageUrl::handleReply);
-  networkManager.get(QNetworkRequest(QUrl(baseUrl + "latest-stable-64bit")));
+  QNetworkReply* reply = gondar::GetNetworkManager()->get(
+      gondar::CreateRequest(QUrl(QString(s3Base) + "latest-stable-64bit")));
+  connect(reply, &QNetworkReply::finished, this,
+          [this, reply]() { handleReply(reply); });
 }
 
 void NewestImageUrl::handleReply(QNetworkReply* reply) {
+  reply->deleteLater();
   const auto error = reply->error();
   if (error != QNetworkReply::NoError) {
     LOG_ERROR << "Error retrieving ThoriumOS download URL";
     emit errorOccurred();
     return;
   }
-  // we find out which request this is a response for
-  QUrl url = getLatestUrl(reply);
-  sixtyFourUrl = url;
-  LOG_INFO << "using latest url: " << url;
-  reply->deleteLater();
+  const QString path = QString::fromUtf8(reply->readAll()).trimmed();
+  mirrors.clear();
+  for (const QString& base : getMirrorBases()) {
+    mirrors << QUrl(base + path);
+  }
+  sixtyFourUrl = QUrl(cdnBase + path);
+  LOG_INFO << "using latest url: " << sixtyFourUrl;
+  emit ready();
 }
 
 void NewestImageUrl::set64Url(const QUrl& url_in) {
   sixtyFourUrl = url_in;
+  mirrors = {url_in};
 }
 
 bool NewestImageUrl::isReady() const {
@@ -65,3 +88,7 @@ bool NewestImageUrl::isReady() const {
 const QUrl& NewestImageUrl::get64Url() const {
   return sixtyFourUrl;
 }
+
+const QList<QUrl>& NewestImageUrl::get64Mirrors() const {
+  return mirrors;
+}
@@ -16,6 +16,7 @@
 #ifndef SRC_NEWEST_IMAGE_URL_H_
 #define SRC_NEWEST_IMAGE_URL_H_
 
+#include <QList>
 #include <QNetworkReply>
 #include <QUrl>
 
@@ -27,15 +28,18 @@ class NewestImageUrl : public QObject {
   bool isReady() const;
   void set64Url(const QUrl& url_in);
   const QUrl& get64Url() const;
+  // Every URL the image can be downloaded from, including get64Url()
+  const QList<QUrl>& get64Mirrors() const;
  signals:
   void errorOccurred();
+  void ready();
 
  protected:
   void handleReply(QNetworkReply* reply);
 
  private:
-  QNetworkAccessManager networkManager;
   QUrl sixtyFourUrl;
+  QList<QUrl> mirrors;
 };
 
 #endif  // SRC_NEWEST_IMAGE_URL_H_
@@ -0,0 +1,437 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "peer_cache.h"
+
+#include <sys/types.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkInterface>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QThread>
+#ifndef _WIN32
+#include <sys/select.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+#include <microhttpd.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "log.h"
+#include "sidecar_check.h"
+#include "task_pool.h"
+
+namespace gondar {
+
+namespace {
+
+const char query_magic[] = "thoriumos-usb-maker peer?";
+const char answer_magic[] = "thoriumos-usb-maker peer!";
+const char sidecar_suffix[] = ".sha256";
+
+// Big enough to keep a gigabit link busy from one request thread
+const size_t file_block_size = 1024 * 1024;
+
+// MHD_HTTP_REQUESTED_RANGE_NOT_SATISFIABLE was renamed in newer
+// libmicrohttpd releases
+const unsigned int http_range_not_satisfiable = 416;
+
+// Per-response state for a file download
+struct FileStream {
+  QFile file;
+};
+
+ssize_t read_file(void* cls, uint64_t pos, char* buf, size_t max) {
+  (void)pos; /* Unused. Reads are sequential from the range start. */
+  auto* stream = static_cast<FileStream*>(cls);
+  const qint64 count = stream->file.read(buf, static_cast<qint64>(max));
+  if (count < 0) {
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  }
+  if (count == 0) {
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  }
+  return static_cast<ssize_t>(count);
+}
+
+void free_file_stream(void* cls) {
+  delete static_cast<FileStream*>(cls);
+}
+
+int send_text(struct MHD_Connection* connection,
+              unsigned int status,
+              const QByteArray& body) {
+  struct MHD_Response* response = MHD_create_response_from_buffer(
+      body.size(), (void*)body.constData(), MHD_RESPMEM_MUST_COPY);
+  if (!response)
+    return MHD_NO;
+  MHD_add_response_header(response, "Content-Type", "text/plain");
+  const int ret = MHD_queue_response(connection, status, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+// Parse a "bytes=first-last" or "bytes=first-" header against a file
+// of |size| bytes. Suffix ranges and multiple ranges are not used by
+// DownloadManager and are refused.
+bool parse_range(const char* header,
+                 const qint64 size,
+                 qint64* first,
+                 qint64* last) {
+  const QByteArray value(header);
+  if (!value.startsWith("bytes=") || value.contains(',')) {
+    return false;
+  }
+  const QList<QByteArray> bounds = value.mid(6).split('-');
+  if (bounds.size() != 2 || bounds[0].isEmpty()) {
+    return false;
+  }
+  bool ok = false;
+  *first = bounds[0].toLongLong(&ok);
+  if (!ok || *first >= size) {
+    return false;
+  }
+  *last = size - 1;
+  if (!bounds[1].isEmpty()) {
+    *last = std::min(*last, bounds[1].toLongLong(&ok));
+    if (!ok || *last < *first) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int send_file(struct MHD_Connection* connection,
+              const PeerCache::SharedFile& shared) {
+  auto stream = std::make_unique<FileStream>();
+  stream->file.setFileName(shared.path);
+  if (!stream->file.open(QIODevice::ReadOnly)) {
+    return send_text(connection, MHD_HTTP_NOT_FOUND, "not found");
+  }
+
+  qint64 first = 0;
+  qint64 last = shared.size - 1;
+  const char* range = MHD_lookup_connection_value(
+      connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_RANGE);
+  if (range && !parse_range(range, shared.size, &first, &last)) {
+    return send_text(connection, http_range_not_satisfiable, "bad range");
+  }
+  stream->file.seek(first);
+
+  struct MHD_Response* response = MHD_create_response_from_callback(
+      static_cast<uint64_t>(last - first + 1), file_block_size, &read_file,
+      stream.get(), &free_file_stream);
+  if (!response) {
+    return MHD_NO;
+  }
+  stream.release();
+  MHD_add_response_header(response, "Content-Type",
+                          "application/octet-stream");
+  MHD_add_response_header(response, "Accept-Ranges", "bytes");
+  unsigned int status = MHD_HTTP_OK;
+  if (range) {
+    status = MHD_HTTP_PARTIAL_CONTENT;
+    const QByteArray content_range =
+        "bytes " + QByteArray::number(first) + "-" +
+        QByteArray::number(last) + "/" + QByteArray::number(shared.size);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_RANGE,
+                            content_range.constData());
+  }
+  const int ret = MHD_queue_response(connection, status, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+int answer_to_connection(void* cls,
+                         struct MHD_Connection* connection,
+                         const char* url,
+                         const char* method,
+                         const char* version,
+                         const char* upload_data,
+                         size_t* upload_data_size,
+                         void** con_cls) {
+  (void)version;          /* Unused. Silence compiler warning. */
+  (void)upload_data;      /* Unused. Silence compiler warning. */
+  (void)upload_data_size; /* Unused. Silence compiler warning. */
+  (void)con_cls;          /* Unused. Silence compiler warning. */
+  auto* cache = static_cast<PeerCache*>(cls);
+
+  if (strcmp(method, "GET") != 0) {
+    return send_text(connection, MHD_HTTP_METHOD_NOT_ALLOWED, "use GET");
+  }
+  const QStringList parts =
+      QString::fromUtf8(url).split('/', QString::SkipEmptyParts);
+  if (parts.size() != 2 || parts[0] != "images") {
+    return send_text(connection, MHD_HTTP_NOT_FOUND, "not found");
+  }
+
+  QString name = parts[1];
+  const bool want_hash = name.endsWith(sidecar_suffix);
+  if (want_hash) {
+    name.chop(static_cast<int>(strlen(sidecar_suffix)));
+  }
+  const auto shared = cache->find(name);
+  if (!shared) {
+    return send_text(connection, MHD_HTTP_NOT_FOUND, "not found");
+  }
+  if (want_hash) {
+    return send_text(connection, MHD_HTTP_OK, shared->sha256);
+  }
+  return send_file(connection, *shared);
+}
+
+// Read one datagram from |socket|
+QByteArray readDatagram(QUdpSocket* socket,
+                        QHostAddress* sender,
+                        quint16* port) {
+  QByteArray data(static_cast<int>(socket->pendingDatagramSize()), 0);
+  const qint64 size = socket->readDatagram(data.data(), data.size(), sender,
+                                           port);
+  data.resize(static_cast<int>(std::max<qint64>(0, size)));
+  return data;
+}
+
+}  // namespace
+
+PeerCache::PeerCache(const QDir& dir) : dir_(dir) {
+  connect(&socket_, &QUdpSocket::readyRead, this, &PeerCache::answerLookups);
+}
+
+PeerCache::~PeerCache() {
+  stop();
+}
+
+PeerCache* PeerCache::instance() {
+  // where DownloadManager saves
+  static PeerCache cache(
+      QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
+  return &cache;
+}
+
+bool PeerCache::start(const int http_port, const int lookup_port) {
+  if (daemon_ != nullptr) {
+    return true;
+  }
+
+  // Downloads are large and slow to send, so spread them over a pool
+  // of threads like the station server does
+  const unsigned int pool_size =
+      static_cast<unsigned int>(std::max(4, QThread::idealThreadCount()));
+  daemon_ = MHD_start_daemon(
+      MHD_USE_SELECT_INTERNALLY, static_cast<uint16_t>(http_port), nullptr,
+      nullptr, &answer_to_connection, this, MHD_OPTION_THREAD_POOL_SIZE,
+      pool_size, MHD_OPTION_END);
+  if (daemon_ == nullptr) {
+    LOG_ERROR << "failed to start peer cache on port " << http_port;
+    return false;
+  }
+  const union MHD_DaemonInfo* info =
+      MHD_get_daemon_info(daemon_, MHD_DAEMON_INFO_BIND_PORT);
+  http_port_ = info ? info->port : http_port;
+
+  if (!socket_.bind(QHostAddress::AnyIPv4, static_cast<quint16>(lookup_port),
+                    QUdpSocket::ShareAddress)) {
+    // still useful to anyone who is told the address
+    LOG_WARNING << "peer cache can't answer lookups: "
+                << socket_.errorString();
+  }
+
+  loadSidecars();
+  LOG_INFO << "peer cache serving " << dir_.absolutePath() << " on port "
+           << http_port_;
+  return true;
+}
+
+void PeerCache::stop() {
+  socket_.close();
+  if (daemon_ == nullptr) {
+    return;
+  }
+  MHD_stop_daemon(daemon_);
+  daemon_ = nullptr;
+}
+
+bool PeerCache::isRunning() const {
+  return daemon_ != nullptr;
+}
+
+int PeerCache::httpPort() const {
+  return http_port_;
+}
+
+int PeerCache::lookupPort() const {
+  return socket_.localPort();
+}
+
+void PeerCache::share(const QString& path, const QByteArray& sha256) {
+  if (!isRunning()) {
+    return;
+  }
+  if (QFileInfo(path).absoluteDir() != QDir(dir_.absolutePath())) {
+    LOG_WARNING << "not sharing " << path << ", it is outside the cache";
+    return;
+  }
+  if (!sha256.isEmpty()) {
+    addFile(path, sha256);
+    return;
+  }
+  // addFile() is thread-safe
+  TaskPool::instance()->submit([this, path]() {
+    const QByteArray hash = Sha256File(path);
+    if (!hash.isEmpty()) {
+      addFile(path, hash);
+    }
+  });
+}
+
+void PeerCache::unshare(const QString& path) {
+  const QFileInfo info(path);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.erase(info.fileName());
+  }
+  QFile::remove(Sha256SidecarPath(info.filePath()));
+}
+
+Option<PeerCache::SharedFile> PeerCache::find(const QString& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = files_.find(name);
+  if (iter == files_.end()) {
+    return nullopt;
+  }
+  return iter->second;
+}
+
+void PeerCache::addFile(const QString& path, const QByteArray& sha256) {
+  const QFileInfo info(path);
+  WriteSha256Sidecar(path, sha256);
+
+  SharedFile shared;
+  shared.path = info.absoluteFilePath();
+  shared.size = info.size();
+  shared.sha256 = sha256;
+  LOG_INFO << "peer cache sharing " << shared.path;
+  std::lock_guard<std::mutex> lock(mutex_);
+  files_[info.fileName()] = shared;
+}
+
+void PeerCache::loadSidecars() {
+  const QStringList sidecars =
+      dir_.entryList({QString("*") + sidecar_suffix}, QDir::Files);
+  for (const QString& name : sidecars) {
+    const QString path = dir_.filePath(
+        name.left(name.size() - static_cast<int>(strlen(sidecar_suffix))));
+    const QByteArray sha256 = ReadSha256Sidecar(path);
+    if (!sha256.isEmpty() && QFileInfo(path).isFile()) {
+      SharedFile shared;
+      shared.path = path;
+      shared.size = QFileInfo(path).size();
+      shared.sha256 = sha256;
+      std::lock_guard<std::mutex> lock(mutex_);
+      files_[QFileInfo(path).fileName()] = shared;
+    }
+  }
+}
+
+void PeerCache::answerLookups() {
+  while (socket_.hasPendingDatagrams()) {
+    QHostAddress sender;
+    quint16 sender_port = 0;
+    const QList<QByteArray> lines =
+        readDatagram(&socket_, &sender, &sender_port).split('\n');
+    if (lines.size() != 2 || lines[0] != query_magic) {
+      continue;
+    }
+    const QString name = QString::fromUtf8(lines[1]);
+    const auto shared = find(name);
+    if (!shared) {
+      continue;
+    }
+    QByteArray answer(answer_magic);
+    answer += "\n" + lines[1] + "\n" + QByteArray::number(http_port_) +
+              "\n" + shared->sha256;
+    socket_.writeDatagram(answer, sender, sender_port);
+  }
+}
+
+PeerLookup::PeerLookup(QObject* parent) : QObject(parent) {
+  timeout_.setSingleShot(true);
+  connect(&timeout_, &QTimer::timeout, this, [this]() {
+    socket_.close();
+    LOG_INFO << "found " << peers_.size() << " peers sharing " << name_;
+    emit finished();
+  });
+  connect(&socket_, &QUdpSocket::readyRead, this, &PeerLookup::readAnswers);
+}
+
+void PeerLookup::start(const QString& name,
+                       const int port,
+                       const int timeout_ms) {
+  name_ = name;
+  peers_.clear();
+  socket_.bind(QHostAddress::AnyIPv4, 0);
+  const QByteArray query = QByteArray(query_magic) + "\n" + name.toUtf8();
+  for (const auto& iface : QNetworkInterface::allInterfaces()) {
+    for (const auto& entry : iface.addressEntries()) {
+      if (!entry.broadcast().isNull()) {
+        socket_.writeDatagram(query, entry.broadcast(),
+                              static_cast<quint16>(port));
+      }
+    }
+  }
+  timeout_.start(timeout_ms);
+}
+
+const QList<PeerLookup::Peer>& PeerLookup::peers() const {
+  return peers_;
+}
+
+void PeerLookup::readAnswers() {
+  while (socket_.hasPendingDatagrams()) {
+    QHostAddress sender;
+    quint16 sender_port = 0;
+    const QList<QByteArray> lines =
+        readDatagram(&socket_, &sender, &sender_port).split('\n');
+    if (lines.size() != 4 || lines[0] != answer_magic ||
+        QString::fromUtf8(lines[1]) != name_) {
+      continue;
+    }
+    const QHostAddress host(sender.toIPv4Address());
+    // our own cache hears the broadcast too, but the file it would
+    // offer is the one about to be overwritten
+    if (QNetworkInterface::allAddresses().contains(host)) {
+      continue;
+    }
+    Peer peer;
+    peer.url = QUrl(QString("http://%1:%2/images/%3")
+                        .arg(host.toString(), QString(lines[2]), name_));
+    peer.sha256 = lines[3];
+    const bool seen = std::any_of(
+        peers_.begin(), peers_.end(),
+        [&peer](const Peer& other) { return other.url == peer.url; });
+    if (!seen) {
+      LOG_INFO << "peer " << peer.url << " shares " << name_;
+      peers_ << peer;
+    }
+  }
+}
+
+}  // namespace gondar
@@ -0,0 +1,138 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_PEER_CACHE_H_
+#define SRC_PEER_CACHE_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QUrl>
+#include <map>
+#include <mutex>
+
+#include "option.h"
+
+struct MHD_Daemon;
+
+namespace gondar {
+
+// Optional LAN sharing of downloaded images, so that a shop with many
+// stations pulls each image over the WAN once. A station with the
+// cache running serves every image it has downloaded over HTTP, with
+// range support, and answers UDP broadcasts from stations looking for
+// one (see PeerLookup). Each shared file has a sha256sum-style sidecar
+// next to it, which is also how shared files are found again on the
+// next run.
+//
+//   GET /images/<name>         the file; honours Range
+//   GET /images/<name>.sha256  its hex SHA-256
+class PeerCache : public QObject {
+  Q_OBJECT
+
+ public:
+  static const int default_http_port = 8342;
+  static const int discovery_port = 8343;
+
+  struct SharedFile {
+    QString path;
+    qint64 size = 0;
+    QByteArray sha256;
+  };
+
+  // Shares files from |dir|
+  explicit PeerCache(const QDir& dir);
+  ~PeerCache();
+
+  // The cache for the download directory
+  static PeerCache* instance();
+
+  // Serve on every interface on |http_port| and answer lookups on
+  // |lookup_port|; either may be 0 to have the system pick one. Returns
+  // false if the HTTP server could not start.
+  bool start(int http_port = default_http_port,
+             int lookup_port = discovery_port);
+  void stop();
+  bool isRunning() const;
+  // The ports actually in use while running
+  int httpPort() const;
+  int lookupPort() const;
+
+  // Start sharing |path|, which must be in the cache's directory.
+  // |sha256| is computed if not given. Does nothing unless running.
+  void share(const QString& path, const QByteArray& sha256 = QByteArray());
+  // Stop sharing |path|, for instance because it is about to be
+  // overwritten
+  void unshare(const QString& path);
+
+  // Thread-safe; called from the request threads
+  Option<SharedFile> find(const QString& name);
+
+ private:
+  void addFile(const QString& path, const QByteArray& sha256);
+  void loadSidecars();
+  void answerLookups();
+
+  const QDir dir_;
+  struct MHD_Daemon* daemon_ = nullptr;
+  int http_port_ = 0;
+  QUdpSocket socket_;
+
+  std::mutex mutex_;
+  std::map<QString, SharedFile> files_;
+};
+
+// Asks the LAN which peers share a file. Broadcasts a query, collects
+// the answers for a short while, then emits finished().
+class PeerLookup : public QObject {
+  Q_OBJECT
+
+ public:
+  struct Peer {
+    QUrl url;
+    QByteArray sha256;
+  };
+
+  explicit PeerLookup(QObject* parent = nullptr);
+
+  // Look for |name|, sending the query to |port| on each interface's
+  // broadcast address. Gives up after |timeout_ms|.
+  void start(const QString& name,
+             int port = PeerCache::discovery_port,
+             int timeout_ms = 500);
+  // Peers that answered, in the order they did, each with the hash it
+  // claims. Anyone on the LAN can answer, so check the hashes against
+  // one from a trusted source before using a peer.
+  const QList<Peer>& peers() const;
+
+ signals:
+  void finished();
+
+ private:
+  void readAnswers();
+
+  QString name_;
+  QUdpSocket socket_;
+  QTimer timeout_;
+  QList<Peer> peers_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_PEER_CACHE_H_
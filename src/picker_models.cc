@@ -0,0 +1,78 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "picker_models.h"
+
+namespace gondar {
+
+SiteListModel::SiteListModel(QObject* parent) : QAbstractListModel(parent) {}
+
+void SiteListModel::setSites(const std::vector<GondarSite>& sites) {
+  beginResetModel();
+  sites_ = sites;
+  endResetModel();
+}
+
+const GondarSite& SiteListModel::site(const int row) const {
+  return sites_.at(row);
+}
+
+int SiteListModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(sites_.size());
+}
+
+QVariant SiteListModel::data(const QModelIndex& index, const int role) const {
+  if (!index.isValid() || role != Qt::DisplayRole) {
+    return QVariant();
+  }
+  return site(index.row()).getSiteName();
+}
+
+ImageListModel::ImageListModel(QObject* parent) : QAbstractListModel(parent) {}
+
+void ImageListModel::addImages(const QList<GondarImage>& images) {
+  std::vector<GondarImage> listed;
+  for (const auto& image : images) {
+    if (!image.isDeployable()) {
+      listed.push_back(image);
+    }
+  }
+  if (listed.empty()) {
+    return;
+  }
+  const int first = static_cast<int>(images_.size());
+  beginInsertRows(QModelIndex(), first,
+                  first + static_cast<int>(listed.size()) - 1);
+  images_.insert(images_.end(), listed.begin(), listed.end());
+  endInsertRows();
+}
+
+const GondarImage& ImageListModel::image(const int row) const {
+  return images_.at(row);
+}
+
+int ImageListModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(images_.size());
+}
+
+QVariant ImageListModel::data(const QModelIndex& index,
+                              const int role) const {
+  if (!index.isValid() || role != Qt::DisplayRole) {
+    return QVariant();
+  }
+  return image(index.row()).getCompositeName();
+}
+
+}  // namespace gondar
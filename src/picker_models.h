@@ -0,0 +1,64 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_PICKER_MODELS_H_
+#define SRC_PICKER_MODELS_H_
+
+#include <QAbstractListModel>
+#include <vector>
+
+#include "gondarimage.h"
+#include "gondarsite.h"
+
+namespace gondar {
+
+// Sites for SiteSelectPage, displayed by name
+class SiteListModel : public QAbstractListModel {
+  Q_OBJECT
+
+ public:
+  explicit SiteListModel(QObject* parent = nullptr);
+
+  void setSites(const std::vector<GondarSite>& sites);
+  const GondarSite& site(int row) const;
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex& index, int role) const override;
+
+ private:
+  std::vector<GondarSite> sites_;
+};
+
+// Images for ImageSelectPage, displayed by product and name.
+// Deployable images are never listed.
+class ImageListModel : public QAbstractListModel {
+  Q_OBJECT
+
+ public:
+  explicit ImageListModel(QObject* parent = nullptr);
+
+  void addImages(const QList<GondarImage>& images);
+  const GondarImage& image(int row) const;
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex& index, int role) const override;
+
+ private:
+  std::vector<GondarImage> images_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_PICKER_MODELS_H_
@@ -0,0 +1,441 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pipeline.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "log.h"
+#include "trace.h"
+
+namespace gondar {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsedMs(const Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                               start)
+      .count();
+}
+
+void logStats(const StageStats& stats) {
+  LOG_INFO << "pipeline stage " << stats.name << ": " << stats.buffers
+           << " buffers, " << stats.bytes << " bytes, busy " << stats.busy_ms
+           << " ms, input stall " << stats.input_stall_ms
+           << " ms, output stall " << stats.output_stall_ms
+           << " ms, queued avg " << stats.average_queued << " peak "
+           << stats.peak_queued;
+}
+
+}  // namespace
+
+std::shared_ptr<Buffer> Buffer::create(const size_t capacity) {
+  size_t rounded = 0;
+  uint8_t* data = BufferPool::instance()->acquire(capacity, &rounded);
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  return std::shared_ptr<Buffer>(new Buffer(data, rounded));
+}
+
+Buffer::Buffer(uint8_t* data, const size_t capacity)
+    : data_(data), capacity_(capacity) {}
+
+Buffer::~Buffer() {
+  BufferPool::instance()->release(data_, capacity_);
+}
+
+void Buffer::setSize(const size_t size) {
+  if (size > capacity_) {
+    throw std::length_error("buffer size exceeds capacity");
+  }
+  size_ = size;
+}
+
+BufferQueue::BufferQueue(const size_t capacity)
+    : capacity_(std::max<size_t>(1, capacity)) {}
+
+bool BufferQueue::push(BufferRef buffer, int64_t* stall_ms) {
+  const auto start = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this]() {
+    return buffers_.size() < capacity_ || aborted_;
+  });
+  *stall_ms += elapsedMs(start);
+  if (aborted_) {
+    return false;
+  }
+  buffers_.push_back(std::move(buffer));
+  changed_.notify_all();
+  return true;
+}
+
+bool BufferQueue::pop(BufferRef* buffer, int64_t* stall_ms) {
+  const auto start = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this]() {
+    return !buffers_.empty() || closed_ || aborted_;
+  });
+  *stall_ms += elapsedMs(start);
+  if (aborted_ || buffers_.empty()) {
+    return false;
+  }
+  pops_++;
+  queued_sum_ += buffers_.size();
+  peak_queued_ = std::max(peak_queued_, buffers_.size());
+  *buffer = std::move(buffers_.front());
+  buffers_.pop_front();
+  changed_.notify_all();
+  return true;
+}
+
+void BufferQueue::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  changed_.notify_all();
+}
+
+void BufferQueue::abort() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  aborted_ = true;
+  buffers_.clear();
+  changed_.notify_all();
+}
+
+double BufferQueue::averageQueued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pops_ ? static_cast<double>(queued_sum_) / pops_ : 0;
+}
+
+size_t BufferQueue::peakQueued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_queued_;
+}
+
+Stage::Stage(const std::string& name) : name_(name) {}
+
+Stage::~Stage() {}
+
+bool Transform::finish(BufferRef* output) {
+  output->reset();
+  return true;
+}
+
+bool Sink::finish() {
+  return true;
+}
+
+struct FileSource::Impl {
+  QFile file;
+  size_t buffer_size = 0;
+  uint64_t offset = 0;
+};
+
+FileSource::FileSource(const QString& path, const size_t buffer_size)
+    : Source("read " + QFileInfo(path).fileName().toStdString()),
+      impl_(new Impl) {
+  impl_->file.setFileName(path);
+  impl_->buffer_size = buffer_size;
+}
+
+FileSource::~FileSource() {}
+
+bool FileSource::read(BufferRef* buffer) {
+  QFile& file = impl_->file;
+  if (!file.isOpen() &&
+      !file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+    LOG_ERROR << "failed to open " << file.fileName() << ": "
+              << file.errorString();
+    return false;
+  }
+
+  std::shared_ptr<Buffer> block;
+  try {
+    block = Buffer::create(impl_->buffer_size);
+  } catch (const std::bad_alloc&) {
+    LOG_ERROR << "no buffer available to read " << file.fileName();
+    return false;
+  }
+  size_t filled = 0;
+  while (filled < impl_->buffer_size) {
+    const qint64 count =
+        file.read(reinterpret_cast<char*>(block->data()) + filled,
+                  impl_->buffer_size - filled);
+    if (count < 0) {
+      LOG_ERROR << "failed to read " << file.fileName() << ": "
+                << file.errorString();
+      return false;
+    }
+    if (count == 0) {
+      break;
+    }
+    filled += static_cast<size_t>(count);
+  }
+
+  if (filled == 0) {
+    buffer->reset();
+    return true;
+  }
+  block->setSize(filled);
+  block->setOffset(impl_->offset);
+  impl_->offset += filled;
+  *buffer = std::move(block);
+  return true;
+}
+
+struct FileSink::Impl {
+  QFile file;
+};
+
+FileSink::FileSink(const QString& path)
+    : Sink("write " + QFileInfo(path).fileName().toStdString()),
+      impl_(new Impl) {
+  impl_->file.setFileName(path);
+}
+
+FileSink::~FileSink() {}
+
+bool FileSink::open() {
+  QFile& file = impl_->file;
+  if (!file.isOpen() &&
+      !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG_ERROR << "failed to open " << file.fileName() << ": "
+              << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool FileSink::write(const BufferRef& buffer) {
+  if (!open()) {
+    return false;
+  }
+  QFile& file = impl_->file;
+  const auto size = static_cast<qint64>(buffer->size());
+  if (file.write(reinterpret_cast<const char*>(buffer->data()), size) !=
+      size) {
+    LOG_ERROR << "failed to write " << file.fileName() << ": "
+              << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool FileSink::finish() {
+  // An empty stream still makes an empty file
+  if (!open()) {
+    return false;
+  }
+  QFile& file = impl_->file;
+  if (!file.flush()) {
+    LOG_ERROR << "failed to write " << file.fileName() << ": "
+              << file.errorString();
+    return false;
+  }
+  file.close();
+  return true;
+}
+
+Pipeline::Pipeline(const size_t queue_capacity)
+    : queue_capacity_(queue_capacity) {}
+
+Pipeline::~Pipeline() {}
+
+void Pipeline::setSource(std::unique_ptr<Source> source) {
+  source_ = std::move(source);
+}
+
+void Pipeline::addTransform(std::unique_ptr<Transform> transform) {
+  transforms_.push_back(std::move(transform));
+}
+
+void Pipeline::addSink(std::unique_ptr<Sink> sink) {
+  sinks_.push_back(std::move(sink));
+}
+
+bool Pipeline::run() {
+  if (!source_ || sinks_.empty()) {
+    LOG_ERROR << "pipeline needs a source and at least one sink";
+    return false;
+  }
+
+  // inputs[i] feeds stage i + 1, where stage 0 is the source, then
+  // come the transforms, then the sinks
+  const size_t stage_count = 1 + transforms_.size() + sinks_.size();
+  std::vector<std::unique_ptr<BufferQueue>> inputs;
+  for (size_t i = 1; i < stage_count; i++) {
+    inputs.emplace_back(new BufferQueue(queue_capacity_));
+  }
+  const size_t first_sink = 1 + transforms_.size();
+
+  // The queues stage |index| pushes into
+  auto outputsOf = [&](const size_t index) {
+    std::vector<BufferQueue*> outputs;
+    if (index + 1 < first_sink) {
+      outputs.push_back(inputs[index].get());
+    } else {
+      for (size_t sink = first_sink; sink < stage_count; sink++) {
+        outputs.push_back(inputs[sink - 1].get());
+      }
+    }
+    return outputs;
+  };
+
+  stats_.assign(stage_count, StageStats());
+  stats_[0].name = source_->name();
+  for (size_t i = 0; i < transforms_.size(); i++) {
+    stats_[1 + i].name = transforms_[i]->name();
+  }
+  for (size_t i = 0; i < sinks_.size(); i++) {
+    stats_[first_sink + i].name = sinks_[i]->name();
+  }
+
+  std::atomic<bool> failed{false};
+  auto fail = [&](const size_t index) {
+    LOG_ERROR << "pipeline stage " << stats_[index].name << " failed";
+    failed = true;
+    for (auto& queue : inputs) {
+      queue->abort();
+    }
+  };
+
+  // Hand |buffer| to every output of stage |index|. Returns false if
+  // the pipeline was aborted.
+  auto emitBuffer = [&](const size_t index, const BufferRef& buffer) {
+    for (auto* output : outputsOf(index)) {
+      if (!output->push(buffer, &stats_[index].output_stall_ms)) {
+        return false;
+      }
+    }
+    stats_[index].buffers++;
+    stats_[index].bytes += buffer->size();
+    return true;
+  };
+
+  auto closeOutputs = [&](const size_t index) {
+    for (auto* output : outputsOf(index)) {
+      output->close();
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]() {
+    while (!failed) {
+      BufferRef buffer;
+      const auto start = Clock::now();
+      Trace::begin("pipeline", stats_[0].name.c_str());
+      const bool ok = source_->read(&buffer);
+      Trace::end("pipeline", stats_[0].name.c_str());
+      stats_[0].busy_ms += elapsedMs(start);
+      if (!ok) {
+        fail(0);
+        return;
+      }
+      if (!buffer) {
+        break;
+      }
+      if (!emitBuffer(0, buffer)) {
+        return;
+      }
+    }
+    closeOutputs(0);
+  });
+
+  for (size_t i = 0; i < transforms_.size(); i++) {
+    const size_t index = 1 + i;
+    threads.emplace_back([&, i, index]() {
+      Transform& transform = *transforms_[i];
+      BufferRef input;
+      while (inputs[i]->pop(&input, &stats_[index].input_stall_ms)) {
+        BufferRef output;
+        const auto start = Clock::now();
+        Trace::begin("pipeline", stats_[index].name.c_str());
+        const bool ok = transform.transform(input, &output);
+        Trace::end("pipeline", stats_[index].name.c_str());
+        stats_[index].busy_ms += elapsedMs(start);
+        if (!ok) {
+          fail(index);
+          return;
+        }
+        if (output && !emitBuffer(index, output)) {
+          return;
+        }
+      }
+      if (failed) {
+        return;
+      }
+      BufferRef output;
+      if (!transform.finish(&output)) {
+        fail(index);
+        return;
+      }
+      if (output && !emitBuffer(index, output)) {
+        return;
+      }
+      closeOutputs(index);
+    });
+  }
+
+  for (size_t i = 0; i < sinks_.size(); i++) {
+    const size_t index = first_sink + i;
+    threads.emplace_back([&, i, index]() {
+      Sink& sink = *sinks_[i];
+      BufferQueue& input = *inputs[index - 1];
+      BufferRef buffer;
+      while (input.pop(&buffer, &stats_[index].input_stall_ms)) {
+        const auto start = Clock::now();
+        Trace::begin("pipeline", stats_[index].name.c_str());
+        const bool ok = sink.write(buffer);
+        Trace::end("pipeline", stats_[index].name.c_str());
+        stats_[index].busy_ms += elapsedMs(start);
+        if (!ok) {
+          fail(index);
+          return;
+        }
+        stats_[index].buffers++;
+        stats_[index].bytes += buffer->size();
+      }
+      if (!failed && !sink.finish()) {
+        fail(index);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 1; i < stage_count; i++) {
+    stats_[i].average_queued = inputs[i - 1]->averageQueued();
+    stats_[i].peak_queued = inputs[i - 1]->peakQueued();
+  }
+  for (const auto& stats : stats_) {
+    logStats(stats);
+  }
+
+  return !failed;
+}
+
+}  // namespace gondar
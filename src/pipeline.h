@@ -0,0 +1,226 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_PIPELINE_H_
+#define SRC_PIPELINE_H_
+
+#include <QString>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer_pool.h"
+
+namespace gondar {
+
+// A block of the data stream. Stages hand buffers to each other by
+// reference, never by copy: once a buffer has been pushed downstream
+// it is shared read-only, which is what lets one buffer be fanned out
+// to several sinks.
+class Buffer {
+ public:
+  // Takes a block of at least |capacity| bytes from the BufferPool and
+  // gives it back on destruction. Throws std::bad_alloc if the pool is
+  // out of budget.
+  static std::shared_ptr<Buffer> create(size_t capacity);
+  ~Buffer();
+
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  size_t capacity() const { return capacity_; }
+
+  // Bytes of valid data, starting at data()
+  size_t size() const { return size_; }
+  void setSize(size_t size);
+
+  // Where the data sits in the overall stream
+  uint64_t offset() const { return offset_; }
+  void setOffset(uint64_t offset) { offset_ = offset; }
+
+ private:
+  Buffer(uint8_t* data, size_t capacity);
+
+  uint8_t* const data_;
+  const size_t capacity_;
+  size_t size_ = 0;
+  uint64_t offset_ = 0;
+};
+
+using BufferRef = std::shared_ptr<const Buffer>;
+
+// What a stage spent its time on. A stage that is mostly busy is the
+// bottleneck; the stages upstream of it stall on output and the ones
+// downstream stall on input.
+struct StageStats {
+  std::string name;
+  uint64_t buffers = 0;
+  uint64_t bytes = 0;
+  int64_t busy_ms = 0;
+  // Waiting for the stage upstream to produce something
+  int64_t input_stall_ms = 0;
+  // Waiting for a full queue downstream to drain
+  int64_t output_stall_ms = 0;
+  // Average and peak number of buffers waiting in the stage's input
+  // queue, sampled on every pop
+  double average_queued = 0;
+  size_t peak_queued = 0;
+};
+
+// Bounded queue of buffers between two stages. Any number of threads
+// may push; one thread pops.
+class BufferQueue {
+ public:
+  explicit BufferQueue(size_t capacity);
+
+  // Block until there is room. Returns false if the queue was
+  // aborted. Time spent blocked is added to |*stall_ms|.
+  bool push(BufferRef buffer, int64_t* stall_ms);
+  // Block until a buffer is available. Returns false once the queue
+  // is closed and drained, or aborted.
+  bool pop(BufferRef* buffer, int64_t* stall_ms);
+
+  // No more pushes; pop() drains what is left, then returns false
+  void close();
+  // Give up: wake everyone and drop what is queued
+  void abort();
+
+  double averageQueued() const;
+  size_t peakQueued() const;
+
+ private:
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<BufferRef> buffers_;
+  bool closed_ = false;
+  bool aborted_ = false;
+  uint64_t pops_ = 0;
+  uint64_t queued_sum_ = 0;
+  size_t peak_queued_ = 0;
+};
+
+class Stage {
+ public:
+  explicit Stage(const std::string& name);
+  virtual ~Stage();
+
+  const std::string& name() const { return name_; }
+
+ private:
+  const std::string name_;
+};
+
+// Produces the stream, one buffer at a time
+class Source : public Stage {
+ public:
+  using Stage::Stage;
+  // Set |*buffer| to the next block, or to nullptr at the end of the
+  // stream. Returns false on error.
+  virtual bool read(BufferRef* buffer) = 0;
+};
+
+// Turns each buffer into another one. Stages that only look at the
+// data (hashing, progress) hand the input buffer straight on.
+class Transform : public Stage {
+ public:
+  using Stage::Stage;
+  // Set |*output| to the buffer to pass on, or to nullptr to pass
+  // nothing on for this input. Returns false on error.
+  virtual bool transform(const BufferRef& input, BufferRef* output) = 0;
+  // Called once after the last input. May set |*output| to a final
+  // buffer to flush.
+  virtual bool finish(BufferRef* output);
+};
+
+// Consumes the stream
+class Sink : public Stage {
+ public:
+  using Stage::Stage;
+  virtual bool write(const BufferRef& buffer) = 0;
+  // Called once after the last buffer
+  virtual bool finish();
+};
+
+// Reads a file in |buffer_size| blocks
+class FileSource : public Source {
+ public:
+  FileSource(const QString& path, size_t buffer_size);
+  ~FileSource();
+
+  bool read(BufferRef* buffer) override;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+// Writes the stream to a file in order, replacing what was there
+class FileSink : public Sink {
+ public:
+  explicit FileSink(const QString& path);
+  ~FileSink();
+
+  bool write(const BufferRef& buffer) override;
+  bool finish() override;
+
+ private:
+  bool open();
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+// A source, a chain of transforms and one or more sinks, each stage on
+// its own thread and connected by bounded queues. With several sinks
+// every buffer is handed to all of them.
+//
+// Stages block on I/O and on each other, so they get plain threads
+// rather than TaskPool workers.
+class Pipeline {
+ public:
+  static const size_t default_queue_capacity = 8;
+
+  explicit Pipeline(size_t queue_capacity = default_queue_capacity);
+  ~Pipeline();
+
+  void setSource(std::unique_ptr<Source> source);
+  void addTransform(std::unique_ptr<Transform> transform);
+  void addSink(std::unique_ptr<Sink> sink);
+
+  // Run every stage to completion. If any stage fails the others are
+  // stopped and false is returned.
+  bool run();
+
+  // One entry per stage in stream order, sinks last. Valid after run().
+  const std::vector<StageStats>& stats() const { return stats_; }
+
+ private:
+  const size_t queue_capacity_;
+  std::unique_ptr<Source> source_;
+  std::vector<std::unique_ptr<Transform>> transforms_;
+  std::vector<std::unique_ptr<Sink>> sinks_;
+  std::vector<StageStats> stats_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_PIPELINE_H_
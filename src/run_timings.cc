@@ -0,0 +1,93 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "run_timings.h"
+
+#include <QJsonArray>
+
+namespace gondar {
+
+std::string RunTimings::spanName(const Span span) {
+  switch (span) {
+    case Span::ResolveUrl:
+      return "resolve-url";
+    case Span::Download:
+      return "download";
+    case Span::Verify:
+      return "verify";
+    case Span::Unzip:
+      return "unzip";
+    case Span::Partition:
+      return "partition";
+    case Span::Write:
+      return "write";
+    case Span::Sync:
+      return "sync";
+  }
+  return "unknown";
+}
+
+void RunTimings::start(const Span span) {
+  Entry& entry = entries_[span];
+  entry.timer.start();
+  entry.finished = false;
+}
+
+void RunTimings::finish(const Span span, const uint64_t bytes) {
+  auto it = entries_.find(span);
+  if (it == entries_.end() || !it->second.timer.isValid()) {
+    return;
+  }
+  record(span, it->second.timer.elapsed(), bytes);
+}
+
+void RunTimings::record(const Span span,
+                        const int64_t ms,
+                        const uint64_t bytes) {
+  Entry& entry = entries_[span];
+  entry.finished = true;
+  entry.ms = ms;
+  entry.bytes = bytes;
+}
+
+void RunTimings::setWriteRetries(const uint32_t retries) {
+  write_retries_ = retries;
+}
+
+QJsonObject RunTimings::toJson() const {
+  QJsonArray spans;
+  for (const auto& item : entries_) {
+    const Entry& entry = item.second;
+    if (!entry.finished) {
+      continue;
+    }
+    QJsonObject span;
+    span["name"] = QString::fromStdString(spanName(item.first));
+    span["ms"] = static_cast<qint64>(entry.ms);
+    span["bytes"] = static_cast<qint64>(entry.bytes);
+    if (entry.bytes > 0 && entry.ms > 0) {
+      const double megabytes = entry.bytes / (1024.0 * 1024.0);
+      span["mb_per_s"] = megabytes / (entry.ms / 1000.0);
+    }
+    spans.append(span);
+  }
+
+  QJsonObject json;
+  json["spans"] = spans;
+  json["write_retries"] = static_cast<qint64>(write_retries_);
+  return json;
+}
+
+}  // namespace gondar
@@ -0,0 +1,70 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_RUN_TIMINGS_H_
+#define SRC_RUN_TIMINGS_H_
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace gondar {
+
+// How long each stage of making a USB took and how much data it
+// moved, so that metrics can tell a slow download from a slow stick
+class RunTimings {
+ public:
+  enum class Span {
+    ResolveUrl,
+    Download,
+    Verify,
+    Unzip,
+    Partition,
+    Write,
+    Sync,
+  };
+
+  static std::string spanName(Span span);
+
+  void start(Span span);
+  // Record the time since start(|span|). Does nothing if the span was
+  // never started.
+  void finish(Span span, uint64_t bytes = 0);
+  // Record a span that was timed elsewhere
+  void record(Span span, int64_t ms, uint64_t bytes = 0);
+  void setWriteRetries(uint32_t retries);
+
+  // Only finished spans are included, in pipeline order:
+  // {"spans": [{"name", "ms", "bytes", "mb_per_s"}, ...],
+  //  "write_retries": n}
+  QJsonObject toJson() const;
+
+ private:
+  struct Entry {
+    QElapsedTimer timer;
+    bool finished = false;
+    int64_t ms = 0;
+    uint64_t bytes = 0;
+  };
+
+  std::map<Span, Entry> entries_;
+  uint32_t write_retries_ = 0;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_RUN_TIMINGS_H_
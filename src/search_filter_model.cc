@@ -0,0 +1,153 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "search_filter_model.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace gondar {
+
+void SearchIndex::build(const QStringList& texts) {
+  lowered_.clear();
+  trigrams_.clear();
+  has_last_ = false;
+  lowered_.reserve(texts.size());
+  for (int row = 0; row < texts.size(); row++) {
+    const QString lowered = texts[row].toLower();
+    for (int pos = 0; pos + 3 <= lowered.size(); pos++) {
+      auto& rows = trigrams_[trigram(lowered, pos)];
+      // a trigram can repeat within one text
+      if (rows.empty() || rows.back() != row) {
+        rows.push_back(row);
+      }
+    }
+    lowered_.push_back(lowered);
+  }
+}
+
+std::vector<int> SearchIndex::match(const QString& query) {
+  const QString lowered = query.toLower();
+  const int row_count = static_cast<int>(lowered_.size());
+
+  // Narrow down the rows to check: the previous matches if this query
+  // extends the last one, or the rows holding its rarest trigram,
+  // whichever is smaller
+  std::vector<int> all_rows;
+  const std::vector<int>* candidates = nullptr;
+  if (has_last_ && lowered.contains(last_query_)) {
+    candidates = &last_matches_;
+  }
+  for (int pos = 0; pos + 3 <= lowered.size(); pos++) {
+    const auto iter = trigrams_.find(trigram(lowered, pos));
+    if (iter == trigrams_.end()) {
+      static const std::vector<int> none;
+      candidates = &none;
+      break;
+    }
+    if (!candidates || iter->second.size() < candidates->size()) {
+      candidates = &iter->second;
+    }
+  }
+  if (!candidates) {
+    all_rows.resize(row_count);
+    std::iota(all_rows.begin(), all_rows.end(), 0);
+    candidates = &all_rows;
+  }
+
+  std::vector<int> matches;
+  for (const int row : *candidates) {
+    if (lowered_[row].contains(lowered)) {
+      matches.push_back(row);
+    }
+  }
+
+  has_last_ = true;
+  last_query_ = lowered;
+  last_matches_ = matches;
+  return matches;
+}
+
+uint64_t SearchIndex::trigram(const QString& text, const int pos) {
+  return (static_cast<uint64_t>(text[pos].unicode()) << 32) |
+         (static_cast<uint64_t>(text[pos + 1].unicode()) << 16) |
+         static_cast<uint64_t>(text[pos + 2].unicode());
+}
+
+SearchFilterModel::SearchFilterModel(QObject* parent)
+    : QSortFilterProxyModel(parent) {}
+
+void SearchFilterModel::setSourceModel(QAbstractItemModel* source) {
+  if (sourceModel()) {
+    disconnect(sourceModel(), nullptr, this, nullptr);
+  }
+  QSortFilterProxyModel::setSourceModel(source);
+  if (source) {
+    connect(source, &QAbstractItemModel::modelReset, this,
+            &SearchFilterModel::rebuildIndex);
+    connect(source, &QAbstractItemModel::rowsInserted, this,
+            &SearchFilterModel::rebuildIndex);
+    connect(source, &QAbstractItemModel::rowsRemoved, this,
+            &SearchFilterModel::rebuildIndex);
+    connect(source, &QAbstractItemModel::dataChanged, this,
+            &SearchFilterModel::rebuildIndex);
+  }
+  rebuildIndex();
+}
+
+void SearchFilterModel::setQuery(const QString& query) {
+  if (query == query_) {
+    return;
+  }
+  query_ = query;
+  updateAccepted();
+}
+
+bool SearchFilterModel::filterAcceptsRow(const int source_row,
+                                         const QModelIndex&) const {
+  if (source_row >= static_cast<int>(accepted_.size())) {
+    // a row added since the last rebuild, which is about to happen
+    return true;
+  }
+  return accepted_[source_row];
+}
+
+void SearchFilterModel::rebuildIndex() {
+  QStringList texts;
+  if (QAbstractItemModel* source = sourceModel()) {
+    const int row_count = source->rowCount();
+    texts.reserve(row_count);
+    for (int row = 0; row < row_count; row++) {
+      texts.append(source->index(row, 0).data(Qt::DisplayRole).toString());
+    }
+  }
+  index_.build(texts);
+  updateAccepted();
+}
+
+void SearchFilterModel::updateAccepted() {
+  const int row_count = sourceModel() ? sourceModel()->rowCount() : 0;
+  if (query_.isEmpty()) {
+    accepted_.assign(row_count, 1);
+  } else {
+    accepted_.assign(row_count, 0);
+    for (const int row : index_.match(query_)) {
+      accepted_[row] = 1;
+    }
+  }
+  invalidateFilter();
+}
+
+}  // namespace gondar
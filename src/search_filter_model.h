@@ -0,0 +1,78 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_SEARCH_FILTER_MODEL_H_
+#define SRC_SEARCH_FILTER_MODEL_H_
+
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace gondar {
+
+// Case-insensitive substring search over a fixed list of strings. The
+// strings are lowercased once up front and every three-character
+// sequence in them is indexed, so a query only has to check the rows
+// that share its rarest trigram. A query that extends the previous
+// one only rechecks the previous matches.
+class SearchIndex {
+ public:
+  void build(const QStringList& texts);
+
+  // Rows whose text contains |query|, in row order
+  std::vector<int> match(const QString& query);
+
+ private:
+  static uint64_t trigram(const QString& text, int pos);
+
+  std::vector<QString> lowered_;
+  std::unordered_map<uint64_t, std::vector<int>> trigrams_;
+
+  bool has_last_ = false;
+  QString last_query_;
+  std::vector<int> last_matches_;
+};
+
+// Filter proxy that shows the source rows whose display text contains
+// the query, using a SearchIndex rebuilt whenever the source changes
+class SearchFilterModel : public QSortFilterProxyModel {
+  Q_OBJECT
+
+ public:
+  explicit SearchFilterModel(QObject* parent = nullptr);
+
+  void setSourceModel(QAbstractItemModel* source) override;
+  void setQuery(const QString& query);
+
+ protected:
+  bool filterAcceptsRow(int source_row,
+                        const QModelIndex& source_parent) const override;
+
+ private:
+  void rebuildIndex();
+  void updateAccepted();
+
+  SearchIndex index_;
+  QString query_;
+  // Indexed by source row
+  std::vector<char> accepted_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_SEARCH_FILTER_MODEL_H_
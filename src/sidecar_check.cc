@@ -0,0 +1,119 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "sidecar_check.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+#include "log.h"
+#include "task_pool.h"
+
+namespace gondar {
+
+namespace {
+
+const qint64 hash_block_size = 1024 * 1024;
+
+}  // namespace
+
+QByteArray Sha256File(const QString& path,
+                      const std::atomic<bool>* cancelled) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  QByteArray block(hash_block_size, 0);
+  while (!file.atEnd()) {
+    if (cancelled && *cancelled) {
+      return QByteArray();
+    }
+    const qint64 count = file.read(block.data(), block.size());
+    if (count < 0) {
+      return QByteArray();
+    }
+    hash.addData(block.constData(), static_cast<int>(count));
+  }
+  return hash.result().toHex();
+}
+
+QString Sha256SidecarPath(const QString& path) {
+  return path + ".sha256";
+}
+
+QByteArray ReadSha256Sidecar(const QString& path) {
+  QFile sidecar(Sha256SidecarPath(path));
+  if (!sidecar.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  const QByteArray sha256 =
+      sidecar.readLine().split(' ').first().trimmed().toLower();
+  if (sha256.size() != 64) {
+    LOG_WARNING << "ignoring malformed " << sidecar.fileName();
+    return QByteArray();
+  }
+  return sha256;
+}
+
+bool WriteSha256Sidecar(const QString& path, const QByteArray& sha256) {
+  QFile sidecar(Sha256SidecarPath(path));
+  if (!sidecar.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  const QByteArray name = QFileInfo(path).fileName().toUtf8();
+  return sidecar.write(sha256 + "  " + name + "\n") > 0;
+}
+
+SidecarCheck::SidecarCheck(QObject* parent) : QObject(parent) {
+  connect(this, &SidecarCheck::hashed, this, &SidecarCheck::finished,
+          Qt::QueuedConnection);
+}
+
+SidecarCheck::~SidecarCheck() {
+  if (done_.valid()) {
+    cancelled_ = true;
+    done_.wait();
+  }
+}
+
+void SidecarCheck::start(const QString& path) {
+  const QByteArray expected = ReadSha256Sidecar(path);
+  if (expected.isEmpty()) {
+    LOG_WARNING << "no sidecar hash for " << path << ", not verifying it";
+    // keep finished() asynchronous either way
+    QTimer::singleShot(0, this,
+                       [this]() { emit finished(Result::NoSidecar); });
+    return;
+  }
+
+  LOG_INFO << "verifying " << path;
+  done_ = TaskPool::instance()->submit([this, path, expected]() {
+    const QByteArray actual = Sha256File(path, &cancelled_);
+    if (actual.isEmpty()) {
+      emit hashed(Result::Unreadable);
+    } else if (actual != expected) {
+      LOG_ERROR << path << " has SHA-256 " << actual << ", expected "
+                << expected;
+      emit hashed(Result::Mismatch);
+    } else {
+      emit hashed(Result::Verified);
+    }
+  });
+}
+
+}  // namespace gondar
@@ -0,0 +1,73 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_SIDECAR_CHECK_H_
+#define SRC_SIDECAR_CHECK_H_
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include <future>
+
+namespace gondar {
+
+// Hex SHA-256 of the file at |path|, or empty if it can't be read or
+// |cancelled| is set partway. Reads the whole file, so keep it off the
+// GUI thread.
+QByteArray Sha256File(const QString& path,
+                      const std::atomic<bool>* cancelled = nullptr);
+
+// The sidecar of |path| is |path|.sha256, in the format sha256sum
+// writes
+QString Sha256SidecarPath(const QString& path);
+// The hex hash from |path|'s sidecar, or empty if it has none
+QByteArray ReadSha256Sidecar(const QString& path);
+bool WriteSha256Sidecar(const QString& path, const QByteArray& sha256);
+
+// Checks a local image against its sidecar, hashing it on the
+// TaskPool. finished() is emitted on the thread that called start().
+class SidecarCheck : public QObject {
+  Q_OBJECT
+
+ public:
+  enum class Result {
+    Verified,
+    // Nothing to check against
+    NoSidecar,
+    Mismatch,
+    Unreadable,
+  };
+  Q_ENUM(Result)
+
+  explicit SidecarCheck(QObject* parent = nullptr);
+  // Stops a running check and waits for it
+  ~SidecarCheck();
+
+  void start(const QString& path);
+
+ signals:
+  void finished(SidecarCheck::Result result);
+  // Emitted from the pool; forwarded to finished() on our thread
+  void hashed(SidecarCheck::Result result);
+
+ private:
+  std::future<void> done_;
+  std::atomic<bool> cancelled_{false};
+};
+
+}  // namespace gondar
+
+#endif  // SRC_SIDECAR_CHECK_H_
@@ -20,18 +20,6 @@
 #include "log.h"
 #include "metric.h"
 
-class SiteEntry : public QListWidgetItem {
- public:
-  explicit SiteEntry(const GondarSite& site) : site_(site) {
-    setText(site.getSiteName());
-  }
-
-  const GondarSite& site() const { return site_; }
-
- private:
-  const GondarSite site_;
-};
-
 SiteSelectPage::SiteSelectPage(QWidget* parent) : WizardPage(parent) {
   setTitle("Site Select");
   setSubTitle(
@@ -44,27 +32,31 @@ SiteSelectPage::SiteSelectPage(QWidget* parent) : WizardPage(parent) {
   findLayout.addWidget(&lineEdit);
   layout.addLayout(&findLayout);
 
-  layout.addWidget(&sitesEntries);
+  filterModel.setSourceModel(&sitesModel);
+  sitesView.setModel(&filterModel);
+  // lets the view skip measuring every row, which matters with tens of
+  // thousands of sites
+  sitesView.setUniformItemSizes(true);
+  layout.addWidget(&sitesView);
+
+  connect(&lineEdit, &QLineEdit::textChanged, &filterModel,
+          &gondar::SearchFilterModel::setQuery);
 }
 
 void SiteSelectPage::initializePage() {
-  const auto& sitesList = wizard()->sites();
-  for (const auto& site : sitesList) {
-    auto* curSite = new SiteEntry(site);
-    sitesEntries.addItem(curSite);
-  }
-  connect(&lineEdit, &QLineEdit::textChanged, this,
-          &SiteSelectPage::filterSites);
+  sitesModel.setSites(wizard()->sites());
 }
 
 bool SiteSelectPage::validatePage() {
   // if we have a site selected, update our download links and continue
-  // otherwise, return false
-  auto* selected = dynamic_cast<SiteEntry*>(sitesEntries.currentItem());
-  if (selected == NULL || selected->isHidden()) {
+  // otherwise, return false. a site hidden by the search is no longer
+  // selected.
+  const auto selected = sitesView.selectionModel()->selectedIndexes();
+  if (selected.isEmpty()) {
     return false;
   } else {
-    const auto site = selected->site();
+    const auto& site =
+        sitesModel.site(filterModel.mapToSource(selected.first()).row());
     // metrics may now include site id
     wizard()->setSiteId(site.getSiteId());
     QList<GondarImage> imageList = site.getImages();
@@ -73,17 +65,6 @@ bool SiteSelectPage::validatePage() {
   }
 }
 
-void SiteSelectPage::filterSites() {
-  for (int i = 0; i < sitesEntries.count(); i++) {
-    if (sitesEntries.item(i)->text().toLower().contains(
-            getFindText().toLower())) {
-      sitesEntries.item(i)->setHidden(false);
-    } else {
-      sitesEntries.item(i)->setHidden(true);
-    }
-  }
-}
-
 QString SiteSelectPage::getFindText() {
   return lineEdit.text();
 }
@@ -19,10 +19,11 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
 #include <QVBoxLayout>
 
-#include "gondarsite.h"
+#include "picker_models.h"
+#include "search_filter_model.h"
 #include "wizard_page.h"
 
 class SiteSelectPage : public gondar::WizardPage {
@@ -41,8 +42,9 @@ class SiteSelectPage : public gondar::WizardPage {
   QHBoxLayout findLayout;
   QLabel findLabel;
   QLineEdit lineEdit;
-  QListWidget sitesEntries;
-  void filterSites();
+  gondar::SiteListModel sitesModel;
+  gondar::SearchFilterModel filterModel;
+  QListView sitesView;
 };
 
 #endif  // SRC_SITE_SELECT_PAGE_H_
@@ -0,0 +1,566 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "station_server.h"
+
+#include <sys/types.h>
+
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#endif
+#include <microhttpd.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "gondar.h"
+#include "headless_installer.h"
+#include "log.h"
+#include "peer_cache.h"
+
+namespace gondar {
+
+namespace {
+
+// Device enumeration is not reentrant
+std::mutex device_list_mutex;
+
+// Per-request state: the accumulated upload body
+struct RequestContext {
+  std::string body;
+};
+
+// Per-stream state for GET /jobs/<id>/events
+struct EventStream {
+  StationServer* server;
+  struct MHD_Connection* connection;
+  std::shared_ptr<StationServer::Job> job;
+  size_t next_event = 0;
+  QByteArray pending;
+  int pending_offset = 0;
+};
+
+QJsonObject deviceJson(const DeviceGuy& device) {
+  QJsonObject json;
+  json["id"] = static_cast<qint64>(device.device_num);
+  json["name"] = QString::fromStdString(device.name);
+  json["bytes"] = static_cast<qint64>(device.num_bytes);
+  json["bus"] = QString::fromStdString(device.bus);
+  json["big_enough"] = device.isBigEnough();
+  return json;
+}
+
+QByteArray errorJson(const QString& message) {
+  QJsonObject json;
+  json["error"] = message;
+  return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+int send_json(struct MHD_Connection* connection,
+              unsigned int status,
+              const QByteArray& body) {
+  struct MHD_Response* response = MHD_create_response_from_buffer(
+      body.size(), (void*)body.constData(), MHD_RESPMEM_MUST_COPY);
+  if (!response)
+    return MHD_NO;
+  MHD_add_response_header(response, "Content-Type", "application/json");
+  const int ret = MHD_queue_response(connection, status, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+ssize_t read_events(void* cls, uint64_t pos, char* buf, size_t max) {
+  (void)pos; /* Unused. Silence compiler warning. */
+  auto* stream = static_cast<EventStream*>(cls);
+
+  if (stream->pending_offset >= stream->pending.size()) {
+    stream->pending.clear();
+    stream->pending_offset = 0;
+
+    bool done = false;
+    auto events =
+        stream->server->eventsSince(*stream->job, stream->next_event, &done);
+    if (events.empty()) {
+      if (done) {
+        return MHD_CONTENT_READER_END_OF_STREAM;
+      }
+      // Nothing new yet; MHD calls back once the stream is resumed
+      stream->server->suspendForEvents(*stream->job, stream->next_event,
+                                       stream->connection);
+      return 0;
+    }
+    stream->next_event += events.size();
+    for (const auto& event : events) {
+      stream->pending.append(event);
+      stream->pending.append('\n');
+    }
+  }
+
+  const size_t remaining =
+      static_cast<size_t>(stream->pending.size() - stream->pending_offset);
+  const size_t count = std::min(remaining, max);
+  memcpy(buf, stream->pending.constData() + stream->pending_offset, count);
+  stream->pending_offset += static_cast<int>(count);
+  return static_cast<ssize_t>(count);
+}
+
+void free_event_stream(void* cls) {
+  delete static_cast<EventStream*>(cls);
+}
+
+int send_event_stream(struct MHD_Connection* connection,
+                      StationServer* server,
+                      std::shared_ptr<StationServer::Job> job) {
+  auto* stream = new EventStream;
+  stream->server = server;
+  stream->connection = connection;
+  stream->job = std::move(job);
+  struct MHD_Response* response = MHD_create_response_from_callback(
+      MHD_SIZE_UNKNOWN, 4096, &read_events, stream, &free_event_stream);
+  if (!response) {
+    delete stream;
+    return MHD_NO;
+  }
+  MHD_add_response_header(response, "Content-Type", "application/x-ndjson");
+  const int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+int handle_request(StationServer* server,
+                   struct MHD_Connection* connection,
+                   const QString& method,
+                   const QString& url,
+                   const std::string& body) {
+  const QStringList parts = url.split('/', QString::SkipEmptyParts);
+
+  if (parts.size() == 1 && parts[0] == "devices") {
+    if (method != "GET")
+      return send_json(connection, MHD_HTTP_METHOD_NOT_ALLOWED,
+                       errorJson("use GET"));
+    return send_json(connection, MHD_HTTP_OK, server->devicesJson());
+  }
+
+  if (parts.empty() || parts[0] != "jobs") {
+    return send_json(connection, MHD_HTTP_NOT_FOUND, errorJson("not found"));
+  }
+
+  if (parts.size() == 1) {
+    if (method == "GET") {
+      return send_json(connection, MHD_HTTP_OK, server->jobsJson());
+    }
+    if (method == "POST") {
+      QString error;
+      const int id = server->submitJob(
+          QByteArray(body.data(), static_cast<int>(body.size())), &error);
+      if (id < 0) {
+        return send_json(connection, MHD_HTTP_BAD_REQUEST, errorJson(error));
+      }
+      QJsonObject json;
+      json["id"] = id;
+      return send_json(connection, MHD_HTTP_ACCEPTED,
+                       QJsonDocument(json).toJson(QJsonDocument::Compact));
+    }
+    return send_json(connection, MHD_HTTP_METHOD_NOT_ALLOWED,
+                     errorJson("use GET or POST"));
+  }
+
+  bool ok = false;
+  const int id = parts[1].toInt(&ok);
+  auto job = ok ? server->findJob(id) : nullptr;
+  if (!job || parts.size() > 3 || method != "GET") {
+    return send_json(connection, MHD_HTTP_NOT_FOUND, errorJson("not found"));
+  }
+  if (parts.size() == 2) {
+    return send_json(connection, MHD_HTTP_OK, server->jobJson(*job));
+  }
+  if (parts[2] == "events") {
+    return send_event_stream(connection, server, std::move(job));
+  }
+  return send_json(connection, MHD_HTTP_NOT_FOUND, errorJson("not found"));
+}
+
+int answer_to_connection(void* cls,
+                         struct MHD_Connection* connection,
+                         const char* url,
+                         const char* method,
+                         const char* version,
+                         const char* upload_data,
+                         size_t* upload_data_size,
+                         void** con_cls) {
+  (void)version; /* Unused. Silence compiler warning. */
+  auto* server = static_cast<StationServer*>(cls);
+
+  // First call for this request: just set up the context
+  if (nullptr == *con_cls) {
+    *con_cls = new RequestContext;
+    return MHD_YES;
+  }
+
+  // Accumulate the upload, if any, until MHD calls with no more data
+  auto* context = static_cast<RequestContext*>(*con_cls);
+  if (*upload_data_size != 0) {
+    context->body.append(upload_data, *upload_data_size);
+    *upload_data_size = 0;
+    return MHD_YES;
+  }
+
+  return handle_request(server, connection, method, url, context->body);
+}
+
+void request_completed(void* cls,
+                       struct MHD_Connection* connection,
+                       void** con_cls,
+                       enum MHD_RequestTerminationCode toe) {
+  (void)cls;        /* Unused. Silence compiler warning. */
+  (void)connection; /* Unused. Silence compiler warning. */
+  (void)toe;        /* Unused. Silence compiler warning. */
+  delete static_cast<RequestContext*>(*con_cls);
+  *con_cls = nullptr;
+}
+
+}  // namespace
+
+StationServer::StationServer(QObject* parent) : QObject(parent) {
+  // Jobs are submitted from request threads but run on ours
+  connect(this, &StationServer::jobSubmitted, this, &StationServer::runJob,
+          Qt::QueuedConnection);
+}
+
+StationServer::~StationServer() {
+  stop();
+}
+
+bool StationServer::start(const int port) {
+  if (daemon_ != nullptr) {
+    return true;
+  }
+
+  // Only the local line controller should be able to submit jobs
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // Unlike the OAuth server, which only ever sees one request, this
+  // needs to stay responsive while jobs are streaming progress, so
+  // requests are spread over a pool of threads
+  const unsigned int pool_size =
+      static_cast<unsigned int>(std::max(4, QThread::idealThreadCount()));
+  void* request_completed_args = nullptr;
+  daemon_ = MHD_start_daemon(
+      MHD_USE_SELECT_INTERNALLY | MHD_ALLOW_SUSPEND_RESUME,
+      static_cast<uint16_t>(port), nullptr,
+      nullptr, &answer_to_connection, this, MHD_OPTION_THREAD_POOL_SIZE,
+      pool_size, MHD_OPTION_SOCK_ADDR, &addr, MHD_OPTION_NOTIFY_COMPLETED,
+      &request_completed, request_completed_args, MHD_OPTION_END);
+  if (daemon_ == nullptr) {
+    LOG_ERROR << "failed to start station server on port " << port;
+    return false;
+  }
+  const union MHD_DaemonInfo* info =
+      MHD_get_daemon_info(daemon_, MHD_DAEMON_INFO_BIND_PORT);
+  port_ = info ? info->port : port;
+  LOG_INFO << "station server listening on 127.0.0.1:" << port_ << " with "
+           << pool_size << " threads";
+  return true;
+}
+
+void StationServer::stop() {
+  if (daemon_ == nullptr) {
+    return;
+  }
+  // MHD can't stop with connections suspended, so let any streams
+  // waiting for events see that there won't be more
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  resumeStreams(-1);
+  MHD_stop_daemon(daemon_);
+  daemon_ = nullptr;
+  port_ = 0;
+}
+
+int StationServer::port() const {
+  return port_;
+}
+
+QByteArray StationServer::devicesJson() {
+  DeviceGuyList devices;
+  {
+    std::lock_guard<std::mutex> lock(device_list_mutex);
+    devices = GetDeviceList();
+  }
+
+  QJsonArray array;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& device : devices) {
+    QJsonObject json = deviceJson(device);
+    json["busy"] = deviceIsBusy(device.device_num);
+    array.append(json);
+  }
+  return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+QByteArray StationServer::jobsJson() {
+  QJsonArray array;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& pair : jobs_) {
+    array.append(jobSummary(*pair.second));
+  }
+  return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+std::shared_ptr<StationServer::Job> StationServer::findJob(const int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto iter = jobs_.find(id);
+  if (iter == jobs_.end()) {
+    return nullptr;
+  }
+  return iter->second;
+}
+
+QByteArray StationServer::jobJson(const Job& job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  QJsonObject json = jobSummary(job);
+  QJsonArray events;
+  for (const auto& event : job.events) {
+    events.append(QJsonDocument::fromJson(event).object());
+  }
+  json["events"] = events;
+  return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+int StationServer::submitJob(const QByteArray& body, QString* error) {
+  QJsonParseError parse_error;
+  const QJsonObject json = QJsonDocument::fromJson(body, &parse_error).object();
+  if (parse_error.error != QJsonParseError::NoError) {
+    *error = "invalid JSON: " + parse_error.errorString();
+    return -1;
+  }
+
+  const QString source = json["image"].toString();
+  if (source.isEmpty()) {
+    *error = "missing \"image\"";
+    return -1;
+  }
+
+  const QJsonArray ids = json["devices"].toArray();
+  if (ids.isEmpty()) {
+    *error = "missing \"devices\"";
+    return -1;
+  }
+
+  DeviceGuyList available;
+  {
+    std::lock_guard<std::mutex> lock(device_list_mutex);
+    available = GetDeviceList();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto job = std::make_shared<Job>();
+  for (const auto& id_value : ids) {
+    const int signed_id = id_value.toInt(-1);
+    if (signed_id < 0) {
+      *error = "device IDs must be non-negative integers";
+      return -1;
+    }
+    const auto id = static_cast<uint32_t>(signed_id);
+    const auto iter = std::find_if(
+        available.begin(), available.end(),
+        [id](const DeviceGuy& dev) { return dev.device_num == id; });
+    if (iter == available.end()) {
+      *error = QString("device %1 not found").arg(id);
+      return -1;
+    }
+    if (!iter->isBigEnough()) {
+      *error = QString("device %1 is too small").arg(id);
+      return -1;
+    }
+    const bool listed_twice = std::any_of(
+        job->devices.begin(), job->devices.end(),
+        [id](const DeviceGuy& dev) { return dev.device_num == id; });
+    if (listed_twice || deviceIsBusy(id)) {
+      *error = QString("device %1 is busy with another job").arg(id);
+      return -1;
+    }
+    job->devices.push_back(*iter);
+  }
+
+  job->id = next_job_id_++;
+  job->source = source;
+  jobs_[job->id] = job;
+  LOG_INFO << "station job " << job->id << " queued for " << source;
+  emit jobSubmitted(job->id);
+  return job->id;
+}
+
+void StationServer::suspendForEvents(const Job& job,
+                                     const size_t seen,
+                                     struct MHD_Connection* connection) {
+  // Checking and suspending under the lock means an event can't slip
+  // in between without resuming the stream
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_ || job.isDone() || job.events.size() > seen) {
+    return;
+  }
+  MHD_suspend_connection(connection);
+  suspended_.emplace_back(job.id, connection);
+}
+
+std::vector<QByteArray> StationServer::eventsSince(const Job& job,
+                                                   const size_t first,
+                                                   bool* done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *done = job.isDone() || stopping_;
+  if (first >= job.events.size()) {
+    return {};
+  }
+  return std::vector<QByteArray>(job.events.begin() + first, job.events.end());
+}
+
+void StationServer::runJob(const int id) {
+  QString source;
+  DeviceGuyList devices;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& job = *jobs_.at(id);
+    job.state = "running";
+    source = job.source;
+    devices = job.devices;
+  }
+
+  // Jobs for the same image would otherwise download and extract it
+  // to the same path at the same time
+  const QDir downloads =
+      QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+  downloads.mkpath(".");
+  auto* work_dir = new QTemporaryDir(
+      downloads.filePath(QString("station-job-%1-XXXXXX").arg(id)));
+  if (!work_dir->isValid()) {
+    LOG_ERROR << "can't create a directory for station job " << id << ": "
+              << work_dir->errorString();
+    delete work_dir;
+    appendEvent(id, {{"event", "error"},
+                     {"message", "can't create a work directory"}});
+    finishJob(id, false);
+    return;
+  }
+
+  auto* installer = new HeadlessInstaller(this);
+  installer->setScheduler(&scheduler_);
+  installer->setWorkDir(work_dir->path());
+  connect(installer, &HeadlessInstaller::event, this,
+          [this, id](const QJsonObject& event) { appendEvent(id, event); });
+  connect(installer, &HeadlessInstaller::finished, this,
+          [this, id, installer](bool success) {
+            finishJob(id, success);
+            installer->deleteLater();
+          });
+  // Only once the installer is gone is nothing reading the files
+  connect(installer, &QObject::destroyed, [work_dir]() {
+    // The download won't be there to serve to the LAN
+    const QDir dir(work_dir->path());
+    for (const QString& name : dir.entryList(QDir::Files)) {
+      PeerCache::instance()->unshare(dir.filePath(name));
+    }
+    delete work_dir;
+  });
+  installer->start(source, devices);
+}
+
+void StationServer::appendEvent(const int id, const QJsonObject& event) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.at(id)->events.push_back(
+        QJsonDocument(event).toJson(QJsonDocument::Compact));
+  }
+  resumeStreams(id);
+}
+
+void StationServer::finishJob(const int id, const bool success) {
+  LOG_INFO << "station job " << id << (success ? " succeeded" : " failed");
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.at(id)->state = success ? "succeeded" : "failed";
+  }
+  resumeStreams(id);
+}
+
+void StationServer::resumeStreams(const int id) {
+  std::vector<struct MHD_Connection*> resumed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto waiting = std::partition(
+        suspended_.begin(), suspended_.end(),
+        [id](const std::pair<int, struct MHD_Connection*>& stream) {
+          return id >= 0 && stream.first != id;
+        });
+    for (auto iter = waiting; iter != suspended_.end(); ++iter) {
+      resumed.push_back(iter->second);
+    }
+    suspended_.erase(waiting, suspended_.end());
+  }
+  // A suspended connection can't go away, so this is safe outside the
+  // lock; each one is only ever resumed once
+  for (auto* connection : resumed) {
+    MHD_resume_connection(connection);
+  }
+}
+
+QJsonObject StationServer::jobSummary(const Job& job) {
+  QJsonObject json;
+  json["id"] = job.id;
+  json["image"] = job.source;
+  json["state"] = job.state;
+  QJsonArray devices;
+  for (const auto& device : job.devices) {
+    devices.append(deviceJson(device));
+  }
+  json["devices"] = devices;
+  return json;
+}
+
+bool StationServer::deviceIsBusy(const uint32_t device_num) const {
+  for (const auto& pair : jobs_) {
+    const auto& job = *pair.second;
+    if (job.isDone()) {
+      continue;
+    }
+    for (const auto& device : job.devices) {
+      if (device.device_num == device_num) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace gondar
@@ -0,0 +1,126 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_STATION_SERVER_H_
+#define SRC_STATION_SERVER_H_
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "device.h"
+#include "write_scheduler.h"
+
+struct MHD_Connection;
+struct MHD_Daemon;
+
+namespace gondar {
+
+// Localhost HTTP API for running imaging jobs without anyone at the
+// GUI. Requests are answered on libmicrohttpd's internal thread pool;
+// the jobs themselves run on the Qt thread via HeadlessInstaller.
+//
+//   GET  /devices          attached devices
+//   GET  /jobs             all jobs and their state
+//   POST /jobs             {"image": url-or-path, "devices": [id, ...]}
+//   GET  /jobs/<id>        one job, including its events so far
+//   GET  /jobs/<id>/events the job's events as JSON lines, streamed
+//                          until the job is done
+class StationServer : public QObject {
+  Q_OBJECT
+
+ public:
+  struct Job {
+    int id = 0;
+    QString source;
+    DeviceGuyList devices;
+    // "queued", "running", "succeeded" or "failed"
+    QString state = "queued";
+    std::vector<QByteArray> events;
+
+    bool isDone() const { return state == "succeeded" || state == "failed"; }
+  };
+
+  explicit StationServer(QObject* parent = nullptr);
+  ~StationServer();
+
+  // Listen on 127.0.0.1:|port|, or on a port the system picks if it
+  // is 0. Returns false if the daemon could not be started.
+  bool start(int port);
+  void stop();
+  // The port actually in use while running
+  int port() const;
+
+  // The rest of the public interface is called from the request
+  // threads; everything in it is guarded by |mutex_|.
+  QByteArray devicesJson();
+  QByteArray jobsJson();
+  // Returns nullptr if there is no such job
+  std::shared_ptr<Job> findJob(int id);
+  // |job| including its events so far
+  QByteArray jobJson(const Job& job);
+  // Validate and queue a job. On failure |error| is set and -1 is
+  // returned.
+  int submitJob(const QByteArray& body, QString* error);
+  // Suspend |connection| until |job| has more than |seen| events, is
+  // done or the server stops, so a stream with nothing to send doesn't
+  // hold on to a request thread. Does nothing if that has already
+  // happened.
+  void suspendForEvents(const Job& job,
+                        size_t seen,
+                        struct MHD_Connection* connection);
+  // Copy out the events of |job| starting at |first|
+  std::vector<QByteArray> eventsSince(const Job& job,
+                                      size_t first,
+                                      bool* done);
+
+ signals:
+  void jobSubmitted(int id);
+
+ private:
+  void runJob(int id);
+  void appendEvent(int id, const QJsonObject& event);
+  void finishJob(int id, bool success);
+  // Resume the streams waiting on job |id|, or on any job if |id| is
+  // negative
+  void resumeStreams(int id);
+
+  // These must be called with |mutex_| held
+  static QJsonObject jobSummary(const Job& job);
+  bool deviceIsBusy(uint32_t device_num) const;
+
+  struct MHD_Daemon* daemon_ = nullptr;
+  int port_ = 0;
+  // Shared by all jobs so that the per-hub writer limit holds across
+  // them
+  WriteScheduler scheduler_;
+
+  std::mutex mutex_;
+  std::map<int, std::shared_ptr<Job>> jobs_;
+  // Suspended event streams and the job each is waiting on
+  std::vector<std::pair<int, struct MHD_Connection*>> suspended_;
+  int next_job_id_ = 1;
+  bool stopping_ = false;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_STATION_SERVER_H_
@@ -15,22 +15,41 @@
 
 #include <QtGlobal>
 
+#include "block_map.h"
 #include "gondar.h"
 #include "util.h"
+#include "write_telemetry.h"
 
 DeviceGuyList GetDeviceList() {
   DeviceGuyList devices;
   devices.emplace_back(DeviceGuy(0, "stubdevice0", 10 * gondar::getGigabyte()));
   devices.emplace_back(DeviceGuy(1, "stubdevice1", 4 * gondar::getGigabyte()));
+  for (auto& device : devices) {
+    device.bus = "stubhub";
+  }
   return devices;
 }
 
 bool Install(DeviceGuy* target_device,
              const char* image_path,
-             int64_t image_size) {
+             int64_t image_size,
+             const std::atomic<bool>* cancel,
+             gondar::WriteTelemetry* telemetry,
+             const gondar::BlockMap* block_map) {
   Q_UNUSED(target_device);
   Q_UNUSED(image_path);
-  Q_UNUSED(image_size);
+  if (cancel && *cancel) {
+    return false;
+  }
+  if (telemetry) {
+    const int64_t bytes =
+        block_map ? static_cast<int64_t>(block_map->mappedBytes())
+                  : image_size;
+    telemetry->setTotalBytes(bytes);
+    telemetry->beginStage(gondar::WriteTelemetry::Stage::Write);
+    telemetry->addBytes(bytes, image_size / 512);
+    telemetry->endStage(gondar::WriteTelemetry::Stage::Write);
+  }
   return true;
 }
 
@@ -0,0 +1,123 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "task_pool.h"
+
+#include <QThread>
+#include <algorithm>
+
+namespace gondar {
+
+namespace {
+
+// The pool and worker index of the current thread, if it is a worker
+thread_local TaskPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+TaskPool::TaskPool(const int worker_count) {
+  const int count = std::max(1, worker_count);
+  for (int i = 0; i < count; i++) {
+    workers_.emplace_back(new Worker);
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    workers_[i]->thread = std::thread(&TaskPool::workerLoop, this, i);
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+TaskPool* TaskPool::instance() {
+  static TaskPool pool(QThread::idealThreadCount());
+  return &pool;
+}
+
+std::future<void> TaskPool::submit(Task task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> result = packaged.get_future();
+
+  const size_t index = current_pool == this
+                           ? current_worker
+                           : next_worker_++ % workers_.size();
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+    workers_[index]->tasks.push_back(std::move(packaged));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    queued_++;
+  }
+  wake_.notify_one();
+  return result;
+}
+
+int TaskPool::workerCount() const {
+  return static_cast<int>(workers_.size());
+}
+
+bool TaskPool::takeTask(const size_t index,
+                        std::packaged_task<void()>* task) {
+  {
+    Worker& own = *workers_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t offset = 1; offset < workers_.size(); offset++) {
+    Worker& victim = *workers_[(index + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskPool::workerLoop(const size_t index) {
+  current_pool = this;
+  current_worker = index;
+
+  while (true) {
+    std::packaged_task<void()> task;
+    if (takeTask(index, &task)) {
+      queued_--;
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this]() { return queued_ > 0 || stopping_; });
+    if (stopping_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+}  // namespace gondar
@@ -0,0 +1,85 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_TASK_POOL_H_
+#define SRC_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gondar {
+
+// A fixed set of worker threads shared by the CPU-bound stages of the
+// pipeline (unzip, hashing, verification). Each worker has its own
+// queue; tasks submitted from a worker go to that worker's queue and
+// idle workers steal from the others, so a stage that fans out into
+// many small tasks spreads across every core.
+//
+// Blocking device I/O does not belong here: a worker stuck in a write
+// cannot run anything else. DiskWriteThread keeps its own thread.
+class TaskPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit TaskPool(int worker_count);
+  // Runs every task that is still queued, then joins the workers
+  ~TaskPool();
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // The process-wide pool, one worker per core
+  static TaskPool* instance();
+
+  // Queue |task|. The future becomes ready once it has run; an
+  // exception thrown by the task is rethrown from future::get().
+  std::future<void> submit(Task task);
+
+  int workerCount() const;
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::packaged_task<void()>> tasks;
+    std::thread thread;
+  };
+
+  void workerLoop(size_t index);
+  // Newest task from our own queue, or else the oldest task from
+  // someone else's. Returns false if every queue is empty.
+  bool takeTask(size_t index, std::packaged_task<void()>* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_{0};
+
+  // Idle workers sleep on |wake_|. |queued_| is only incremented with
+  // |sleep_mutex_| held so that a wakeup cannot slip in between a
+  // worker's last look at the queues and its wait.
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::atomic<int> queued_{0};
+  bool stopping_ = false;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_TASK_POOL_H_
@@ -0,0 +1,195 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+namespace gondar {
+
+namespace {
+
+struct Event {
+  char phase;
+  std::string category;
+  std::string name;
+  int64_t timestamp_us;
+  int thread;
+  int64_t value;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Enough for a typical run without reallocating
+const size_t initial_capacity = 64 * 1024;
+
+// About 100 MB of events. A station left tracing for days would
+// otherwise grow without bound; past this, events are counted but not
+// kept.
+const size_t max_events = 1024 * 1024;
+
+std::mutex& eventsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Guarded by eventsMutex()
+std::vector<Event>& events() {
+  static std::vector<Event> list;
+  return list;
+}
+
+// Events not kept because the buffer was full. Guarded by
+// eventsMutex().
+size_t& droppedEvents() {
+  static size_t count = 0;
+  return count;
+}
+
+QString& outputPath() {
+  static QString path;
+  return path;
+}
+
+Clock::time_point& startTime() {
+  static Clock::time_point time;
+  return time;
+}
+
+// Small sequential IDs read better in the trace viewer than native
+// thread handles
+int currentThread() {
+  static std::atomic<int> next_thread{1};
+  thread_local const int thread = next_thread++;
+  return thread;
+}
+
+QJsonObject toJson(const Event& event) {
+  const QString name = QString::fromStdString(event.name);
+  QJsonObject json;
+  json.insert("name", name);
+  json.insert("cat", QString::fromStdString(event.category));
+  json.insert("ph", QString(QChar(event.phase)));
+  json.insert("ts", static_cast<double>(event.timestamp_us));
+  json.insert("pid", static_cast<double>(QCoreApplication::applicationPid()));
+  json.insert("tid", event.thread);
+  if (event.phase == 'C') {
+    json.insert("args",
+                QJsonObject{{name, static_cast<double>(event.value)}});
+  } else if (event.phase == 'i') {
+    // Draw instant events across their own thread only
+    json.insert("s", "t");
+  }
+  return json;
+}
+
+}  // namespace
+
+std::atomic<bool> Trace::enabled_{false};
+
+void Trace::start(const QString& path) {
+  std::lock_guard<std::mutex> lock(eventsMutex());
+  if (enabled()) {
+    return;
+  }
+  outputPath() = path;
+  startTime() = Clock::now();
+  events().clear();
+  events().reserve(initial_capacity);
+  droppedEvents() = 0;
+  enabled_.store(true, std::memory_order_relaxed);
+  LOG_INFO << "tracing to " << path;
+}
+
+void Trace::startFromEnvironment() {
+  const QString path =
+      QString::fromLocal8Bit(qgetenv("THORIUMOS_USB_MAKER_TRACE"));
+  if (!path.isEmpty()) {
+    start(path);
+  }
+}
+
+void Trace::stop() {
+  std::vector<Event> recorded;
+  QString path;
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(eventsMutex());
+    if (!enabled()) {
+      return;
+    }
+    enabled_.store(false, std::memory_order_relaxed);
+    recorded.swap(events());
+    path = outputPath();
+    dropped = droppedEvents();
+  }
+
+  QJsonArray trace_events;
+  for (const Event& event : recorded) {
+    trace_events.append(toJson(event));
+  }
+  QJsonObject json;
+  json.insert("traceEvents", trace_events);
+  json.insert("displayTimeUnit", "ms");
+  if (dropped > 0) {
+    LOG_WARNING << "trace buffer filled up, " << dropped
+                << " later events were dropped";
+    json.insert("otherData",
+                QJsonObject{{"dropped_events", static_cast<double>(dropped)}});
+  }
+
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG_ERROR << "failed to open trace file " << path << ": "
+              << file.errorString();
+    return;
+  }
+  file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+  LOG_INFO << "wrote " << recorded.size() << " trace events to " << path;
+}
+
+void Trace::record(const char phase,
+                   const char* category,
+                   const char* name,
+                   const int64_t value) {
+  const int thread = currentThread();
+  std::lock_guard<std::mutex> lock(eventsMutex());
+  // Tracing may have stopped since the caller checked
+  if (!enabled()) {
+    return;
+  }
+  if (events().size() >= max_events) {
+    droppedEvents()++;
+    return;
+  }
+  const int64_t timestamp_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                            startTime())
+          .count();
+  events().push_back(
+      Event{phase, category, name, timestamp_us, thread, value});
+}
+
+}  // namespace gondar
@@ -0,0 +1,102 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+namespace gondar {
+
+// Optional recorder of begin/end events and counters, written out in
+// the Chrome trace-event JSON format so that a slow run can be loaded
+// into chrome://tracing or Perfetto. Tracing is off unless start() is
+// called; while it is off every recording call costs one relaxed load
+// and a branch.
+class Trace {
+ public:
+  // Start recording. The trace is written to |path| by stop(). Only
+  // the first million or so events are kept.
+  static void start(const QString& path);
+  // Call start() if the THORIUMOS_USB_MAKER_TRACE environment
+  // variable names an output file
+  static void startFromEnvironment();
+  // Stop recording and write the trace file
+  static void stop();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // Begin and end must be paired on the same thread
+  static void begin(const char* category, const char* name) {
+    if (enabled()) {
+      record('B', category, name, 0);
+    }
+  }
+  static void end(const char* category, const char* name) {
+    if (enabled()) {
+      record('E', category, name, 0);
+    }
+  }
+  // A point in time with no duration, such as a retry
+  static void instant(const char* category, const char* name) {
+    if (enabled()) {
+      record('i', category, name, 0);
+    }
+  }
+  // A value plotted over time, such as bytes downloaded so far
+  static void counter(const char* name, int64_t value) {
+    if (enabled()) {
+      record('C', "counter", name, value);
+    }
+  }
+
+ private:
+  static void record(char phase,
+                     const char* category,
+                     const char* name,
+                     int64_t value);
+
+  static std::atomic<bool> enabled_;
+};
+
+// Begin event on construction, matching end event on destruction
+class TraceScope {
+ public:
+  TraceScope(const char* category, const char* name) {
+    if (Trace::enabled()) {
+      category_ = category;
+      name_ = name;
+      Trace::begin(category, name);
+    }
+  }
+  ~TraceScope() {
+    if (name_) {
+      Trace::end(category_, name_);
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  const char* category_ = nullptr;
+  const char* name_ = nullptr;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_TRACE_H_
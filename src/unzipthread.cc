@@ -19,22 +19,42 @@
 
 #include "log.h"
 #include "neverware_unzipper.h"
+#include "task_pool.h"
 
 UnzipThread::UnzipThread(const QFileInfo& input, QObject* parent)
-    : QThread(parent), inputFile(input) {}
+    : QObject(parent), inputFile(input) {}
 
-UnzipThread::~UnzipThread() {}
+UnzipThread::~UnzipThread() {
+  cancel();
+  if (done.valid()) {
+    done.wait();
+  }
+}
 
 const QString& UnzipThread::getFileName() const {
   return filename;
 }
+
+void UnzipThread::setOutputDir(const QString& dir) {
+  outputDir = dir;
+}
+
+void UnzipThread::start() {
+  done = gondar::TaskPool::instance()->submit([this]() { run(); });
+}
+
+void UnzipThread::cancel() {
+  cancelled = true;
+}
+
 void UnzipThread::run() {
   try {
-    const QFileInfo binfile = neverware_unzip(inputFile);
+    const QFileInfo binfile = neverware_unzip(inputFile, &cancelled, outputDir);
     filename = binfile.absoluteFilePath();
     LOG_INFO << "unzip succeeded";
   } catch (const std::exception& exc) {
     LOG_ERROR << "unzip failed: " << exc.what();
     filename = QString();
   }
+  emit finished();
 }
@@ -17,21 +17,43 @@
 #define SRC_UNZIPTHREAD_H_
 
 #include <QFileInfo>
-#include <QThread>
+#include <QObject>
+#include <atomic>
+#include <future>
 
-class UnzipThread : public QThread {
+// Extracts the image from a downloaded zip file. Despite the name the
+// work runs as a task on the shared gondar::TaskPool rather than on a
+// thread of its own; finished() is emitted from the pool thread, so
+// receivers on the GUI thread get it as a queued call, the same as
+// with QThread::finished.
+class UnzipThread : public QObject {
   Q_OBJECT
  public:
   explicit UnzipThread(const QFileInfo& inputFile, QObject* parent = 0);
+  // Cancels a running extraction and waits for it to stop
   ~UnzipThread();
+  // Empty if extraction failed or was cancelled
   const QString& getFileName() const;
+  // Extract into |dir| instead of next to the zip file. Must be called
+  // before start().
+  void setOutputDir(const QString& dir);
 
- protected:
-  void run() override;
+  void start();
+  // Stop extracting before the next chunk. finished() is still
+  // emitted, with an empty file name.
+  void cancel();
+
+ signals:
+  void finished();
 
  private:
+  void run();
+
   QFileInfo inputFile;
+  QString outputDir;
   QString filename;
+  std::future<void> done;
+  std::atomic<bool> cancelled{false};
 };
 
 #endif  // SRC_UNZIPTHREAD_H_
@@ -17,10 +17,10 @@
 
 #include <QDesktopServices>
 #include <QMessageBox>
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QPushButton>
 
+#include "http_client.h"
 #include "log.h"
 #include "util.h"
 
@@ -39,15 +39,14 @@ void UpdateCheck::start(QWidget* parent) {
 
   parent_ = parent;
 
-  static QNetworkAccessManager manager;
-  connect(&manager, &QNetworkAccessManager::finished, this,
-          &UpdateCheck::handleReply);
-
-  manager.get(QNetworkRequest(
+  QNetworkReply* reply = GetNetworkManager()->get(CreateRequest(
       QUrl("https://usb-maker-downloads.neverware.com/api/v1/metadata.json")));
+  connect(reply, &QNetworkReply::finished, this,
+          [this, reply]() { handleReply(reply); });
 }
 
 void UpdateCheck::handleReply(QNetworkReply* reply) {
+  reply->deleteLater();
   const QString latestVersionString =
       gondar::jsonFromReply(reply)["newest_release"].toString();
   const double latestVersion = latestVersionString.toDouble();
@@ -15,6 +15,8 @@
 
 #include "write_operation_page.h"
 
+#include <algorithm>
+
 #include "diskwritethread.h"
 #include "gondarwizard.h"
 #include "log.h"
@@ -41,7 +43,13 @@ WriteOperationPage::WriteOperationPage(QWidget* parent)
   whatsNext.setOpenExternalLinks(true);
   whatsNext.setWordWrap(true);
   layout.addWidget(&whatsNext);
+  // duplicator stations can keep writing the same image to new sticks
+  layout.addWidget(&autoFlash);
   setLayout(&layout);
+
+  progressTimer.setInterval(250);
+  connect(&progressTimer, &QTimer::timeout, this,
+          &WriteOperationPage::updateProgress);
 }
 
 void WriteOperationPage::setDevice(const DeviceGuy& device_in) {
@@ -59,6 +67,8 @@ void WriteOperationPage::initializePage() {
   }
   bolded.hide();
   whatsNext.hide();
+  autoFlash.reset();
+  autoFlash.hide();
   writeFinished = false;
   writeToDrive();
 }
@@ -89,6 +99,7 @@ void WriteOperationPage::writeToDrive() {
   showProgress();
   LOG_INFO << "launching thread...";
   diskWriteThread->start();
+  progressTimer.start();
 }
 
 void WriteOperationPage::showProgress() {
@@ -96,6 +107,18 @@ void WriteOperationPage::showProgress() {
   progress.setValue(0);
 }
 
+void WriteOperationPage::updateProgress() {
+  const auto snapshot = diskWriteThread->telemetry().snapshot();
+  // Stay indeterminate until the write itself has started
+  if (snapshot.total_bytes == 0) {
+    return;
+  }
+  const int permille =
+      static_cast<int>(snapshot.bytes_written * 1000 / snapshot.total_bytes);
+  progress.setRange(0, 1000);
+  progress.setValue(std::min(permille, 1000));
+}
+
 void WriteOperationPage::showWhatsNext() {
   bolded.setObjectName("bolded");
   bolded.setText("<br>What's next?<br>");
@@ -129,12 +152,14 @@ void WriteOperationPage::showWhatsNext() {
   whatsNext.setOpenExternalLinks(true);
   whatsNext.setWordWrap(true);
   layout.addWidget(&whatsNext);
+  layout.addWidget(&autoFlash);
 
   bolded.show();
   whatsNext.show();
 }
 
 void WriteOperationPage::onDoneWriting() {
+  progressTimer.stop();
   switch (diskWriteThread->state()) {
     case DiskWriteThread::State::Initial:
     case DiskWriteThread::State::Running:
@@ -151,6 +176,10 @@ void WriteOperationPage::onDoneWriting() {
       writeFailed("Error writing to the USB device");
       return;
 
+    case DiskWriteThread::State::Cancelled:
+      writeFailed("Writing to the USB device was cancelled");
+      return;
+
     case DiskWriteThread::State::Success:
       // on success, break out to normal onDoneWriting logic
       break;
@@ -165,14 +194,31 @@ void WriteOperationPage::onDoneWriting() {
     gondar::SendMetric(wizard(), gondar::Metric::FormatSuccess);
   } else {
     wizard()->setMakeAnotherLayout();
+    autoFlash.setImagePath(image_path);
+    autoFlash.show();
     gondar::SendMetric(wizard(), gondar::Metric::UsbSuccess);
     // when a USB was successfully created, report time the run took
     gondar::SendMetric(wizard(), gondar::Metric::SuccessDuration,
                        QString::number(wizard()->getRunTime()).toStdString());
+    recordWriteTimings();
+    gondar::SendTimings(wizard(), wizard()->timings);
   }
   emit completeChanged();
 }
 
+void WriteOperationPage::recordWriteTimings() {
+  using Span = gondar::RunTimings::Span;
+  using Stage = gondar::WriteTelemetry::Stage;
+  const auto snapshot = diskWriteThread->telemetry().snapshot();
+  auto& timings = wizard()->timings;
+  timings.record(Span::Partition,
+                 snapshot.stage_ms[static_cast<int>(Stage::Partition)]);
+  timings.record(Span::Write, snapshot.stage_ms[static_cast<int>(Stage::Write)],
+                 snapshot.bytes_written);
+  timings.record(Span::Sync, snapshot.stage_ms[static_cast<int>(Stage::Sync)]);
+  timings.setWriteRetries(snapshot.retries);
+}
+
 // though error page follows in index, this is the end of the wizard for
 // healthy flows
 int WriteOperationPage::nextId() const {
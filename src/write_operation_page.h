@@ -18,8 +18,10 @@
 
 #include <QLabel>
 #include <QProgressBar>
+#include <QTimer>
 #include <QVBoxLayout>
 
+#include "auto_flash_panel.h"
 #include "device.h"
 #include "wizard_page.h"
 
@@ -46,14 +48,20 @@ class WriteOperationPage : public gondar::WizardPage {
  private:
   void writeToDrive();
   void writeFailed(const QString& errorMessage);
+  void updateProgress();
+  // Copy the write's stage timings into the wizard's run timings
+  void recordWriteTimings();
   QVBoxLayout layout;
   QProgressBar progress;
+  // Polls the write thread's telemetry while a write is running
+  QTimer progressTimer;
   bool writeFinished;
   DiskWriteThread* diskWriteThread;
   QString image_path;
   DeviceGuy device;
   QLabel bolded;
   QLabel whatsNext;
+  gondar::AutoFlashPanel autoFlash;
 };
 
 #endif  // SRC_WRITE_OPERATION_PAGE_H_
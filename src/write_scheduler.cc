@@ -0,0 +1,122 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "write_scheduler.h"
+
+#include <algorithm>
+
+#include "diskwritethread.h"
+#include "log.h"
+
+namespace gondar {
+
+WriteScheduler::WriteScheduler(const int writers_per_bus, QObject* parent)
+    : QObject(parent), writers_per_bus_(std::max(1, writers_per_bus)) {}
+
+WriteScheduler::~WriteScheduler() {
+  for (const auto& write : running_) {
+    write.thread->cancel();
+  }
+  for (const auto& write : running_) {
+    write.thread->wait();
+  }
+}
+
+bool WriteScheduler::enqueue(const DeviceGuy& device,
+                             const QString& image_path) {
+  if (std::find(active_.begin(), active_.end(), device) != active_.end()) {
+    LOG_WARNING << device << " already has a write, not queueing another";
+    return false;
+  }
+  active_.push_back(device);
+  const std::string bus_key = busKey(device);
+  LOG_INFO << "queueing write to " << device << " on bus " << bus_key;
+  buses_[bus_key].queued.push_back({device, image_path});
+  startQueued(bus_key);
+  return true;
+}
+
+int WriteScheduler::pending() const {
+  int count = 0;
+  for (const auto& entry : buses_) {
+    count += entry.second.running;
+    count += static_cast<int>(entry.second.queued.size());
+  }
+  return count;
+}
+
+const WriteTelemetry* WriteScheduler::telemetry(
+    const DeviceGuy& device) const {
+  for (const auto& write : running_) {
+    if (write.device == device) {
+      return &write.thread->telemetry();
+    }
+  }
+  return nullptr;
+}
+
+std::string WriteScheduler::busKey(const DeviceGuy& device) {
+  if (device.bus.empty()) {
+    // Nothing is known to share bandwidth with this device, so give it
+    // a bus of its own
+    return "device:" + std::to_string(device.device_num);
+  }
+  return device.bus;
+}
+
+void WriteScheduler::startQueued(const std::string& bus_key) {
+  Bus& bus = buses_[bus_key];
+  while (bus.running < writers_per_bus_ && !bus.queued.empty()) {
+    Write write = bus.queued.front();
+    bus.queued.pop_front();
+    bus.running++;
+
+    auto* thread =
+        new DiskWriteThread(&write.device, write.image_path, this);
+    const DeviceGuy device = write.device;
+    connect(thread, &DiskWriteThread::finished, this,
+            [this, thread, bus_key, device]() {
+              onWriteFinished(thread, bus_key, device);
+            });
+    running_.push_back({device, thread});
+    emit writeStarted(device);
+    thread->start();
+  }
+}
+
+void WriteScheduler::onWriteFinished(DiskWriteThread* thread,
+                                     const std::string& bus_key,
+                                     const DeviceGuy& device) {
+  const bool success = thread->state() == DiskWriteThread::State::Success;
+  active_.erase(std::remove(active_.begin(), active_.end(), device),
+                active_.end());
+
+  buses_[bus_key].running--;
+  emit writeFinished(device, success);
+  // Kept until now so that listeners can read its final progress
+  running_.erase(std::remove_if(running_.begin(), running_.end(),
+                                [thread](const Running& write) {
+                                  return write.thread == thread;
+                                }),
+                 running_.end());
+  thread->deleteLater();
+
+  startQueued(bus_key);
+  if (buses_[bus_key].running == 0) {
+    buses_.erase(bus_key);
+  }
+}
+
+}  // namespace gondar
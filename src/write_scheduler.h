@@ -0,0 +1,101 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_WRITE_SCHEDULER_H_
+#define SRC_WRITE_SCHEDULER_H_
+
+#include <QObject>
+#include <QString>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "device.h"
+
+class DiskWriteThread;
+
+namespace gondar {
+
+class WriteTelemetry;
+
+// Queues image writes and runs them on DiskWriteThreads, at most
+// |writers_per_bus| at a time for devices on the same bus, which is
+// their root hub where that is known. Sticks under one root hub split
+// its bandwidth however many hubs they are chained through, so
+// starting them all at once makes each of them slow without finishing
+// the batch any sooner; whenever a write finishes, the next one queued
+// on that bus takes its place. Devices whose bus is unknown are never
+// held back.
+class WriteScheduler : public QObject {
+  Q_OBJECT
+
+ public:
+  // Two writers are enough to keep a USB 2.0 root hub busy with
+  // typical flash sticks, which write well below its bandwidth
+  static const int default_writers_per_bus = 2;
+
+  explicit WriteScheduler(int writers_per_bus = default_writers_per_bus,
+                          QObject* parent = nullptr);
+  // Cancels running writes and waits for them to stop
+  ~WriteScheduler();
+
+  // Returns false, queueing nothing, if |device| already has a write
+  // queued or running
+  bool enqueue(const DeviceGuy& device, const QString& image_path);
+
+  // Writes that are queued or running
+  int pending() const;
+
+  // Progress of the running write to |device|, or null if it has none
+  // running. Also valid while writeFinished() is being emitted for it.
+  const WriteTelemetry* telemetry(const DeviceGuy& device) const;
+
+ signals:
+  void writeStarted(const DeviceGuy& device);
+  void writeFinished(const DeviceGuy& device, bool success);
+
+ private:
+  struct Write {
+    DeviceGuy device;
+    QString image_path;
+  };
+
+  struct Running {
+    DeviceGuy device;
+    DiskWriteThread* thread;
+  };
+
+  struct Bus {
+    std::deque<Write> queued;
+    int running = 0;
+  };
+
+  static std::string busKey(const DeviceGuy& device);
+  void startQueued(const std::string& bus_key);
+  void onWriteFinished(DiskWriteThread* thread,
+                       const std::string& bus_key,
+                       const DeviceGuy& device);
+
+  const int writers_per_bus_;
+  std::map<std::string, Bus> buses_;
+  // Devices with a write queued or running
+  DeviceGuyList active_;
+  std::vector<Running> running_;
+};
+
+}  // namespace gondar
+
+#endif  // SRC_WRITE_SCHEDULER_H_
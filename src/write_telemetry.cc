@@ -0,0 +1,99 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "write_telemetry.h"
+
+namespace gondar {
+
+WriteTelemetry::WriteTelemetry() {
+  for (auto& ms : stage_ms_) {
+    ms.store(0, std::memory_order_relaxed);
+  }
+}
+
+void WriteTelemetry::beginUpdate() {
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void WriteTelemetry::endUpdate() {
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+}
+
+void WriteTelemetry::setTotalBytes(const uint64_t total_bytes) {
+  beginUpdate();
+  total_bytes_.store(total_bytes, std::memory_order_relaxed);
+  endUpdate();
+}
+
+void WriteTelemetry::addBytes(const uint64_t bytes, const uint64_t next_lba) {
+  beginUpdate();
+  bytes_written_.store(
+      bytes_written_.load(std::memory_order_relaxed) + bytes,
+      std::memory_order_relaxed);
+  current_lba_.store(next_lba, std::memory_order_relaxed);
+  endUpdate();
+}
+
+void WriteTelemetry::addRetry() {
+  beginUpdate();
+  retries_.store(retries_.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  endUpdate();
+}
+
+void WriteTelemetry::beginStage(const Stage stage) {
+  stage_start_[static_cast<int>(stage)] = Clock::now();
+  beginUpdate();
+  stage_.store(static_cast<int>(stage), std::memory_order_relaxed);
+  endUpdate();
+}
+
+void WriteTelemetry::endStage(const Stage stage) {
+  const int index = static_cast<int>(stage);
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      Clock::now() - stage_start_[index]);
+  beginUpdate();
+  stage_ms_[index].store(elapsed.count(), std::memory_order_relaxed);
+  endUpdate();
+}
+
+WriteTelemetry::Snapshot WriteTelemetry::snapshot() const {
+  Snapshot snapshot;
+  while (true) {
+    const uint32_t before = sequence_.load(std::memory_order_acquire);
+    if (before % 2 == 1) {
+      // The writer is in the middle of an update
+      continue;
+    }
+    snapshot.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    snapshot.total_bytes = total_bytes_.load(std::memory_order_relaxed);
+    snapshot.retries = retries_.load(std::memory_order_relaxed);
+    snapshot.current_lba = current_lba_.load(std::memory_order_relaxed);
+    snapshot.stage =
+        static_cast<Stage>(stage_.load(std::memory_order_relaxed));
+    for (int i = 0; i < stage_count; i++) {
+      snapshot.stage_ms[i] = stage_ms_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == before) {
+      return snapshot;
+    }
+  }
+}
+
+}  // namespace gondar
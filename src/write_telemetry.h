@@ -0,0 +1,87 @@
+// Copyright 2026 Alex313031
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SRC_WRITE_TELEMETRY_H_
+#define SRC_WRITE_TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace gondar {
+
+// Progress of one disk write, published by the writing thread and read
+// by anyone else. The writer never waits: every update is a handful
+// of relaxed stores bracketed by a sequence counter, and readers retry
+// until they see a snapshot the writer did not touch while they were
+// reading it. Only one thread may write.
+class WriteTelemetry {
+ public:
+  enum class Stage {
+    // Clearing the old partition table and opening the drive
+    Partition,
+    Write,
+    // Refreshing the drive layout and closing the drive
+    Sync,
+  };
+  static const int stage_count = 3;
+
+  struct Snapshot {
+    uint64_t bytes_written = 0;
+    uint64_t total_bytes = 0;
+    uint32_t retries = 0;
+    uint64_t current_lba = 0;
+    // The stage begun most recently
+    Stage stage = Stage::Partition;
+    // Stages that have not finished yet read zero
+    int64_t stage_ms[stage_count] = {};
+  };
+
+  WriteTelemetry();
+
+  WriteTelemetry(const WriteTelemetry&) = delete;
+  WriteTelemetry& operator=(const WriteTelemetry&) = delete;
+
+  // Writer side
+  void setTotalBytes(uint64_t total_bytes);
+  void addBytes(uint64_t bytes, uint64_t next_lba);
+  void addRetry();
+  void beginStage(Stage stage);
+  void endStage(Stage stage);
+
+  // Reader side, from any thread
+  Snapshot snapshot() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // Make the sequence odd before an update and even again after it
+  void beginUpdate();
+  void endUpdate();
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+  std::atomic<uint64_t> total_bytes_{0};
+  std::atomic<uint32_t> retries_{0};
+  std::atomic<uint64_t> current_lba_{0};
+  std::atomic<int> stage_{0};
+  std::atomic<int64_t> stage_ms_[stage_count];
+  // Only touched by the writer
+  Clock::time_point stage_start_[stage_count];
+};
+
+}  // namespace gondar
+
+#endif  // SRC_WRITE_TELEMETRY_H_
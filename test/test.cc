@@ -16,15 +16,63 @@
 #include "test.h"
 
 #include <QAbstractButton>
+#include <QDir>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QTimer>
 #include <QUrl>
+#include <QUuid>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "zip.h"
+
+#include "src/async_log_appender.h"
+#include "src/block_map.h"
+#include "src/buffer_pool.h"
+#include "src/chunked_image.h"
 #include "src/device_picker.h"
+#include "src/diskwritethread.h"
+#include "src/downloader.h"
+#include "src/http_client.h"
+#include "src/image_analyzer.h"
+#include "src/image_prep.h"
 #include "src/log.h"
 #include "src/meepo.h"
+#include "src/meepo_cache.h"
+#include "src/metrics_queue.h"
+#include "src/neverware_unzipper.h"
+#include "src/peer_cache.h"
+#include "src/pipeline.h"
+#include "src/picker_models.h"
+#include "src/run_timings.h"
+#include "src/search_filter_model.h"
+#include "src/sidecar_check.h"
+#include "src/station_server.h"
+#include "src/task_pool.h"
+#include "src/trace.h"
+#include "src/write_scheduler.h"
+#include "src/write_telemetry.h"
 
 #if defined(Q_OS_WIN)
 Q_IMPORT_PLUGIN(QWindowsIntegrationPlugin);
@@ -39,6 +87,213 @@ QAbstractButton* getDevicePickerButton(DevicePicker* picker, const int index) {
   return dynamic_cast<QAbstractButton*>(widget);
 }
 
+// Remembers every buffer it is given
+class RecordingSink : public Sink {
+ public:
+  explicit RecordingSink(std::vector<BufferRef>* buffers, bool fail = false)
+      : Sink("record"), buffers_(buffers), fail_(fail) {}
+
+  bool write(const BufferRef& buffer) override {
+    buffers_->push_back(buffer);
+    return !fail_;
+  }
+
+ private:
+  std::vector<BufferRef>* buffers_;
+  const bool fail_;
+};
+
+// Passes buffers on untouched, counting the bytes that go through
+class CountingTransform : public Transform {
+ public:
+  explicit CountingTransform(uint64_t* bytes)
+      : Transform("count"), bytes_(bytes) {}
+
+  bool transform(const BufferRef& input, BufferRef* output) override {
+    *bytes_ += input->size();
+    *output = input;
+    return true;
+  }
+
+ private:
+  uint64_t* bytes_;
+};
+
+std::unique_ptr<QTemporaryFile> makeTestImage(const int size) {
+  std::unique_ptr<QTemporaryFile> file(new QTemporaryFile);
+  file->open();
+  QByteArray data(size, 0);
+  for (int i = 0; i < size; i++) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  file->write(data);
+  file->close();
+  return file;
+}
+
+// Serves one file over HTTP, |chunk| bytes every |interval_ms|,
+// honouring "Range: bytes=N-" and "bytes=N-M". Stands in for a mirror
+// with a given throughput.
+class ThrottledServer {
+ public:
+  ThrottledServer(const QByteArray& body, const int chunk,
+                  const int interval_ms)
+      : body_(body), chunk_(chunk), interval_ms_(interval_ms) {
+    server_.listen(QHostAddress::LocalHost);
+    QObject::connect(&server_, &QTcpServer::newConnection, [this]() {
+      while (QTcpSocket* socket = server_.nextPendingConnection()) {
+        serve(socket);
+      }
+    });
+  }
+
+  QUrl url() const {
+    return QUrl(QString("http://127.0.0.1:%1/image.bin")
+                    .arg(server_.serverPort()));
+  }
+
+  // Starting offsets of the requests made so far
+  const std::vector<qint64>& requests() const { return requests_; }
+
+  // Stop sending partway through any response once this many bytes of
+  // it have gone out, leaving the connection open
+  void stallAfter(const qint64 bytes) { stall_after_ = bytes; }
+
+  // Answer requests without a Range header, as opposed to the race's
+  // probes, with |status| and an error page
+  void failFullRequests(const QByteArray& status) { fail_status_ = status; }
+
+  // Send |etag| with every response, and the whole body to ranged
+  // requests whose If-Range differs from it
+  void setEtag(const QByteArray& etag) { etag_ = etag; }
+
+ private:
+  void serve(QTcpSocket* socket) {
+    auto request = std::make_shared<QByteArray>();
+    QObject::connect(socket, &QTcpSocket::disconnected, socket,
+                     &QObject::deleteLater);
+    QObject::connect(socket, &QTcpSocket::readyRead, socket,
+                     [this, socket, request]() {
+                       if (request->contains("\r\n\r\n")) {
+                         return;
+                       }
+                       *request += socket->readAll();
+                       if (request->contains("\r\n\r\n")) {
+                         respond(socket, *request);
+                       }
+                     });
+  }
+
+  void respond(QTcpSocket* socket, const QByteArray& request) {
+    qint64 start = 0;
+    qint64 end = body_.size() - 1;
+    const QByteArray prefix("Range: bytes=");
+    const int range = request.indexOf(prefix);
+    const QByteArray if_range("If-Range: ");
+    const int validator = request.indexOf(if_range);
+    const bool partial =
+        range >= 0 &&
+        (validator < 0 || etag_.isEmpty() ||
+         request.mid(validator + if_range.size(), etag_.size() + 2) ==
+             etag_ + "\r\n");
+    if (partial) {
+      const int from = range + prefix.size();
+      const QByteArray spec =
+          request.mid(from, request.indexOf("\r\n", from) - from);
+      const QList<QByteArray> bounds = spec.split('-');
+      start = bounds[0].toLongLong();
+      if (bounds.size() > 1 && !bounds[1].isEmpty()) {
+        end = std::min(end, bounds[1].toLongLong());
+      }
+    }
+    requests_.push_back(start);
+
+    if (!partial && !fail_status_.isEmpty()) {
+      const QByteArray page = "<html><body>try again later</body></html>";
+      socket->write("HTTP/1.1 " + fail_status_ + "\r\nContent-Length: " +
+                    QByteArray::number(page.size()) +
+                    "\r\nConnection: close\r\n\r\n" + page);
+      socket->disconnectFromHost();
+      return;
+    }
+
+    QByteArray headers = partial ? "HTTP/1.1 206 Partial Content\r\n"
+                                 : "HTTP/1.1 200 OK\r\n";
+    if (!etag_.isEmpty()) {
+      headers += "ETag: " + etag_ + "\r\n";
+    }
+    if (partial) {
+      headers += "Content-Range: bytes " + QByteArray::number(start) + "-" +
+                 QByteArray::number(end) + "/" +
+                 QByteArray::number(body_.size()) + "\r\n";
+    }
+    headers += "Content-Length: " + QByteArray::number(end - start + 1) +
+               "\r\nConnection: close\r\n\r\n";
+    socket->write(headers);
+
+    auto* timer = new QTimer(socket);
+    auto pos = std::make_shared<qint64>(start);
+    QObject::connect(timer, &QTimer::timeout, socket,
+                     [this, socket, timer, start, end, pos]() {
+                       qint64 stop = std::min(end + 1, *pos + chunk_);
+                       if (stall_after_ >= 0) {
+                         stop = std::min(stop, start + stall_after_);
+                       }
+                       if (stop > *pos) {
+                         socket->write(body_.mid(*pos, stop - *pos));
+                         *pos = stop;
+                       }
+                       if (*pos == end + 1) {
+                         timer->stop();
+                         socket->disconnectFromHost();
+                       }
+                     });
+    timer->start(interval_ms_);
+  }
+
+  QTcpServer server_;
+  const QByteArray body_;
+  const int chunk_;
+  const int interval_ms_;
+  qint64 stall_after_ = -1;
+  QByteArray fail_status_;
+  QByteArray etag_;
+  std::vector<qint64> requests_;
+};
+
+QByteArray makeMirrorBody(const int size) {
+  QByteArray body(size, 0);
+  for (int i = 0; i < size; i++) {
+    body[i] = static_cast<char>(i % 253);
+  }
+  return body;
+}
+
+// A zip at |path| holding |contents| as its one entry, |entry|
+bool writeTestZip(const QString& path,
+                  const char* entry,
+                  const QByteArray& contents) {
+  zipFile zip = zipOpen64(path.toStdString().c_str(), APPEND_STATUS_CREATE);
+  if (zip == nullptr) {
+    return false;
+  }
+  zip_fileinfo info = {};
+  const bool ok =
+      zipOpenNewFileInZip64(zip, entry, &info, nullptr, 0, nullptr, 0,
+                            nullptr, Z_DEFLATED, Z_DEFAULT_COMPRESSION,
+                            1) == ZIP_OK &&
+      zipWriteInFileInZip(zip, contents.constData(),
+                          static_cast<unsigned>(contents.size())) == ZIP_OK &&
+      zipCloseFileInZip(zip) == ZIP_OK;
+  return zipClose(zip, nullptr) == ZIP_OK && ok;
+}
+
+QByteArray readAll(const QString& path) {
+  QFile file(path);
+  file.open(QIODevice::ReadOnly);
+  return file.readAll();
+}
+
 }  // namespace
 
 uint64_t getValidDiskSize() {
@@ -46,6 +301,159 @@ uint64_t getValidDiskSize() {
   return 10 * gigabyte;
 }
 
+void Test::testAsyncLogAppenderRollsFiles() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString path = dir.filePath("test.log");
+
+  // A separate plog instance so the app's own log is left alone
+  const int instance = 1;
+  AsyncLogAppender appender(path, 1024, 2, false);
+  plog::init<instance>(plog::debug, &appender);
+  for (int i = 0; i < 100; i++) {
+    LOG_INFO_(instance) << "line " << i;
+  }
+  appender.flush();
+
+  QFile current(path);
+  QVERIFY(current.open(QIODevice::ReadOnly));
+  const QByteArray contents = current.readAll();
+  QVERIFY(contents.size() <= 1024);
+  QVERIFY(contents.endsWith("line 99\n"));
+  QVERIFY(QFile::exists(dir.filePath("test.1.log")));
+  QVERIFY(!QFile::exists(dir.filePath("test.2.log")));
+}
+
+void Test::testBlockMapParses() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  // Three 4 KiB blocks, the last one short, with a hole in the middle
+  const QByteArray head(4096, 'a');
+  const QByteArray tail(1000, 'c');
+  const QString image_path = dir.filePath("image.bin");
+  QFile image(image_path);
+  QVERIFY(image.open(QIODevice::WriteOnly));
+  image.write(head);
+  image.write(QByteArray(4096, '\0'));
+  image.write(tail);
+  image.close();
+
+  auto sha256 = [](const QByteArray& data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex();
+  };
+  auto writeBmap = [&](const QByteArray& tail_checksum) {
+    QFile bmap(dir.filePath("image.bmap"));
+    QVERIFY(bmap.open(QIODevice::WriteOnly));
+    bmap.write("<?xml version=\"1.0\" ?>\n<bmap version=\"2.0\">\n"
+               "<ImageSize> 9192 </ImageSize>\n"
+               "<BlockSize> 4096 </BlockSize>\n"
+               "<BlocksCount> 3 </BlocksCount>\n"
+               "<MappedBlocksCount> 2 </MappedBlocksCount>\n"
+               "<ChecksumType> sha256 </ChecksumType>\n"
+               "<BlockMap>\n<Range chksum=\"" +
+               sha256(head) + "\"> 0 </Range>\n<Range chksum=\"" +
+               tail_checksum + "\"> 2 </Range>\n</BlockMap>\n</bmap>\n");
+  };
+
+  writeBmap(sha256(tail));
+  auto map = BlockMap::findFor(image_path, 9192);
+  QVERIFY(map != nullopt);
+  QCOMPARE(map->blockSize(), static_cast<uint32_t>(4096));
+  QCOMPARE(map->checksumType(), QCryptographicHash::Sha256);
+  QCOMPARE(map->ranges().size(), static_cast<size_t>(2));
+  QCOMPARE(map->rangeStart(map->ranges()[1]), static_cast<uint64_t>(8192));
+  QCOMPARE(map->rangeEnd(map->ranges()[1]), static_cast<uint64_t>(9192));
+  QCOMPARE(map->mappedBytes(), static_cast<uint64_t>(5096));
+  QCOMPARE(map->ranges()[1].checksum, sha256(tail));
+
+  // A map for some other image is not used
+  QVERIFY(BlockMap::findFor(image_path, 4096) == nullopt);
+
+  // Neither is one with a malformed checksum
+  writeBmap("abc");
+  QString error;
+  QVERIFY(BlockMap::load(dir.filePath("image.bmap"), &error) == nullopt);
+  QVERIFY(!error.isEmpty());
+  QVERIFY(BlockMap::findFor(image_path, 9192) == nullopt);
+}
+
+void Test::testBufferPoolReusesBlocks() {
+  BufferPool pool(64 * 1024);
+
+  // Sizes are rounded up to a power of two
+  size_t capacity = 0;
+  uint8_t* block = pool.acquire(5000, &capacity);
+  QVERIFY(block);
+  QCOMPARE(capacity, static_cast<size_t>(8192));
+  QCOMPARE(reinterpret_cast<uintptr_t>(block) % buffer_alignment,
+           static_cast<uintptr_t>(0));
+  pool.release(block, capacity);
+  QCOMPARE(pool.stats().cached_bytes, static_cast<size_t>(8192));
+
+  // The parked block is handed out again
+  size_t again_capacity = 0;
+  QCOMPARE(pool.acquire(6000, &again_capacity), block);
+  QCOMPARE(pool.stats().reuses, static_cast<uint64_t>(1));
+
+  // Anything that would go over the budget is turned down
+  size_t big_capacity = 0;
+  QVERIFY(!pool.acquire(60 * 1024, &big_capacity));
+  QCOMPARE(pool.stats().refusals, static_cast<uint64_t>(1));
+
+  pool.release(block, again_capacity);
+  const auto stats = pool.stats();
+  QCOMPARE(stats.in_use_bytes, static_cast<size_t>(0));
+  QCOMPARE(stats.peak_in_use_bytes, static_cast<size_t>(8192));
+  QCOMPARE(stats.allocations, static_cast<uint64_t>(1));
+}
+
+void Test::testChunkedExtractionsRunConcurrently() {
+  // More extractions than workers, so every worker is busy extracting
+  // while its chunk helpers are still queued behind it
+  TaskPool* pool = TaskPool::instance();
+  const int count = pool->workerCount() + 1;
+  const int chunk_size = 64 * 1024;
+  QByteArray contents;
+  for (int i = 0; i < 16 * chunk_size + 17; i++) {
+    contents.append(static_cast<char>((i * 13) ^ (i >> 9)));
+  }
+
+  std::vector<std::unique_ptr<QTemporaryDir>> dirs;
+  std::vector<QString> archives;
+  for (int i = 0; i < count; i++) {
+    dirs.emplace_back(new QTemporaryDir);
+    QVERIFY(dirs.back()->isValid());
+    const QString image_path = dirs.back()->filePath("test.bin");
+    QFile image(image_path);
+    QVERIFY(image.open(QIODevice::WriteOnly));
+    image.write(contents);
+    image.close();
+    ImagePrepResult result;
+    QString error;
+    QVERIFY(PrepareImage(image_path, dirs.back()->path(), chunk_size, &result,
+                         &error));
+    QVERIFY(QFile::remove(image_path));
+    archives.push_back(result.archive_path);
+  }
+
+  std::vector<std::future<void>> extractions;
+  for (const QString& archive : archives) {
+    extractions.push_back(
+        pool->submit([archive]() { neverware_unzip(QFileInfo(archive)); }));
+  }
+  for (auto& extraction : extractions) {
+    QVERIFY(extraction.wait_for(std::chrono::seconds(30)) ==
+            std::future_status::ready);
+    extraction.get();
+  }
+  for (const auto& dir : dirs) {
+    QFile image(dir->filePath("test.bin"));
+    QVERIFY(image.open(QIODevice::ReadOnly));
+    QVERIFY(image.readAll() == contents);
+  }
+}
+
 void Test::testDevicePicker() {
   DevicePicker picker;
   QVERIFY(picker.selectedDevice() == nullopt);
@@ -70,6 +478,367 @@ void Test::testDevicePicker() {
   QCOMPARE(*picker.selectedDevice(), DeviceGuy(3, "c", getValidDiskSize()));
 }
 
+void Test::testDevicePickerKeepsSelection() {
+  DevicePicker picker;
+  picker.refresh({DeviceGuy(1, "a", getValidDiskSize()),
+                  DeviceGuy(2, "b", getValidDiskSize())});
+
+  // Select the second device
+  auto* selected = getDevicePickerButton(&picker, 1);
+  selected->click();
+
+  // Add a device in front and drop the first one; the button for the
+  // selected device is reused and stays checked
+  QSignalSpy spy(&picker, &DevicePicker::selectionChanged);
+  picker.refresh({DeviceGuy(3, "c", getValidDiskSize()),
+                  DeviceGuy(2, "b", getValidDiskSize())});
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(picker.layout()->count(), 2);
+  QCOMPARE(getDevicePickerButton(&picker, 1), selected);
+  QCOMPARE(*picker.selectedDevice(), DeviceGuy(2, "b", getValidDiskSize()));
+
+  // Refreshing with an identical list changes nothing
+  picker.refresh({DeviceGuy(3, "c", getValidDiskSize()),
+                  DeviceGuy(2, "b", getValidDiskSize())});
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(*picker.selectedDevice(), DeviceGuy(2, "b", getValidDiskSize()));
+}
+
+void Test::testDiskWriteThreadCancel() {
+  auto image = makeTestImage(1000);
+  DeviceGuy device(1, "a", getValidDiskSize());
+
+  DiskWriteThread thread(&device, image->fileName());
+  thread.cancel();
+  thread.start();
+  QVERIFY(thread.wait(5000));
+  QVERIFY(thread.state() == DiskWriteThread::State::Cancelled);
+
+  // Without a cancel the same write goes through
+  DiskWriteThread other(&device, image->fileName());
+  other.start();
+  QVERIFY(other.wait(5000));
+  QVERIFY(other.state() == DiskWriteThread::State::Success);
+}
+
+void Test::testDownloadManagerPicksFastestMirror() {
+  QStandardPaths::setTestModeEnabled(true);
+  const QByteArray body = makeMirrorBody(256 * 1024);
+  ThrottledServer slow(body, 1024, 50);
+  ThrottledServer fast(body, 64 * 1024, 5);
+
+  DownloadManager manager;
+  QSignalSpy finished(&manager, &DownloadManager::finished);
+  manager.appendMirrors({slow.url(), fast.url()});
+  QVERIFY(finished.wait(10000));
+
+  QVERIFY(!manager.hasError());
+  QCOMPARE(readAll(manager.outputFileInfo().filePath()), body);
+  // the fast mirror served both its probe and the download
+  QCOMPARE(fast.requests().size(), size_t(2));
+  QCOMPARE(slow.requests().size(), size_t(1));
+}
+
+void Test::testDownloadManagerRestartsChangedFile() {
+  QStandardPaths::setTestModeEnabled(true);
+  const QByteArray old_body = makeMirrorBody(1024 * 1024);
+  // Another release of the file, which must not be spliced onto the
+  // part of the old one already downloaded
+  QByteArray new_body = makeMirrorBody(1024 * 1024 + 4096);
+  new_body[0] = 'n';
+
+  {
+    // Wins the race, then stalls partway through the download
+    ThrottledServer stalling(old_body, 64 * 1024, 5);
+    stalling.stallAfter(600 * 1024);
+    stalling.setEtag("\"old\"");
+    ThrottledServer changed(new_body, 16 * 1024, 10);
+    changed.setEtag("\"new\"");
+
+    DownloadManager manager;
+    manager.setMinThroughput(64 * 1024, 200);
+    QSignalSpy finished(&manager, &DownloadManager::finished);
+    manager.appendMirrors({stalling.url(), changed.url()});
+    QVERIFY(finished.wait(10000));
+
+    QVERIFY(!manager.hasError());
+    QCOMPARE(readAll(manager.outputFileInfo().filePath()), new_body);
+    // The ETag didn't match, so the whole file came back
+    QCOMPARE(changed.requests().back(), qint64(0));
+  }
+
+  {
+    // Without ETags the length still gives the change away
+    ThrottledServer stalling(old_body, 64 * 1024, 5);
+    stalling.stallAfter(600 * 1024);
+    ThrottledServer changed(new_body, 16 * 1024, 10);
+
+    DownloadManager manager;
+    manager.setMinThroughput(64 * 1024, 200);
+    QSignalSpy finished(&manager, &DownloadManager::finished);
+    manager.appendMirrors({stalling.url(), changed.url()});
+    QVERIFY(finished.wait(10000));
+
+    QVERIFY(!manager.hasError());
+    QCOMPARE(readAll(manager.outputFileInfo().filePath()), new_body);
+    // Asked to resume, then started over
+    const auto& requests = changed.requests();
+    QCOMPARE(requests.back(), qint64(0));
+    QCOMPARE(requests[requests.size() - 2], qint64(600 * 1024));
+  }
+}
+
+void Test::testDownloadManagerSkipsErrorPages() {
+  QStandardPaths::setTestModeEnabled(true);
+  const QByteArray body = makeMirrorBody(256 * 1024);
+  // wins the race, then answers the download with an error page
+  ThrottledServer failing(body, 64 * 1024, 5);
+  failing.failFullRequests("503 Service Unavailable");
+  ThrottledServer steady(body, 16 * 1024, 10);
+
+  DownloadManager manager;
+  QSignalSpy finished(&manager, &DownloadManager::finished);
+  manager.appendMirrors({failing.url(), steady.url()});
+  QVERIFY(finished.wait(10000));
+
+  QVERIFY(!manager.hasError());
+  QCOMPARE(readAll(manager.outputFileInfo().filePath()), body);
+  // none of the error page was kept, so the download started over
+  QCOMPARE(steady.requests().back(), qint64(0));
+
+  // with no mirror to fall back on, the download fails
+  DownloadManager alone;
+  QSignalSpy alone_finished(&alone, &DownloadManager::finished);
+  alone.append(failing.url());
+  QVERIFY(alone_finished.wait(10000));
+  QVERIFY(alone.hasError());
+}
+
+void Test::testDownloadManagerSwitchesSlowMirror() {
+  QStandardPaths::setTestModeEnabled(true);
+  const QByteArray body = makeMirrorBody(1024 * 1024);
+  // wins the race, then stalls partway through the download
+  ThrottledServer stalling(body, 64 * 1024, 5);
+  stalling.stallAfter(600 * 1024);
+  ThrottledServer steady(body, 16 * 1024, 10);
+
+  DownloadManager manager;
+  manager.setMinThroughput(64 * 1024, 200);
+  QSignalSpy finished(&manager, &DownloadManager::finished);
+  manager.appendMirrors({stalling.url(), steady.url()});
+  QVERIFY(finished.wait(10000));
+
+  QVERIFY(!manager.hasError());
+  QCOMPARE(readAll(manager.outputFileInfo().filePath()), body);
+  // the steady mirror picked up where the stalled one left off
+  QCOMPARE(steady.requests().size(), size_t(2));
+  QCOMPARE(steady.requests().back(), qint64(600 * 1024));
+}
+
+void Test::testImageAnalyzerSkipsFreeBlocks() {
+  // A 300-sector image with a tiny ext4 filesystem of 4 KiB blocks in
+  // a data partition, and a ChromeOS root partition after it
+  const uint64_t image_size = 300 * 512;
+  const uint64_t fs = 8 * 512;
+  QByteArray image(static_cast<int>(image_size), '\0');
+  auto put16 = [&](const uint64_t at, const quint16 value) {
+    qToLittleEndian(value, reinterpret_cast<uchar*>(image.data() + at));
+  };
+  auto put32 = [&](const uint64_t at, const quint32 value) {
+    qToLittleEndian(value, reinterpret_cast<uchar*>(image.data() + at));
+  };
+  const uint64_t sb = fs + 1024;
+  put32(sb + 0x4, 16);       // blocks
+  put32(sb + 0x14, 0);       // first data block
+  put32(sb + 0x18, 2);       // 4 KiB blocks
+  put32(sb + 0x20, 32768);   // blocks per group
+  put32(sb + 0x28, 16);      // inodes per group
+  put16(sb + 0x38, 0xef53);  // magic
+  put32(sb + 0x4c, 1);       // dynamic revision
+  put16(sb + 0x58, 256);     // inode size
+  put32(sb + 0x64, 1);       // sparse_super
+  // One group: bitmaps in blocks 3 and 4, inode table in block 5
+  const uint64_t gdt = fs + 4096;
+  put32(gdt, 3);
+  put32(gdt + 0x4, 4);
+  put32(gdt + 0x8, 5);
+  // Blocks 0-5 and 10 are in use
+  image[static_cast<int>(fs + 3 * 4096)] = static_cast<char>(0x3f);
+  image[static_cast<int>(fs + 3 * 4096 + 1)] = static_cast<char>(0x04);
+
+  // A GPT with four entries in sector 2, two of them used
+  auto put64 = [&](const uint64_t at, const quint64 value) {
+    qToLittleEndian(value, reinterpret_cast<uchar*>(image.data() + at));
+  };
+  auto putGuid = [&](const uint64_t at, const QUuid& guid) {
+    put32(at, guid.data1);
+    put16(at + 4, guid.data2);
+    put16(at + 6, guid.data3);
+    for (int i = 0; i < 8; i++) {
+      image[static_cast<int>(at + 8 + i)] = static_cast<char>(guid.data4[i]);
+    }
+  };
+  auto gptCrc = [&](const uint64_t at, const uint64_t size) {
+    quint32 crc = 0xffffffff;
+    for (uint64_t i = at; i < at + size; i++) {
+      crc ^= static_cast<uchar>(image[static_cast<int>(i)]);
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+      }
+    }
+    return ~crc;
+  };
+  const uint64_t entries = 2 * 512;
+  putGuid(entries, QUuid("{0fc63daf-8483-4772-8e79-3d69d8477de4}"));
+  put64(entries + 32, 8);
+  put64(entries + 40, 135);
+  putGuid(entries + 128, QUuid("{3cb8e202-3b7e-47dd-8a3c-7ff2a13cfcec}"));
+  put64(entries + 128 + 32, 200);
+  put64(entries + 128 + 40, 215);
+  image.replace(512, 8, "EFI PART");
+  put32(512 + 12, 92);   // header size
+  put64(512 + 72, 2);    // entries LBA
+  put32(512 + 80, 4);    // entry count
+  put32(512 + 84, 128);  // entry size
+  put32(512 + 88, gptCrc(entries, 4 * 128));
+  put32(512 + 16, gptCrc(512, 92));
+
+  QTemporaryFile file;
+  QVERIFY(file.open());
+  file.write(image);
+  file.close();
+
+  uint32_t sector_size = 0;
+  std::vector<PartitionExtent> partitions;
+  QVERIFY(ReadImagePartitions(file.fileName(), &sector_size, &partitions));
+  QCOMPARE(sector_size, static_cast<uint32_t>(512));
+  QCOMPARE(partitions.size(), static_cast<size_t>(2));
+  PartitionExtent data = partitions[0];
+  QCOMPARE(data.first_lba, static_cast<uint64_t>(8));
+  QCOMPARE(data.last_lba, static_cast<uint64_t>(135));
+  QCOMPARE(data.type, static_cast<uint16_t>(0x8300));
+  const PartitionExtent root = partitions[1];
+  QCOMPARE(root.first_lba, static_cast<uint64_t>(200));
+  QCOMPARE(root.last_lba, static_cast<uint64_t>(215));
+  QCOMPARE(root.type, static_cast<uint16_t>(0x7f01));
+
+  const auto map =
+      AnalyzeImage(file.fileName(), image_size, 512, {data, root});
+  QVERIFY(map != nullopt);
+  QCOMPARE(map->blockSize(), static_cast<uint32_t>(4096));
+  // GPT and the used filesystem blocks, the one block past the hole,
+  // then the root partition and backup GPT
+  QCOMPARE(map->ranges().size(), static_cast<size_t>(3));
+  QCOMPARE(map->ranges()[0].last, static_cast<uint64_t>(6));
+  QCOMPARE(map->ranges()[1].first, static_cast<uint64_t>(11));
+  QCOMPARE(map->ranges()[1].last, static_cast<uint64_t>(11));
+  QCOMPARE(map->ranges()[2].first, static_cast<uint64_t>(25));
+  QCOMPARE(map->mappedBytes(), static_cast<uint64_t>(8 * 4096 + 51200));
+  QVERIFY(map->ranges()[0].checksum.isEmpty());
+
+  // Nothing comes of a cancelled analysis
+  const std::atomic<bool> cancel{true};
+  QVERIFY(AnalyzeImage(file.fileName(), image_size, 512, {data, root},
+                       &cancel) == nullopt);
+
+  // A root partition is kept whole even if it holds an ext filesystem
+  data.type = 0x7f01;
+  const auto whole =
+      AnalyzeImage(file.fileName(), image_size, 512, {data, root});
+  QVERIFY(whole != nullopt);
+  QCOMPARE(whole->ranges().size(), static_cast<size_t>(2));
+  QCOMPARE(whole->ranges()[0].last, static_cast<uint64_t>(16));
+
+  // A damaged entry array means no partitions at all
+  QVERIFY(file.open());
+  QVERIFY(file.seek(static_cast<qint64>(entries + 32)));
+  file.write(QByteArray(1, '\x09'));
+  file.close();
+  partitions.clear();
+  QVERIFY(!ReadImagePartitions(file.fileName(), &sector_size, &partitions));
+  QVERIFY(partitions.empty());
+}
+
+void Test::testImagePrepRoundTrips() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString image_path = dir.filePath("test.bin");
+  const int mib = 1024 * 1024;
+  QByteArray contents;
+  for (int i = 0; i < 3 * mib + 123; i++) {
+    contents.append(static_cast<char>((i * 7) ^ (i >> 11)));
+  }
+  QFile image(image_path);
+  QVERIFY(image.open(QIODevice::WriteOnly));
+  image.write(contents);
+  image.close();
+
+  ImagePrepResult result;
+  QString error;
+  QVERIFY(PrepareImage(image_path, dir.path(), mib, &result, &error));
+  QCOMPARE(result.image_size, static_cast<uint64_t>(contents.size()));
+
+  QFile manifest_file(result.manifest_path);
+  QVERIFY(manifest_file.open(QIODevice::ReadOnly));
+  const QByteArray manifest_data = manifest_file.readAll();
+  const auto manifest = ChunkManifest::parse(manifest_data);
+  QVERIFY(manifest != nullopt);
+  QCOMPARE(manifest->image_name, QString("test.bin"));
+  QCOMPARE(manifest->chunkCount(), static_cast<size_t>(4));
+  QCOMPARE(manifest->chunkLength(3), static_cast<uint64_t>(123));
+  // A chunk missing, and a name that leads out of the directory
+  QVERIFY(ChunkManifest::parse(manifest_data.left(
+              manifest_data.lastIndexOf('\n', -2) + 1)) == nullopt);
+  QVERIFY(ChunkManifest::parse(QByteArray(manifest_data).replace(
+              "test.bin", "../x.bin")) == nullopt);
+
+  // Without a GPT the whole image is mapped, and the map is found next
+  // to the image
+  const auto map = BlockMap::findFor(image_path, result.image_size);
+  QVERIFY(map != nullopt);
+  QCOMPARE(map->mappedBytes(), result.image_size);
+  QVERIFY(!map->ranges()[0].checksum.isEmpty());
+  QCOMPARE(ReadSha256Sidecar(image_path),
+           QCryptographicHash::hash(contents, QCryptographicHash::Sha256)
+               .toHex());
+
+  // The archive reassembles into the same image
+  QVERIFY(QFile::remove(image_path));
+  const QFileInfo extracted = neverware_unzip(QFileInfo(result.archive_path));
+  QCOMPARE(extracted.absoluteFilePath(),
+           QFileInfo(image_path).absoluteFilePath());
+  QFile reassembled(image_path);
+  QVERIFY(reassembled.open(QIODevice::ReadOnly));
+  QVERIFY(reassembled.readAll() == contents);
+}
+
+void Test::testMeepoCacheIgnoresToken() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  MeepoCache cache(dir.path());
+  const QUrl url("https://api.example.com/poof/sites?token=one&page=2");
+  const QUrl next_login("https://api.example.com/poof/sites?token=two&page=2");
+  QByteArray body;
+
+  // Nothing is cached until there is an account to key it by
+  cache.store(url, "\"v1\"", "", "{}");
+  QVERIFY(!cache.lookup(url, &body));
+
+  cache.setAccount("user@example.com");
+  cache.store(url, "\"v1\"", "", "{\"sites\":[]}");
+  QVERIFY(cache.lookup(next_login, &body));
+  QCOMPARE(body, QByteArray("{\"sites\":[]}"));
+
+  QNetworkRequest request(next_login);
+  cache.addValidators(&request);
+  QCOMPARE(request.rawHeader("If-None-Match"), QByteArray("\"v1\""));
+  QVERIFY(!request.hasRawHeader("If-Modified-Since"));
+
+  // Another account does not see the entry
+  cache.setAccount("other@example.com");
+  QVERIFY(!cache.lookup(next_login, &body));
+}
+
 void Test::testMeepoGetMetricJson() {
   Meepo meepo;
   meepo.setSiteId(3);
@@ -105,6 +874,509 @@ void Test::testMeepoGetMetricRequest() {
   QCOMPARE(actual_request.url(), expected_url);
 }
 
+void Test::testMetricsQueuePersistsEvents() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString path = dir.filePath("metrics");
+  const QUrl url("http://127.0.0.1:1/");
+
+  {
+    MetricsQueue queue(path, url, QByteArray());
+    QCOMPARE(queue.queued(), 0);
+    queue.enqueue({{"metric", "a"}});
+    queue.enqueue({{"metric", "b"}});
+    QCOMPARE(queue.queued(), 2);
+  }
+
+  // Nothing was sent, so a later run picks the events up again
+  MetricsQueue queue(path, url, QByteArray());
+  QCOMPARE(queue.queued(), 2);
+}
+
+void Test::testNeverwareUnzipCancelsMidStream() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString zip_path = dir.filePath("image.zip");
+  // Big enough that extraction is still going when it is cancelled
+  QVERIFY(writeTestZip(zip_path, "image.bin",
+                       QByteArray(256 * 1024 * 1024, 'x')));
+  const QString output_path = dir.filePath("image.bin");
+
+  std::atomic<bool> cancel{false};
+  auto result = std::async(std::launch::async, [&zip_path, &cancel]() {
+    return neverware_unzip(QFileInfo(zip_path), &cancel);
+  });
+  // Cancel once part of the output has been written
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (QFileInfo(output_path).size() == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  cancel = true;
+  QVERIFY_EXCEPTION_THROWN(result.get(), std::runtime_error);
+  QVERIFY(!QFile::exists(output_path));
+}
+
+void Test::testNeverwareUnzipExtractsFirstFile() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  QByteArray contents;
+  for (int i = 0; i < 3 * 1024 * 1024 + 5; i++) {
+    contents.append(static_cast<char>((i * 11) ^ (i >> 13)));
+  }
+  const QString zip_path = dir.filePath("image.zip");
+  QVERIFY(writeTestZip(zip_path, "image.bin", contents));
+
+  // Extracted into the given directory rather than next to the zip
+  QVERIFY(QDir(dir.path()).mkdir("out"));
+  const QString out_dir = dir.filePath("out");
+  const QFileInfo extracted =
+      neverware_unzip(QFileInfo(zip_path), nullptr, out_dir);
+  QCOMPARE(extracted.absoluteFilePath(),
+           QFileInfo(QDir(out_dir).filePath("image.bin")).absoluteFilePath());
+  QFile image(extracted.absoluteFilePath());
+  QVERIFY(image.open(QIODevice::ReadOnly));
+  QVERIFY(image.readAll() == contents);
+  QVERIFY(!QFile::exists(dir.filePath("image.bin")));
+
+  // A cancelled extraction leaves nothing behind
+  const std::atomic<bool> cancel{true};
+  QVERIFY_EXCEPTION_THROWN(neverware_unzip(QFileInfo(zip_path), &cancel),
+                           std::runtime_error);
+  QVERIFY(!QFile::exists(dir.filePath("image.bin")));
+}
+
+void Test::testNeverwareUnzipKeepsEntriesInDir() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  QVERIFY(QDir(dir.path()).mkdir("zips"));
+  const QDir zips(dir.filePath("zips"));
+  const QByteArray contents(100000, 'x');
+
+  // Directories in the entry's name are dropped
+  const QString nested = zips.filePath("nested.zip");
+  QVERIFY(writeTestZip(nested, "dir/image.bin", contents));
+  const QFileInfo extracted = neverware_unzip(QFileInfo(nested));
+  QCOMPARE(extracted.absoluteFilePath(),
+           QFileInfo(zips.filePath("image.bin")).absoluteFilePath());
+  QCOMPARE(readAll(extracted.absoluteFilePath()), contents);
+
+  // An entry leading out of the directory is refused
+  const QString escaping = zips.filePath("escaping.zip");
+  QVERIFY(writeTestZip(escaping, "../escaped.bin", contents));
+  QVERIFY_EXCEPTION_THROWN(neverware_unzip(QFileInfo(escaping)),
+                           std::runtime_error);
+  QVERIFY(!QFile::exists(dir.filePath("escaped.bin")));
+  QVERIFY(!QFile::exists(zips.filePath("escaped.bin")));
+}
+
+void Test::testPeerCacheServesRanges() {
+  QTemporaryDir dir;
+  const QString path = dir.filePath("image.zip");
+  const QByteArray body = makeMirrorBody(300 * 1024);
+  {
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(body);
+  }
+  const QByteArray sha256 = Sha256File(path);
+  QCOMPARE(sha256.size(), 64);
+
+  auto get = [](const QUrl& url, const QByteArray& range) {
+    QNetworkRequest request = CreateRequest(url);
+    if (!range.isEmpty()) {
+      request.setRawHeader("Range", range);
+    }
+    QNetworkReply* reply = GetNetworkManager()->get(request);
+    QSignalSpy finished(reply, &QNetworkReply::finished);
+    finished.wait(5000);
+    reply->deleteLater();
+    return reply;
+  };
+
+  {
+    // Ports picked by the system, so parallel runs don't collide
+    PeerCache cache{QDir(dir.path())};
+    QVERIFY(cache.start(0, 0));
+    QVERIFY(cache.httpPort() > 0);
+    QVERIFY(cache.lookupPort() > 0);
+    const QString base =
+        QString("http://127.0.0.1:%1/images/").arg(cache.httpPort());
+    // nothing is served until it is shared
+    QVERIFY(get(QUrl(base + "image.zip"), "")->error() !=
+            QNetworkReply::NoError);
+    cache.share(path, sha256);
+
+    QNetworkReply* reply = get(QUrl(base + "image.zip"), "bytes=1000-");
+    QCOMPARE(
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+        206);
+    QCOMPARE(reply->readAll(), body.mid(1000));
+    QCOMPARE(get(QUrl(base + "image.zip.sha256"), "")->readAll(), sha256);
+    QVERIFY(get(QUrl(base + "other.zip"), "")->error() !=
+            QNetworkReply::NoError);
+  }
+
+  // the sidecar brings the file back on the next run
+  PeerCache cache{QDir(dir.path())};
+  QVERIFY(cache.start(0, 0));
+  const auto shared = cache.find("image.zip");
+  QVERIFY(static_cast<bool>(shared));
+  QCOMPARE(shared->sha256, sha256);
+  QCOMPARE(shared->size, qint64(body.size()));
+  cache.unshare(path);
+  QVERIFY(!cache.find("image.zip"));
+}
+
+void Test::testPipelineSharesBuffersBetweenSinks() {
+  // Two and a half buffers' worth
+  const int size = 10000;
+  auto image = makeTestImage(size);
+
+  uint64_t counted = 0;
+  std::vector<BufferRef> first;
+  std::vector<BufferRef> second;
+  Pipeline pipeline(2);
+  pipeline.setSource(std::unique_ptr<Source>(
+      new FileSource(image->fileName(), buffer_alignment)));
+  pipeline.addTransform(
+      std::unique_ptr<Transform>(new CountingTransform(&counted)));
+  pipeline.addSink(std::unique_ptr<Sink>(new RecordingSink(&first)));
+  pipeline.addSink(std::unique_ptr<Sink>(new RecordingSink(&second)));
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString copy_path = dir.filePath("copy.bin");
+  pipeline.addSink(std::unique_ptr<Sink>(new FileSink(copy_path)));
+  QVERIFY(pipeline.run());
+
+  QCOMPARE(counted, static_cast<uint64_t>(size));
+  QCOMPARE(first.size(), static_cast<size_t>(3));
+  QByteArray written;
+  for (size_t i = 0; i < first.size(); i++) {
+    // Both sinks got the very same buffer, not a copy
+    QCOMPARE(first[i].get(), second[i].get());
+    QCOMPARE(first[i]->offset(), static_cast<uint64_t>(written.size()));
+    QCOMPARE(reinterpret_cast<uintptr_t>(first[i]->data()) % buffer_alignment,
+             static_cast<uintptr_t>(0));
+    written.append(reinterpret_cast<const char*>(first[i]->data()),
+                   static_cast<int>(first[i]->size()));
+  }
+  QVERIFY(image->open());
+  QCOMPARE(written, image->readAll());
+  QFile copy(copy_path);
+  QVERIFY(copy.open(QIODevice::ReadOnly));
+  QCOMPARE(copy.readAll(), written);
+
+  const auto& stats = pipeline.stats();
+  QCOMPARE(stats.size(), static_cast<size_t>(5));
+  QCOMPARE(stats[0].buffers, static_cast<uint64_t>(3));
+  QCOMPARE(stats[3].bytes, static_cast<uint64_t>(size));
+  QVERIFY(stats[3].peak_queued <= 2);
+}
+
+void Test::testPipelineStopsOnFailure() {
+  auto image = makeTestImage(100000);
+
+  std::vector<BufferRef> buffers;
+  Pipeline pipeline(1);
+  pipeline.setSource(std::unique_ptr<Source>(
+      new FileSource(image->fileName(), buffer_alignment)));
+  pipeline.addSink(std::unique_ptr<Sink>(new RecordingSink(&buffers, true)));
+  QVERIFY(!pipeline.run());
+  QCOMPARE(buffers.size(), static_cast<size_t>(1));
+
+  Pipeline missing;
+  missing.setSource(std::unique_ptr<Source>(
+      new FileSource("/does/not/exist", buffer_alignment)));
+  missing.addSink(std::unique_ptr<Sink>(new RecordingSink(&buffers)));
+  QVERIFY(!missing.run());
+}
+
+void Test::testRunTimingsJson() {
+  using Span = RunTimings::Span;
+  RunTimings timings;
+  // Recorded out of order, reported in pipeline order
+  timings.record(Span::Write, 2000, 64 * 1024 * 1024);
+  timings.record(Span::Download, 4000, 16 * 1024 * 1024);
+  // Started but never finished, so not reported
+  timings.start(Span::Unzip);
+  // Never started, so finishing does nothing
+  timings.finish(Span::Sync);
+  timings.setWriteRetries(2);
+
+  const QJsonObject json = timings.toJson();
+  const QJsonArray spans = json["spans"].toArray();
+  QCOMPARE(spans.size(), 2);
+  QCOMPARE(spans[0].toObject()["name"].toString(), QString("download"));
+  QCOMPARE(spans[0].toObject()["mb_per_s"].toDouble(), 4.0);
+  QCOMPARE(spans[1].toObject()["name"].toString(), QString("write"));
+  QCOMPARE(spans[1].toObject()["ms"].toInt(), 2000);
+  QCOMPARE(spans[1].toObject()["mb_per_s"].toDouble(), 32.0);
+  QCOMPARE(json["write_retries"].toInt(), 2);
+}
+
+void Test::testSearchFilterModel() {
+  SiteListModel sites;
+  SearchFilterModel filter;
+  filter.setSourceModel(&sites);
+  sites.setSites({GondarSite(1, "Springfield Elementary"),
+                  GondarSite(2, "Shelbyville High"),
+                  GondarSite(3, "Springfield Library")});
+  QCOMPARE(filter.rowCount(), 3);
+
+  auto names = [&filter]() {
+    QStringList result;
+    for (int row = 0; row < filter.rowCount(); row++) {
+      result.append(filter.index(row, 0).data().toString());
+    }
+    return result;
+  };
+
+  // Case-insensitive, and typing more narrows the previous matches
+  filter.setQuery("SPRING");
+  QCOMPARE(names(), QStringList({"Springfield Elementary",
+                                 "Springfield Library"}));
+  filter.setQuery("springfield l");
+  QCOMPARE(names(), QStringList({"Springfield Library"}));
+
+  // Short queries and backspacing work without the trigram index
+  filter.setQuery("h");
+  QCOMPARE(names(), QStringList({"Shelbyville High"}));
+  filter.setQuery("xyz");
+  QCOMPARE(filter.rowCount(), 0);
+  filter.setQuery("");
+  QCOMPARE(filter.rowCount(), 3);
+
+  // The index follows the source model
+  sites.setSites({GondarSite(4, "Capital City")});
+  filter.setQuery("city");
+  QCOMPARE(names(), QStringList({"Capital City"}));
+}
+
+void Test::testSidecarCheck() {
+  QTemporaryDir dir;
+  const QString path = dir.filePath("image.bin");
+  {
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(makeMirrorBody(100 * 1024));
+  }
+  auto check = [&path]() {
+    SidecarCheck sidecar_check;
+    QSignalSpy finished(&sidecar_check, &SidecarCheck::finished);
+    sidecar_check.start(path);
+    finished.wait(5000);
+    return finished.first().first().value<SidecarCheck::Result>();
+  };
+
+  QCOMPARE(check(), SidecarCheck::Result::NoSidecar);
+
+  QVERIFY(WriteSha256Sidecar(path, Sha256File(path)));
+  QCOMPARE(ReadSha256Sidecar(path), Sha256File(path));
+  QCOMPARE(check(), SidecarCheck::Result::Verified);
+
+  QVERIFY(WriteSha256Sidecar(path, QByteArray(64, '0')));
+  QCOMPARE(check(), SidecarCheck::Result::Mismatch);
+}
+
+void Test::testStationStreamsWriteProgress() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString image_path = dir.filePath("image.bin");
+  {
+    QFile image(image_path);
+    QVERIFY(image.open(QIODevice::WriteOnly));
+    image.write(QByteArray(1024 * 1024, 'x'));
+  }
+
+  StationServer server;
+  QVERIFY(server.start(0));
+  QVERIFY(server.port() > 0);
+  const QString jobs =
+      QString("http://127.0.0.1:%1/jobs").arg(server.port());
+
+  QJsonObject job;
+  job["image"] = image_path;
+  job["devices"] = QJsonArray{0};
+  QNetworkRequest post = CreateRequest(QUrl(jobs));
+  post.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+  QNetworkReply* submitted = GetNetworkManager()->post(
+      post, QJsonDocument(job).toJson(QJsonDocument::Compact));
+  QSignalSpy submit_finished(submitted, &QNetworkReply::finished);
+  QVERIFY(submit_finished.wait(5000));
+  submitted->deleteLater();
+  const int id =
+      QJsonDocument::fromJson(submitted->readAll()).object()["id"].toInt();
+  QVERIFY(id > 0);
+
+  // The stream ends once the job is done
+  QNetworkReply* stream = GetNetworkManager()->get(
+      CreateRequest(QUrl(QString("%1/%2/events").arg(jobs).arg(id))));
+  QSignalSpy stream_finished(stream, &QNetworkReply::finished);
+  QVERIFY(stream_finished.wait(10000));
+  stream->deleteLater();
+
+  QJsonObject progress;
+  QJsonObject done;
+  for (const QByteArray& line : stream->readAll().split('\n')) {
+    const QJsonObject event = QJsonDocument::fromJson(line).object();
+    if (event["event"].toString() == "write-progress") {
+      progress = event;
+    } else if (event["event"].toString() == "done") {
+      done = event;
+    }
+  }
+  QCOMPARE(done["success"].toBool(), true);
+  QCOMPARE(progress["device"].toObject()["id"].toInt(), 0);
+  QVERIFY(progress["total"].toDouble() > 0);
+  QCOMPARE(progress["written"].toDouble(), progress["total"].toDouble());
+  QCOMPARE(progress["stage"].toString(), QString("write"));
+}
+
+void Test::testTaskPoolRunsNestedTasks() {
+  TaskPool pool(4);
+  QCOMPARE(pool.workerCount(), 4);
+
+  // Each outer task fans out into inner tasks on its own worker's
+  // queue, which the other workers then steal from
+  std::atomic<int> count{0};
+  std::mutex inner_mutex;
+  std::vector<std::future<void>> inner;
+  std::vector<std::future<void>> outer;
+  for (int i = 0; i < 8; i++) {
+    outer.push_back(pool.submit([&]() {
+      for (int j = 0; j < 100; j++) {
+        auto future = pool.submit([&]() { count++; });
+        std::lock_guard<std::mutex> lock(inner_mutex);
+        inner.push_back(std::move(future));
+      }
+    }));
+  }
+  for (auto& future : outer) {
+    future.get();
+  }
+  for (auto& future : inner) {
+    future.get();
+  }
+  QCOMPARE(count.load(), 800);
+
+  // Exceptions come back through the future
+  auto failing = pool.submit([]() { throw std::runtime_error("oops"); });
+  QVERIFY_EXCEPTION_THROWN(failing.get(), std::runtime_error);
+}
+
+void Test::testTraceWritesChromeJson() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString path = dir.filePath("trace.json");
+
+  // Nothing is kept while tracing is off
+  QVERIFY(!Trace::enabled());
+  Trace::instant("test", "ignored");
+
+  Trace::start(path);
+  {
+    TraceScope scope("test", "scope");
+    Trace::counter("bytes", 42);
+  }
+  Trace::stop();
+  QVERIFY(!Trace::enabled());
+
+  QFile file(path);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+  const QJsonArray events =
+      QJsonDocument::fromJson(file.readAll()).object()["traceEvents"].toArray();
+  QCOMPARE(events.size(), 3);
+  QCOMPARE(events[0].toObject()["ph"].toString(), QString("B"));
+  QCOMPARE(events[0].toObject()["name"].toString(), QString("scope"));
+  QCOMPARE(events[1].toObject()["ph"].toString(), QString("C"));
+  QCOMPARE(events[1].toObject()["args"].toObject()["bytes"].toInt(), 42);
+  QCOMPARE(events[2].toObject()["ph"].toString(), QString("E"));
+  QVERIFY(events[0].toObject()["ts"].toDouble() <=
+          events[2].toObject()["ts"].toDouble());
+}
+
+void Test::testWriteSchedulerLimitsWritersPerBus() {
+  QTemporaryFile image;
+  QVERIFY(image.open());
+  image.write("image");
+  image.close();
+
+  DeviceGuyList devices = {DeviceGuy(1, "a", getValidDiskSize()),
+                           DeviceGuy(2, "b", getValidDiskSize()),
+                           DeviceGuy(3, "c", getValidDiskSize()),
+                           DeviceGuy(4, "d", getValidDiskSize())};
+  devices[0].bus = devices[1].bus = devices[2].bus = "hub";
+
+  WriteScheduler scheduler(1);
+  std::map<std::string, int> running;
+  std::map<std::string, int> most_running;
+  int finished = 0;
+  connect(&scheduler, &WriteScheduler::writeStarted,
+          [&](const DeviceGuy& device) {
+            const int now = ++running[device.bus];
+            most_running[device.bus] = std::max(most_running[device.bus], now);
+          });
+  connect(&scheduler, &WriteScheduler::writeFinished,
+          [&](const DeviceGuy& device, const bool success) {
+            QVERIFY(success);
+            // The final progress can still be read
+            const WriteTelemetry* telemetry = scheduler.telemetry(device);
+            QVERIFY(telemetry);
+            const auto snapshot = telemetry->snapshot();
+            QCOMPARE(snapshot.bytes_written, snapshot.total_bytes);
+            running[device.bus]--;
+            finished++;
+          });
+
+  for (const auto& device : devices) {
+    scheduler.enqueue(device, image.fileName());
+  }
+  // One write on the shared hub, plus the device with no known hub
+  QCOMPARE(running["hub"], 1);
+  QCOMPARE(running[""], 1);
+  QCOMPARE(scheduler.pending(), 4);
+  // A device is never written twice at once
+  QVERIFY(!scheduler.enqueue(devices[0], image.fileName()));
+  QVERIFY(!scheduler.enqueue(devices[2], image.fileName()));
+  QCOMPARE(scheduler.pending(), 4);
+
+  QTRY_COMPARE(finished, 4);
+  QCOMPARE(most_running["hub"], 1);
+  QCOMPARE(scheduler.pending(), 0);
+  QVERIFY(!scheduler.telemetry(devices[0]));
+}
+
+void Test::testWriteTelemetrySnapshotsAreConsistent() {
+  WriteTelemetry telemetry;
+  const uint64_t total = 200000;
+  telemetry.setTotalBytes(total);
+  QVERIFY(telemetry.snapshot().stage == WriteTelemetry::Stage::Partition);
+  telemetry.beginStage(WriteTelemetry::Stage::Write);
+
+  // The writer keeps the LBA equal to the byte count, so any torn
+  // snapshot would show them differing
+  std::thread writer([&]() {
+    for (uint64_t i = 1; i <= total; i++) {
+      telemetry.addBytes(1, i);
+    }
+    telemetry.addRetry();
+  });
+  bool consistent = true;
+  WriteTelemetry::Snapshot snapshot;
+  do {
+    snapshot = telemetry.snapshot();
+    consistent = consistent && snapshot.current_lba == snapshot.bytes_written;
+  } while (snapshot.retries == 0);
+  writer.join();
+
+  QVERIFY(consistent);
+  QCOMPARE(snapshot.bytes_written, total);
+  QCOMPARE(snapshot.total_bytes, total);
+  QVERIFY(snapshot.stage == WriteTelemetry::Stage::Write);
+}
+
 }  // namespace gondar
 
 QTEST_MAIN(gondar::Test)
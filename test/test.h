@@ -25,9 +25,37 @@ class Test : public QObject {
   Q_OBJECT
 
  private slots:
+  void testAsyncLogAppenderRollsFiles();
+  void testBlockMapParses();
+  void testBufferPoolReusesBlocks();
+  void testChunkedExtractionsRunConcurrently();
   void testDevicePicker();
+  void testDevicePickerKeepsSelection();
+  void testDiskWriteThreadCancel();
+  void testDownloadManagerPicksFastestMirror();
+  void testDownloadManagerRestartsChangedFile();
+  void testDownloadManagerSkipsErrorPages();
+  void testDownloadManagerSwitchesSlowMirror();
+  void testImageAnalyzerSkipsFreeBlocks();
+  void testImagePrepRoundTrips();
+  void testMeepoCacheIgnoresToken();
   void testMeepoGetMetricJson();
   void testMeepoGetMetricRequest();
+  void testMetricsQueuePersistsEvents();
+  void testNeverwareUnzipCancelsMidStream();
+  void testNeverwareUnzipExtractsFirstFile();
+  void testNeverwareUnzipKeepsEntriesInDir();
+  void testPeerCacheServesRanges();
+  void testPipelineSharesBuffersBetweenSinks();
+  void testPipelineStopsOnFailure();
+  void testRunTimingsJson();
+  void testSearchFilterModel();
+  void testSidecarCheck();
+  void testStationStreamsWriteProgress();
+  void testTaskPoolRunsNestedTasks();
+  void testTraceWritesChromeJson();
+  void testWriteSchedulerLimitsWritersPerBus();
+  void testWriteTelemetrySnapshotsAreConsistent();
 };
 }  // namespace gondar
 